@@ -0,0 +1,161 @@
+#include "arena.h"
+
+#include <cstring>
+
+namespace knowson {
+
+  //--------------------------------------------------------------------------------------------------------------------
+  Arena::Arena(size_t pageSize) :
+    pages_(nullptr),
+    free_(nullptr),
+    cursor_(nullptr),
+    end_(nullptr),
+    pageSize_(pageSize),
+    capacity_(0)
+  {
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  Arena::Arena(Arena &&other) :
+    pages_(other.pages_),
+    free_(other.free_),
+    cursor_(other.cursor_),
+    end_(other.end_),
+    pageSize_(other.pageSize_),
+    capacity_(other.capacity_)
+  {
+    other.pages_ = other.free_ = nullptr;
+    other.cursor_ = other.end_ = nullptr;
+    other.capacity_ = 0;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  Arena::~Arena()
+  {
+    clear();
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  Arena& Arena::operator=(Arena &&other)
+  {
+    if (this != &other)
+    {
+      clear();
+      pages_ = other.pages_;
+      free_ = other.free_;
+      cursor_ = other.cursor_;
+      end_ = other.end_;
+      pageSize_ = other.pageSize_;
+      capacity_ = other.capacity_;
+      other.pages_ = other.free_ = nullptr;
+      other.cursor_ = other.end_ = nullptr;
+      other.capacity_ = 0;
+    }
+    return *this;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  char* Arena::copy_string(const char *data, size_t size)
+  {
+    char *result = static_cast<char*>(allocate(size, 1));
+    if (size > 0)
+      std::memcpy(result, data, size);
+    return result;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  void Arena::clear()
+  {
+    free_pages(pages_);
+    free_pages(free_);
+
+    pages_ = free_ = nullptr;
+    cursor_ = end_ = nullptr;
+    capacity_ = 0;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  void Arena::reset()
+  {
+    while (pages_ != nullptr)
+    {
+      Page *next = pages_->next;
+      pages_->next = free_;
+      free_ = pages_;
+      pages_ = next;
+    }
+
+    cursor_ = end_ = nullptr;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  void Arena::free_pages(Page *page)
+  {
+    while (page != nullptr)
+    {
+      Page *next = page->next;
+      ::operator delete(page);
+      page = next;
+    }
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  Arena::Page* Arena::take_free_page(size_t size)
+  {
+    // Pages of the regular size are all alike, so the best fit is usually the first page
+    Page **best = nullptr;
+    for (Page **page = &free_; *page != nullptr; page = &(*page)->next)
+    {
+      if ((*page)->size >= size && (best == nullptr || (*page)->size < (*best)->size))
+      {
+        best = page;
+        if ((*page)->size == size)
+          break;
+      }
+    }
+
+    if (best == nullptr)
+      return nullptr;
+
+    Page *result = *best;
+    *best = result->next;
+    return result;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  void* Arena::allocate_slow(size_t size, size_t alignment)
+  {
+    const size_t headerSize = (sizeof(Page) + alignment - 1) & ~(alignment - 1);
+    const size_t requiredSize = headerSize + size;
+
+    // Allocations that would waste most of a regular page get a page of their own. The current page
+    // stays active so small allocations can continue to fill it.
+    bool dedicated = requiredSize > pageSize_ / 4;
+    size_t pageSize = dedicated ? requiredSize : pageSize_;
+
+    Page *page = take_free_page(pageSize);
+    if (page == nullptr)
+    {
+      page = static_cast<Page*>(::operator new(pageSize));
+      page->size = pageSize;
+      capacity_ += pageSize;
+    }
+
+    char *begin = reinterpret_cast<char*>(page);
+    char *result = begin + headerSize;
+    if (dedicated && pages_ != nullptr)
+    {
+      page->next = pages_->next;
+      pages_->next = page;
+    }
+    else
+    {
+      page->next = pages_;
+      pages_ = page;
+      cursor_ = result + size;
+      end_ = begin + page->size;
+    }
+
+    return result;
+  }
+}
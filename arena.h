@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace knowson {
+
+  /**
+   * @brief Bump allocator that hands out memory from large pages. Individual allocations are never
+   *  freed; all memory is released at once when the arena is cleared or destroyed. Destructors of
+   *  objects created in the arena are not run.
+   */
+  class Arena
+  {
+  public:
+    /// Default page size in bytes
+    static const size_t kDefaultPageSize = 64 * 1024;
+
+  public:
+    /// Default constructor
+    explicit Arena(size_t pageSize = kDefaultPageSize);
+
+    /// Move constructor
+    Arena(Arena &&other);
+
+    /// Default destructor
+    ~Arena();
+
+    /// Move assignment
+    Arena& operator=(Arena &&other);
+
+    /// Allocates uninitialized memory
+    void* allocate(size_t size, size_t alignment)
+    {
+      // Aligning the cursor can move it past the end of the page
+      char *result = align(cursor_, alignment);
+      if (result == nullptr || result > end_ || size > static_cast<size_t>(end_ - result))
+        return allocate_slow(size, alignment);
+
+      cursor_ = result + size;
+      return result;
+    }
+
+    /// Constructs a new object in the arena
+    template<typename T, typename ... Args>
+    T* create(Args&& ... args)
+    {
+      return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /// Copies the given characters into the arena
+    char* copy_string(const char *data, size_t size);
+
+    /// Releases all memory owned by the arena
+    void clear();
+
+    /// Discards all allocations but keeps the pages, later allocations reuse them before new
+    /// pages are reserved from the system.
+    void reset();
+
+    /// Returns the number of bytes reserved from the system
+    size_t capacity() const { return capacity_; }
+
+  private:
+    struct Page
+    {
+      Page *next;
+      size_t size;
+    };
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /// Aligns the given pointer
+    static char* align(char *ptr, size_t alignment)
+    {
+      return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(ptr) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    /// Allocates a new page and returns memory from it
+    void* allocate_slow(size_t size, size_t alignment);
+
+    /// Takes the smallest page of at least the given size from the pages kept by reset, returns
+    /// nullptr if there is none.
+    Page* take_free_page(size_t size);
+
+    /// Returns the memory of a list of pages to the system
+    static void free_pages(Page *page);
+
+  private:
+    Page *pages_;
+    Page *free_;
+    char *cursor_;
+    char *end_;
+    size_t pageSize_;
+    size_t capacity_;
+  };
+
+  /**
+   * @brief Standard allocator that allocates memory from an Arena. Deallocation is a no-op.
+   */
+  template<typename T>
+  class ArenaAllocator
+  {
+  public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+  public:
+    /// Default constructor
+    ArenaAllocator(Arena &arena) : arena_(&arena) {}
+    template<typename U> ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+    /// Allocates uninitialized memory for n objects
+    T* allocate(size_t n) { return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T))); }
+
+    /// Memory is released together with the arena
+    void deallocate(T*, size_t) {}
+
+    /// Returns the arena memory is allocated from
+    Arena* arena() const { return arena_; }
+
+  private:
+    Arena *arena_;
+  };
+
+  template<typename T, typename U>
+  bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() == b.arena(); }
+  template<typename T, typename U>
+  bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() != b.arena(); }
+}
@@ -0,0 +1,949 @@
+#include "definition_library.h"
+#include "json_batch.h"
+#include "json_binary.h"
+#include "json_binding.h"
+#include "json_parser.h"
+#include "json_pointer.h"
+#include "json_prefetch.h"
+#include "json_push_parser.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "schema.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#  include <psapi.h>
+#else
+#  include <sys/resource.h>
+#endif
+
+//-----------------------------------------------------------------------------------------------
+// Heap accounting. Every allocation in the process goes through these replacements so the
+// benchmarks can report the number of allocations per parsed document. Worker and prefetch
+// threads allocate too, so the counters are atomic.
+namespace
+{
+  std::atomic<size_t> allocationCount(0);
+  std::atomic<size_t> allocatedBytes(0);
+}
+
+void* operator new(size_t size)
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  void *result = std::malloc(size != 0 ? size : 1);
+  if (result == nullptr)
+    throw std::bad_alloc();
+  return result;
+}
+
+void operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *ptr) noexcept { operator delete(ptr); }
+
+//-----------------------------------------------------------------------------------------------
+// Structs that match the test.json person schema, used to compare binding with building a tree
+namespace
+{
+  struct Pet
+  {
+    std::string type;
+    std::string name;
+  };
+
+  struct Person
+  {
+    std::string name;
+    int age;
+    std::string gender;
+    std::vector<Pet> pets;
+  };
+}
+
+namespace knowson {
+  template<> struct JsonBinding<Pet>
+  {
+    static void bind(JsonObjectBinder<Pet> &binder)
+    {
+      binder.member("type", &Pet::type, true).member("name", &Pet::name);
+    }
+  };
+
+  template<> struct JsonBinding<Person>
+  {
+    static void bind(JsonObjectBinder<Person> &binder)
+    {
+      binder.member("name", &Person::name, true).member("age", &Person::age).member("gender", &Person::gender)
+        .member("pets", &Person::pets);
+    }
+  };
+}
+
+namespace
+{
+  using namespace knowson;
+
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @brief A named benchmark input
+   */
+  struct CorpusEntry
+  {
+    std::string name;
+    std::string data;
+    JsonDocumentType documentType;
+  };
+
+  /**
+   * @brief Source that hands out a string in fixed size pieces, like a file stream would
+   */
+  struct StringJsonParserSource : public IJsonParserSource
+  {
+  public:
+    explicit StringJsonParserSource(const std::string &data) : data_(data), position_(0) {}
+
+    /// Reads character data from the source
+    uint32_t Read(char* buffer, uint32_t length) override
+    {
+      size_t count = std::min<size_t>(length, data_.size() - position_);
+      std::memcpy(buffer, data_.data() + position_, count);
+      position_ += count;
+      return static_cast<uint32_t>(count);
+    }
+
+  private:
+    const std::string &data_;
+    size_t position_;
+  };
+
+  /**
+   * @brief Source that waits before every read, like storage that is reached over a network
+   */
+  struct SlowJsonParserSource : public IJsonParserSource
+  {
+  public:
+    SlowJsonParserSource(const std::string &data, std::chrono::microseconds latency) : source_(data), latency_(latency) {}
+
+    /// Reads character data from the source
+    uint32_t Read(char* buffer, uint32_t length) override
+    {
+      std::this_thread::sleep_for(latency_);
+      return source_.Read(buffer, length);
+    }
+
+  private:
+    StringJsonParserSource source_;
+    std::chrono::microseconds latency_;
+  };
+
+  /**
+   * @brief Event handler that does nothing, used to measure the reader on its own
+   */
+  struct NullHandler
+  {
+    bool Null() { return true; }
+    bool Boolean(bool) { return true; }
+    bool Number(double) { return true; }
+    bool Integer(int64_t) { return true; }
+    bool String(StringRef) { return true; }
+    bool StartObject() { return true; }
+    bool Key(StringRef) { return true; }
+    bool EndObject() { return true; }
+    bool StartArray() { return true; }
+    bool EndArray() { return true; }
+  };
+
+  /// Deterministic pseudo random numbers so every run parses the same corpus
+  struct Random
+  {
+    explicit Random(uint64_t seed) : state(seed) {}
+    uint32_t next() { state = state * 6364136223846793005ull + 1442695040888963407ull; return static_cast<uint32_t>(state >> 33); }
+    uint64_t state;
+  };
+
+  //-----------------------------------------------------------------------------------------------
+  double seconds_since(Clock::time_point start)
+  {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  size_t peak_rss_kb()
+  {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      return 0;
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+#  if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#  else
+    return static_cast<size_t>(usage.ru_maxrss);
+#  endif
+#endif
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  std::string generate_numbers(size_t targetSize, Random &random)
+  {
+    std::string result("[");
+    char buffer[64];
+    while (result.size() < targetSize)
+    {
+      switch (random.next() % 3)
+      {
+      case 0: std::snprintf(buffer, sizeof(buffer), "%u", random.next()); break;
+      case 1: std::snprintf(buffer, sizeof(buffer), "-%u.%u", random.next() % 100000, random.next() % 1000); break;
+      default: std::snprintf(buffer, sizeof(buffer), "%u.%ue%d", random.next() % 10, random.next() % 100000, static_cast<int>(random.next() % 40) - 20); break;
+      }
+      if (result.size() > 1)
+        result += ',';
+      result += buffer;
+    }
+    return result + "]";
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  std::string generate_strings(size_t targetSize, Random &random)
+  {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::string result("[\n");
+    while (result.size() < targetSize)
+    {
+      if (result.size() > 2)
+        result += ",\n";
+      result += "  {\"id\": \"";
+      for (uint32_t i = 0, n = 8 + random.next() % 8; i < n; ++i)
+        result += alphabet[random.next() % (sizeof(alphabet) - 1)];
+      result += "\", \"text\": \"";
+      for (uint32_t i = 0, n = 32 + random.next() % 512; i < n; ++i)
+        result += alphabet[random.next() % (sizeof(alphabet) - 1)];
+      result += "\"}";
+    }
+    return result + "\n]";
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  std::string generate_escaped(size_t targetSize, Random &random)
+  {
+    // Plain words mixed with escape sequences and multi-byte UTF-8 characters
+    static const char *pieces[] = { "word ", "text ", "\\\"quoted\\\" ", "line\\n", "tab\\t", "back\\\\slash ",
+      "\\u00e9t\\u00e9 ", "\\ud83d\\ude00 ", "caf\xc3\xa9 ", "\xe4\xb8\xad\xe6\x96\x87 " };
+    std::string result("[\n");
+    while (result.size() < targetSize)
+    {
+      if (result.size() > 2)
+        result += ",\n";
+      result += "  {\"text\": \"";
+      for (uint32_t i = 0, n = 4 + random.next() % 64; i < n; ++i)
+        result += pieces[random.next() % (sizeof(pieces) / sizeof(pieces[0]))];
+      result += "\"}";
+    }
+    return result + "\n]";
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  std::string generate_nested(size_t targetSize, Random &random)
+  {
+    std::string result("[");
+    while (result.size() < targetSize)
+    {
+      if (result.size() > 1)
+        result += ',';
+
+      uint32_t depth = 16 + random.next() % 48;
+      std::vector<const char*> closing;
+      for (uint32_t i = 0; i < depth; ++i)
+      {
+        if (random.next() % 2 == 0)
+        {
+          result += "{\"level\":[";
+          closing.push_back("]}");
+        }
+        else
+        {
+          result += "[true,null,{\"n\":";
+          closing.push_back("}]");
+        }
+      }
+      result += "false";
+      for (auto it = closing.rbegin(); it != closing.rend(); ++it)
+        result += *it;
+    }
+    return result + "]";
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  std::string generate_simplified(size_t targetSize, Random &random)
+  {
+    std::string result;
+    char buffer[64];
+    for (uint32_t section = 0; result.size() < targetSize; ++section)
+    {
+      std::snprintf(buffer, sizeof(buffer), "section%u = {\n", section);
+      result += buffer;
+      for (uint32_t i = 0, n = 4 + random.next() % 16; i < n; ++i)
+      {
+        std::snprintf(buffer, sizeof(buffer), "  key%u = %u\n", i, random.next() % 1000);
+        result += buffer;
+      }
+      result += "  -- a comment\n  names = [\"first\" \"second\" \"third\"]\n  enabled = true\n}\n";
+    }
+    return result;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  std::string generate_schemas(size_t targetSize, const std::string &schema)
+  {
+    std::string result("[\n");
+    while (result.size() < targetSize)
+    {
+      if (result.size() > 2)
+        result += ",\n";
+      result += schema;
+    }
+    return result + "\n]";
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void report(const char *corpus, const char *benchmark, size_t bytes, size_t documents, double seconds, size_t allocations)
+  {
+    std::printf("%-12s %-18s %10.1f MB/s %12.1f allocs/doc %10zu KiB peak RSS\n",
+      corpus, benchmark,
+      static_cast<double>(bytes) * documents / (1024.0 * 1024.0) / seconds,
+      static_cast<double>(allocations) / documents,
+      peak_rss_kb());
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  /// Runs the given function until at least minimumTime has passed and returns the number of runs
+  size_t repeat(double minimumTime, double &seconds, size_t &allocations, const std::function<void()> &function)
+  {
+    size_t runs = 0;
+    size_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+    Clock::time_point start = Clock::now();
+    do
+    {
+      function();
+      ++runs;
+    } while ((seconds = seconds_since(start)) < minimumTime);
+    allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+    return runs;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  /// Prints where the time of parsing a document from a source goes, in builds that collect
+  /// parse statistics
+  void report_stats(const CorpusEntry &entry)
+  {
+    JsonParseStats stats;
+    JsonParserOptions options;
+    options.documentType = entry.documentType;
+    options.stats = &stats;
+    JsonDocument document;
+    StringJsonParserSource source(entry.data);
+    parse_json(&source, document, options);
+
+    uint64_t tokens = 0, nodes = 0;
+    for (uint64_t count : stats.tokens)
+      tokens += count;
+    for (uint64_t count : stats.nodes)
+      nodes += count;
+    std::printf("%-12s %-18s %10llu tokens %10llu nodes %4u depth %llu/%llu blocks new/reused %5.1f%% tokenizing\n",
+      entry.name.c_str(), "stats", static_cast<unsigned long long>(tokens), static_cast<unsigned long long>(nodes),
+      stats.maxDepth, static_cast<unsigned long long>(stats.blocksAllocated),
+      static_cast<unsigned long long>(stats.blocksReused),
+      stats.totalNanoseconds > 0 ? 100.0 * stats.tokenizeNanoseconds / stats.totalNanoseconds : 0.0);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void benchmark_parse(const CorpusEntry &entry, double minimumTime)
+  {
+    const char *name = entry.name.c_str();
+    double seconds;
+    size_t allocations, runs;
+
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      if (!parse_json(entry.data.data(), entry.data.size(), document, nullptr, entry.documentType))
+        std::fprintf(stderr, "%s: parse failed\n", name);
+    });
+    report(name, "parse (buffer)", entry.data.size(), runs, seconds, allocations);
+    if (kParseStatsEnabled)
+      report_stats(entry);
+
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      StringJsonParserSource source(entry.data);
+      parse_json(&source, document, nullptr, entry.documentType);
+    });
+    report(name, "parse (source)", entry.data.size(), runs, seconds, allocations);
+
+    // A parser that is kept around reuses its input blocks
+    JsonParserOptions parserOptions;
+    parserOptions.documentType = entry.documentType;
+    JsonParser parser(parserOptions);
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      StringJsonParserSource source(entry.data);
+      parser.parse(&source, document);
+    });
+    report(name, "parse (parser)", entry.data.size(), runs, seconds, allocations);
+
+    // Parsing into the same document reuses its memory as well, once it is warm
+    JsonDocument reused;
+    StringJsonParserSource warmup(entry.data);
+    parser.parse(&warmup, reused);
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      StringJsonParserSource source(entry.data);
+      parser.parse(&source, reused);
+    });
+    report(name, "parse (reused)", entry.data.size(), runs, seconds, allocations);
+
+    KeyTable keys;
+    JsonParserOptions options;
+    options.documentType = entry.documentType;
+    options.keyTable = &keys;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      parse_json(entry.data.data(), entry.data.size(), document, options);
+    });
+    report(name, "parse (key table)", entry.data.size(), runs, seconds, allocations);
+
+    JsonParserOptions iterativeOptions;
+    iterativeOptions.documentType = entry.documentType;
+    iterativeOptions.iterative = true;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      parse_json(entry.data.data(), entry.data.size(), document, iterativeOptions);
+    });
+    report(name, "parse (iterative)", entry.data.size(), runs, seconds, allocations);
+
+    // A lazy document that only reads the members or elements of its root
+    JsonParserOptions lazyOptions;
+    lazyOptions.documentType = entry.documentType;
+    lazyOptions.borrowInput = true;
+    lazyOptions.lazy = true;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      parse_json(entry.data.data(), entry.data.size(), document, lazyOptions);
+      const JsonValue *root = document.root();
+      if (root != nullptr && root->is<JsonObject>())
+        root->as<JsonObject>().size();
+      else if (root != nullptr)
+        root->as<JsonArray>().size();
+    });
+    report(name, "lazy (root only)", entry.data.size(), runs, seconds, allocations);
+
+    // Reloading a document that was encoded in the binary format ahead of time
+    JsonDocument encoded;
+    std::string binary;
+    if (parse_json(entry.data.data(), entry.data.size(), encoded, nullptr, entry.documentType) &&
+      encode_json_binary(*encoded.root(), binary))
+    {
+      JsonParserOptions binaryOptions;
+      binaryOptions.borrowInput = true;
+      runs = repeat(minimumTime, seconds, allocations, [&]() {
+        JsonDocument document;
+        decode_json_binary(binary.data(), binary.size(), document, binaryOptions);
+      });
+      report(name, "binary decode", entry.data.size(), runs, seconds, allocations);
+
+      // Verifying the records and visiting every value in place, without building a tree
+      runs = repeat(minimumTime, seconds, allocations, [&]() {
+        JsonBinaryDocument document;
+        NullHandler handler;
+        if (document.open(binary.data(), binary.size()))
+          replay_json_binary(document.root(), handler);
+      });
+      report(name, "binary open+replay", entry.data.size(), runs, seconds, allocations);
+    }
+
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      NullHandler handler;
+      parse_json_events(entry.data.data(), entry.data.size(), handler, nullptr, entry.documentType);
+    });
+    report(name, "events (buffer)", entry.data.size(), runs, seconds, allocations);
+
+    // Fragments of the size a socket read typically returns
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      NullHandler handler;
+      JsonPushParser<NullHandler> parser(handler, nullptr, entry.documentType);
+      const size_t fragmentSize = 4096;
+      for (size_t offset = 0; offset < entry.data.size(); offset += fragmentSize)
+        parser.feed(entry.data.data() + offset, std::min(fragmentSize, entry.data.size() - offset));
+      parser.finish();
+    });
+    report(name, "push (4 KiB)", entry.data.size(), runs, seconds, allocations);
+
+    // A document that is cut off is reported the same way by both parsers
+    {
+      size_t half = entry.data.size() / 2;
+      JsonParseErrorRecorder expected;
+      NullHandler handler;
+      parse_json_events(entry.data.data(), half, handler, &expected, entry.documentType);
+
+      JsonParseErrorRecorder reported;
+      JsonPushParser<NullHandler> parser(handler, &reported, entry.documentType);
+      for (size_t offset = 0; offset < half; offset += 4096)
+        parser.feed(entry.data.data() + offset, std::min<size_t>(4096, half - offset));
+      parser.finish();
+      if (reported.error.code != expected.error.code || reported.error.offset != expected.error.offset)
+        std::fprintf(stderr, "%s: push parser reported a different error for a truncated document\n", name);
+    }
+
+    // Writing is measured against the size of the input so the rows compare with parsing
+    JsonDocument parsed;
+    parse_json(entry.data.data(), entry.data.size(), parsed, nullptr, entry.documentType);
+    if (parsed.root() != nullptr)
+    {
+      JsonWriterOptions writerOptions;
+      writerOptions.documentType = entry.documentType;
+      runs = repeat(minimumTime, seconds, allocations, [&]() {
+        JsonWriter writer(writerOptions);
+        writer.Value(*parsed.root());
+      });
+      report(name, "write (tree)", entry.data.size(), runs, seconds, allocations);
+
+      runs = repeat(minimumTime, seconds, allocations, [&]() {
+        JsonWriter writer(writerOptions);
+        parse_json_events(entry.data.data(), entry.data.size(), writer, nullptr, entry.documentType);
+      });
+      report(name, "reformat (events)", entry.data.size(), runs, seconds, allocations);
+    }
+
+    // Teardown is timed separately by parsing outside of the measured section
+    double teardownSeconds = 0;
+    size_t teardownRuns = 0;
+    Clock::time_point start = Clock::now();
+    while (seconds_since(start) < minimumTime)
+    {
+      JsonDocument document;
+      parse_json(entry.data.data(), entry.data.size(), document, nullptr, entry.documentType);
+      Clock::time_point teardownStart = Clock::now();
+      document.clear();
+      teardownSeconds += seconds_since(teardownStart);
+      ++teardownRuns;
+    }
+    std::printf("%-12s %-18s %10.3f ms/doc\n", name, "teardown", teardownSeconds * 1000.0 / teardownRuns);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  /// Returns the powers of two up to the number of hardware threads, and that number itself
+  std::vector<size_t> thread_counts()
+  {
+    size_t hardwareThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < hardwareThreads; threads *= 2)
+      threadCounts.push_back(threads);
+    threadCounts.push_back(hardwareThreads);
+    return threadCounts;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void benchmark_lines(size_t targetSize, Random &random, double minimumTime)
+  {
+    std::string data;
+    while (data.size() < targetSize)
+    {
+      data += "{\"id\": " + std::to_string(random.next()) + ", \"level\": \"info\", \"message\": \"request ";
+      data += std::to_string(random.next()) + " handled\", \"duration\": " + std::to_string(random.next() % 1000) + ".5}\n";
+    }
+
+    // Throughput per thread count shows how well the batch parser scales
+    for (size_t threads : thread_counts())
+    {
+      ThreadPool pool(threads);
+      JsonBatchOptions options;
+      options.pool = &pool;
+
+      double seconds;
+      size_t allocations;
+      size_t runs = repeat(minimumTime, seconds, allocations, [&]() {
+        JsonBatch batch;
+        parse_json_lines(data.data(), data.size(), batch, options);
+      });
+
+      char name[32];
+      std::snprintf(name, sizeof(name), "batch (%zu threads)", threads);
+      report("lines", name, data.size(), runs, seconds, allocations);
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void benchmark_array(size_t targetSize, Random &random, double minimumTime)
+  {
+    std::string data = "[";
+    while (data.size() < targetSize)
+    {
+      data += "{\"id\": " + std::to_string(random.next()) + ", \"name\": \"record ";
+      data += std::to_string(random.next()) + "\", \"scores\": [" + std::to_string(random.next() % 100) + ", ";
+      data += std::to_string(random.next() % 100) + "], \"active\": true},\n";
+    }
+    data += "null]";
+
+    double seconds;
+    size_t allocations;
+    size_t runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      parse_json(data.data(), data.size(), document, nullptr, JsonDocumentType::kNormal);
+    });
+    report("array", "serial", data.size(), runs, seconds, allocations);
+
+    for (size_t threads : thread_counts())
+    {
+      ThreadPool pool(threads);
+      JsonBatchOptions options;
+      options.pool = &pool;
+
+      runs = repeat(minimumTime, seconds, allocations, [&]() {
+        JsonDocument document;
+        parse_json_parallel(data.data(), data.size(), document, options);
+      });
+
+      char name[32];
+      std::snprintf(name, sizeof(name), "parallel (%zu threads)", threads);
+      report("array", name, data.size(), runs, seconds, allocations);
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void benchmark_lookup(double minimumTime)
+  {
+    // Objects of various sizes with lookups for every key and for a missing key
+    static const size_t sizes[] = { 4, 16, 64, 1024 };
+    for (size_t size : sizes)
+    {
+      std::string data("{");
+      std::vector<std::string> keys;
+      for (size_t i = 0; i < size; ++i)
+      {
+        keys.push_back("member_" + std::to_string(i));
+        data += (i > 0 ? ",\"" : "\"") + keys.back() + "\":" + std::to_string(i);
+      }
+      data += "}";
+      keys.push_back("missing_member");
+
+      JsonDocument document;
+      parse_json(data.data(), data.size(), document);
+      const JsonObject &object = static_cast<const JsonObject&>(*document.root());
+
+      std::vector<StringRef> lookups(keys.begin(), keys.end());
+      size_t found = 0, lookupCount = 0;
+      Clock::time_point start = Clock::now();
+      double seconds;
+      do
+      {
+        for (const StringRef &key : lookups)
+        {
+          const JsonValue *value;
+          found += object.try_get(key, value) ? 1 : 0;
+        }
+        lookupCount += lookups.size();
+      } while ((seconds = seconds_since(start)) < minimumTime);
+
+      char name[32];
+      std::snprintf(name, sizeof(name), "lookup (%zu keys)", size);
+      std::printf("%-12s %-18s %10.1f ns/lookup %s\n", "objects", name, seconds * 1e9 / lookupCount, found > 0 ? "" : "!");
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void benchmark_definitions(const std::string &schemaText, double minimumTime)
+  {
+    // A repository of schemas that each embed the schema and refer to the next one
+    const size_t count = 2000;
+    std::vector<std::string> names, texts;
+    for (size_t i = 0; i < count; ++i)
+    {
+      names.push_back("schema" + std::to_string(i) + ".json");
+      texts.push_back("{\"type\": \"object\", \"properties\": {\"person\": " + schemaText +
+        ", \"next\": {\"$ref\": \"schema" + std::to_string((i + 1) % count) + ".json\"}}}");
+    }
+
+    double seconds;
+    size_t allocations, runs;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      DefinitionLibrary library;
+      for (size_t i = 0; i < count; ++i)
+        if (!library.load(names[i], texts[i].data(), texts[i].size()))
+          std::fprintf(stderr, "definitions: %s did not load\n", names[i].c_str());
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "definitions", "full load", seconds * 1e9 / (runs * count),
+      static_cast<double>(allocations) / (runs * count));
+
+    // Changing one schema rebuilds only that schema, the references to it are kept
+    DefinitionLibrary library;
+    for (size_t i = 0; i < count; ++i)
+      library.load(names[i], texts[i].data(), texts[i].size());
+    std::string changed[2] = { texts[0], texts[0] + " " };
+    size_t version = 0, resolved = 0;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      const std::string &text = changed[++version % 2];
+      library.load(names[0], text.data(), text.size());
+      resolved += library.resolve(names[count - 1] + "#/properties/next") != nullptr ? 1 : 0;
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "definitions", "reload one", seconds * 1e9 / runs,
+      static_cast<double>(allocations) / runs);
+
+    if (resolved != runs)
+      std::fprintf(stderr, "definitions: reference did not resolve after a reload\n");
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void benchmark_prefetch(const CorpusEntry &entry, double minimumTime)
+  {
+    // Every read of a 16 KiB block waits about as long as parsing the block takes
+    const std::chrono::microseconds latency(100);
+    const char *name = entry.name.c_str();
+    double seconds;
+    size_t allocations, runs;
+
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      SlowJsonParserSource source(entry.data, latency);
+      parse_json(&source, document, nullptr, entry.documentType);
+    });
+    report(name, "parse (slow source)", entry.data.size(), runs, seconds, allocations);
+
+    JsonParserOptions options;
+    options.documentType = entry.documentType;
+    options.readAhead = 4;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument document;
+      SlowJsonParserSource source(entry.data, latency);
+      parse_json(&source, document, options);
+    });
+    report(name, "parse (read ahead)", entry.data.size(), runs, seconds, allocations);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void benchmark_validate(const std::string &schemaText, double minimumTime)
+  {
+    JsonDocument schemaDocument;
+    JsonSchema schema;
+    std::string error;
+    if (!parse_json(schemaText.data(), schemaText.size(), schemaDocument) ||
+      !compile_schema(*schemaDocument.root(), schema, &error))
+    {
+      std::fprintf(stderr, "schema: could not compile (%s)\n", error.c_str());
+      return;
+    }
+
+    // A message that matches the test.json person schema
+    const std::string message = "{\"name\": \"Jeremy Dorn\", \"age\": 25, \"favorite_color\": \"#ffa500\", "
+      "\"gender\": \"male\", \"location\": {\"city\": \"San Francisco\", \"state\": \"CA\"}, "
+      "\"pets\": [{\"type\": \"dog\", \"name\": \"Walter\"}, {\"type\": \"cat\", \"name\": \"Tom\"}]}";
+
+    JsonDocument document;
+    parse_json(message.data(), message.size(), document);
+
+    // Validating the tree alone, then parsing and validating, once through a tree and once
+    // directly from the events
+    double seconds;
+    size_t allocations, runs, valid = 0;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      valid += schema.validate(*document.root()) ? 1 : 0;
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "schemas", "validate (tree)", seconds * 1e9 / runs,
+      static_cast<double>(allocations) / runs);
+    if (valid != runs)
+      std::fprintf(stderr, "schema: tree did not validate\n");
+
+    valid = 0;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument tree;
+      valid += parse_json(message.data(), message.size(), tree) && schema.validate(*tree.root()) ? 1 : 0;
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "schemas", "parse+val (tree)", seconds * 1e9 / runs,
+      static_cast<double>(allocations) / runs);
+    if (valid != runs)
+      std::fprintf(stderr, "schema: parsed tree did not validate\n");
+
+    JsonSchemaValidator validator(schema);
+    valid = 0;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      validator.reset();
+      parse_json_events(message.data(), message.size(), validator);
+      valid += validator.valid() ? 1 : 0;
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "schemas", "parse+val (events)", seconds * 1e9 / runs,
+      static_cast<double>(allocations) / runs);
+    if (valid != runs)
+      std::fprintf(stderr, "schema: events did not validate\n");
+
+    // Reading the message into structs, through a tree and directly from the events
+    Person person;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument tree;
+      parse_json(message.data(), message.size(), tree);
+      const JsonObject &root = static_cast<const JsonObject&>(*tree.root());
+      const JsonValue *value;
+      if (root.try_get("name", value))
+        person.name = static_cast<const JsonString*>(value)->value().str();
+      if (root.try_get("age", value))
+        person.age = static_cast<int>(static_cast<const JsonNumber*>(value)->integer_value());
+      if (root.try_get("gender", value))
+        person.gender = static_cast<const JsonString*>(value)->value().str();
+      person.pets.clear();
+      if (root.try_get("pets", value))
+      {
+        for (const JsonValue *element : *static_cast<const JsonArray*>(value))
+        {
+          const JsonObject &object = static_cast<const JsonObject&>(*element);
+          Pet pet;
+          if (object.try_get("type", value))
+            pet.type = static_cast<const JsonString*>(value)->value().str();
+          if (object.try_get("name", value))
+            pet.name = static_cast<const JsonString*>(value)->value().str();
+          person.pets.push_back(std::move(pet));
+        }
+      }
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "binding", "tree and copy", seconds * 1e9 / runs,
+      static_cast<double>(allocations) / runs);
+
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      parse_json_into(message.data(), message.size(), person);
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "binding", "events", seconds * 1e9 / runs,
+      static_cast<double>(allocations) / runs);
+
+    // Looking up two deep values, in a tree and in the events up to the last of them
+    JsonPointer city, petName;
+    city.parse("/location/city");
+    petName.parse("/pets/0/name");
+    size_t found = 0;
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      JsonDocument tree;
+      parse_json(message.data(), message.size(), tree);
+      found += city.resolve(tree) != nullptr && petName.resolve(tree) != nullptr ? 1 : 0;
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "pointer", "tree", seconds * 1e9 / runs,
+      static_cast<double>(allocations) / runs);
+
+    JsonQuery query;
+    query.add(city);
+    query.add(petName);
+    runs = repeat(minimumTime, seconds, allocations, [&]() {
+      parse_json_query(message.data(), message.size(), query);
+      found += query.complete() ? 1 : 0;
+    });
+    std::printf("%-12s %-18s %10.1f ns/doc %12.1f allocs/doc\n", "pointer", "query (events)", seconds * 1e9 / runs,
+      static_cast<double>(allocations) / runs);
+
+    if (found == 0)
+      std::fprintf(stderr, "pointer: values not found\n");
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool read_file(const char *path, std::string &result)
+  {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+      return false;
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    result = stream.str();
+    return true;
+  }
+}
+
+//-----------------------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  size_t corpusSize = 4 * 1024 * 1024;
+  double minimumTime = 0.5;
+  const char *schemaPath = "test.json";
+  const char *filter = nullptr;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+      corpusSize = static_cast<size_t>(std::atof(argv[++i]) * 1024 * 1024);
+    else if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+      minimumTime = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--schema") == 0 && i + 1 < argc)
+      schemaPath = argv[++i];
+    else if (argv[i][0] != '-')
+      filter = argv[i];
+    else
+    {
+      std::fprintf(stderr, "usage: %s [--size MB] [--time seconds] [--schema test.json] [corpus]\n", argv[0]);
+      return 1;
+    }
+  }
+
+#if !defined(NDEBUG) || (defined(__GNUC__) && !defined(__OPTIMIZE__))
+  std::fprintf(stderr, "warning: built without optimization or with asserts enabled, the numbers are not representative\n");
+#endif
+
+  std::string schema;
+  if (!read_file(schemaPath, schema))
+  {
+    std::fprintf(stderr, "warning: could not read %s, using a minimal schema\n", schemaPath);
+    schema = "{\"title\": \"Person\", \"type\": \"object\", \"properties\": {\"name\": {\"type\": \"string\"}}}";
+  }
+
+  Random random(1);
+  std::vector<CorpusEntry> corpus;
+  corpus.push_back(CorpusEntry{ "numbers", generate_numbers(corpusSize, random), JsonDocumentType::kNormal });
+  corpus.push_back(CorpusEntry{ "strings", generate_strings(corpusSize, random), JsonDocumentType::kNormal });
+  {
+    // Separately seeded so the documents that follow stay the same
+    Random escapedRandom(2);
+    corpus.push_back(CorpusEntry{ "escaped", generate_escaped(corpusSize, escapedRandom), JsonDocumentType::kNormal });
+  }
+  corpus.push_back(CorpusEntry{ "nested", generate_nested(corpusSize, random), JsonDocumentType::kNormal });
+  corpus.push_back(CorpusEntry{ "simplified", generate_simplified(corpusSize, random), JsonDocumentType::kSimplified });
+  corpus.push_back(CorpusEntry{ "schemas", generate_schemas(corpusSize, schema), JsonDocumentType::kNormal });
+  corpus.push_back(CorpusEntry{ "test.json", schema, JsonDocumentType::kUnknown });
+
+  for (const CorpusEntry &entry : corpus)
+    if (filter == nullptr || entry.name == filter)
+      benchmark_parse(entry, minimumTime);
+
+  if (filter == nullptr || std::strcmp(filter, "lines") == 0)
+    benchmark_lines(corpusSize, random, minimumTime);
+
+  if (filter == nullptr || std::strcmp(filter, "array") == 0)
+    benchmark_array(corpusSize, random, minimumTime);
+
+  if (filter == nullptr || std::strcmp(filter, "objects") == 0)
+    benchmark_lookup(minimumTime);
+
+  if (filter == nullptr || std::strcmp(filter, "validate") == 0)
+    benchmark_validate(schema, minimumTime);
+
+  if (filter == nullptr || std::strcmp(filter, "definitions") == 0)
+    benchmark_definitions(schema, minimumTime);
+
+  if (filter == nullptr || std::strcmp(filter, "prefetch") == 0)
+    benchmark_prefetch(corpus.front(), minimumTime);
+
+  return 0;
+}
@@ -3,13 +3,13 @@
 namespace knowson
 {
 	//--------------------------------------------------------------------------------------------------------------------
-	bool ObjectDefinition::has(const std::string &name) const
+	bool ObjectDefinition::has(StringRef name) const
 	{
     return members_.find(name) != members_.end();
 	}
 
 	//--------------------------------------------------------------------------------------------------------------------
-	bool ObjectDefinition::try_get(const std::string &name, ValueDefinition*& definition)
+	bool ObjectDefinition::try_get(StringRef name, ValueDefinition*& definition)
 	{
     auto it = members_.find(name);
 		if(it == members_.end())
@@ -20,7 +20,7 @@ namespace knowson
 	}
 
 	//--------------------------------------------------------------------------------------------------------------------
-  bool ObjectDefinition::try_get(const std::string &name, ValueDefinition const*& definition) const
+  bool ObjectDefinition::try_get(StringRef name, ValueDefinition const*& definition) const
 	{
     auto it = members_.find(name);
     if (it == members_.end())
@@ -31,15 +31,18 @@ namespace knowson
 	}
 
   //--------------------------------------------------------------------------------------------------------------------
-  bool ObjectDefinition::insert(const std::string& name, std::unique_ptr<ValueDefinition> value)
+  bool ObjectDefinition::insert(StringRef name, std::unique_ptr<ValueDefinition> value)
   {
-    /// Returns false on a duplicate key
-    if (has(name))
-      return false;
-
-    /// Insert the element
-    members_.emplace(std::map<std::string, std::unique_ptr<ValueDefinition>>::value_type(name, std::move(value)));
-    return true;
+    // Names are stored in the key table, a duplicate name is already interned
+    if (keys_ != nullptr)
+      return members_.emplace(keys_->intern(name), std::move(value)).second;
+
+    // Insert the element with a single lookup, returns false on a duplicate key. Only a name that
+    // was inserted is copied; the copy has the same characters, so its hash does not change.
+    auto result = members_.emplace(name, std::move(value));
+    if (result.second)
+      result.first->first = StringRef(names_.copy_string(name.data(), name.size()), name.size());
+    return result.second;
   }
 
   //--------------------------------------------------------------------------------------------------------------------
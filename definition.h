@@ -1,9 +1,11 @@
 #pragma once
 
+#include "flat_map.h"
+#include "key_table.h"
+
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <map>
 #include <vector>
 
 namespace knowson {
@@ -13,7 +15,10 @@ namespace knowson {
     kString,
     kNumber,
     kArray,
-    kObject
+    kObject,
+    kBoolean,
+    kInteger,
+    kReference
   };
 
   class ValueDefinition
@@ -24,6 +29,9 @@ namespace knowson {
     ValueDefinition(const std::string& name, const ValueType& type) : name_(name), type_(type) {}      
 
   public:
+    /// Definitions are owned through pointers to their base
+    virtual ~ValueDefinition() {}
+
     /// Returns the name of the definition
     const std::string& name() const { return name_; }
 
@@ -35,6 +43,17 @@ namespace knowson {
     ValueType type_;
   };
 
+  /**
+   * @brief Definition of a string, number, integer or boolean value
+   */
+  class ScalarDefinition : public ValueDefinition
+  {
+  public:
+    /// Default constructor
+    explicit ScalarDefinition(const ValueType& type) : ValueDefinition(type) {}
+    ScalarDefinition(const std::string& name, const ValueType& type) : ValueDefinition(name, type) {}
+  };
+
   class CompoundValueDefinition : public ValueDefinition
   {
   protected:
@@ -43,25 +62,39 @@ namespace knowson {
     CompoundValueDefinition(const std::string &name, const ValueType& type) : ValueDefinition(name, type) {}
   };
 
+  /**
+   * @brief Definition of an object. Member names are interned in a key table that is shared with
+   *  the parser, or copied into a small arena of the definition if there is none. When documents
+   *  are parsed with the same table their keys match member names by pointer.
+   */
   class ObjectDefinition : public CompoundValueDefinition
   {
   public:
-    /// Default constructor
-    ObjectDefinition() : CompoundValueDefinition(ValueType::kObject) {}
-    ObjectDefinition(const std::string &name) : CompoundValueDefinition(name, ValueType::kObject) {}
+    /// Default constructor. Without a key table the definition keeps its own copy of the names.
+    explicit ObjectDefinition(KeyTable *keys = nullptr) : CompoundValueDefinition(ValueType::kObject), keys_(keys), names_(kNamePageSize) {}
+    explicit ObjectDefinition(const std::string &name, KeyTable *keys = nullptr) :
+      CompoundValueDefinition(name, ValueType::kObject), keys_(keys), names_(kNamePageSize) {}
 
     /// Returns true if there is a member with the given name
-    bool has(const std::string& name) const;
+    bool has(StringRef name) const;
 
     /// Tries to return the member with the given name
-    bool try_get(const std::string& name, ValueDefinition const*& definition) const;
-    bool try_get(const std::string& name, ValueDefinition*& definition);
+    bool try_get(StringRef name, ValueDefinition const*& definition) const;
+    bool try_get(StringRef name, ValueDefinition*& definition);
 
     /// Inserts a value with the given name into the object
-    bool insert(const std::string& name, std::unique_ptr<ValueDefinition> value);
+    bool insert(StringRef name, std::unique_ptr<ValueDefinition> value);
+
+    /// Returns the number of members
+    size_t size() const { return members_.size(); }
 
   private:
-    std::map<std::string, std::unique_ptr<ValueDefinition>> members_;
+    /// Page size of the names that are copied without a key table, most objects have a handful
+    static const size_t kNamePageSize = 256;
+
+    KeyTable *keys_;
+    Arena names_;
+    FlatMap<StringRef, std::unique_ptr<ValueDefinition>> members_;
   };
 
   class ArrayDefinition : public CompoundValueDefinition
@@ -74,6 +107,12 @@ namespace knowson {
     /// Appends the given value
     void push_back(std::unique_ptr<ValueDefinition> value);
 
+    /// Returns the number of elements
+    size_t size() const { return elements_.size(); }
+
+    /// Returns the element at the given index
+    const ValueDefinition& at(size_t index) const { return *elements_[index]; }
+
   private:
     std::vector<std::unique_ptr<ValueDefinition>> elements_;
   };
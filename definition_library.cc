@@ -0,0 +1,657 @@
+#include "definition_library.h"
+#include "json_reader.h"
+
+#include <utility>
+#include <vector>
+
+namespace knowson {
+
+  namespace detail {
+
+    /// The number of references that are followed before they are considered a cycle
+    static const size_t kMaxReferenceHops = 64;
+
+    /// A schema of the library, it keeps its address while the library lives
+    struct DefinitionEntry
+    {
+      DefinitionEntry() : loaded(false), hash(0) {}
+
+      std::string name;
+      bool loaded;
+      uint64_t hash;
+      std::unique_ptr<ValueDefinition> root;
+      std::unordered_map<std::string, std::unique_ptr<ValueDefinition>> definitions;
+    };
+
+    /// The target of a $ref, resolved on access and cached until a schema of the library changes.
+    /// The path to the target may follow references into other schemas, so the cache depends on
+    /// more than the schema of the slot.
+    struct DefinitionSlot
+    {
+      DefinitionSlot() : entry(nullptr), library(nullptr), resolved(nullptr), generation(0), resolving(false) {}
+
+      DefinitionEntry *entry;
+      const uint64_t *library;
+      JsonPointer pointer;
+      mutable const ValueDefinition *resolved;
+      mutable uint64_t generation;
+
+      /// Set while the pointer is navigated, which may resolve other slots along its path
+      mutable bool resolving;
+    };
+
+    /**
+     * @brief Json event handler that builds the definitions of a schema. The members of a schema
+     *  can appear in any order, so every schema object gathers its keywords and children first
+     *  and becomes a definition when it ends.
+     */
+    class DefinitionBuilder
+    {
+    public:
+      /// Default constructor
+      DefinitionBuilder(DefinitionLibrary &library, const std::string &name, KeyTable *keys) :
+        library_(library), name_(name), keys_(keys) {}
+
+      /// Returns the message of the problem that stopped the build or an empty string
+      const std::string& error() const { return error_; }
+
+      /// Json event handler
+      bool Null() { return scalar(); }
+      bool Boolean(bool) { return scalar(); }
+      bool Number(double) { return scalar(); }
+      bool Integer(int64_t) { return scalar(); }
+      bool String(StringRef value);
+      bool Key(StringRef key);
+      bool StartObject();
+      bool EndObject();
+      bool StartArray();
+      bool EndArray();
+
+    public:
+      std::unique_ptr<ValueDefinition> root;
+      std::unordered_map<std::string, std::unique_ptr<ValueDefinition>> definitions;
+
+    private:
+      /// What the value of the current member of a scope is
+      enum class Scope
+      {
+        kSchema,
+        kProperties,
+        kDefinitions,
+        kItems,
+        kSkip,
+      };
+
+      /// The keywords of a schema that are read
+      enum class Keyword
+      {
+        kOther,
+        kType,
+        kTitle,
+        kRef,
+        kProperties,
+        kDefinitions,
+        kItems,
+      };
+
+      struct Frame
+      {
+        explicit Frame(Scope s, const std::string &n = std::string()) : scope(s), keyword(Keyword::kOther),
+          depth(1), name(n) {}
+
+        Scope scope;
+        Keyword keyword;
+        uint32_t depth;
+        std::string name;
+        std::string key;
+        std::string type, title, ref;
+        bool hasProperties = false;
+        bool hasItems = false;
+        std::vector<std::pair<std::string, std::unique_ptr<ValueDefinition>>> properties;
+        std::vector<std::unique_ptr<ValueDefinition>> items;
+      };
+
+      /// Stops the build with the given message
+      bool fail(const std::string &message)
+      {
+        if (error_.empty())
+          error_ = message;
+        return false;
+      }
+
+      /// Returns the name that a schema nested in the current scope gets
+      std::string child_name() const;
+
+      /// Called for a value that is not a string, object or array
+      bool scalar();
+
+      /// Turns a complete schema object into a definition
+      bool build(Frame &frame, std::unique_ptr<ValueDefinition> &result);
+
+      /// Hands a definition to the scope that contains it
+      bool deliver(std::unique_ptr<ValueDefinition> definition);
+
+    private:
+      DefinitionLibrary &library_;
+      const std::string &name_;
+      KeyTable *keys_;
+      std::vector<Frame> stack_;
+      std::string error_;
+    };
+
+    //-----------------------------------------------------------------------------------------------
+    std::string DefinitionBuilder::child_name() const
+    {
+      const Frame &frame = stack_.back();
+      return frame.scope == Scope::kSchema || frame.scope == Scope::kItems ? frame.name : frame.key;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::scalar()
+    {
+      if (stack_.empty())
+        return fail("a schema must be an object");
+
+      Scope scope = stack_.back().scope;
+      if (scope == Scope::kSchema || scope == Scope::kSkip)
+        return true;
+      return fail("the schema of '" + child_name() + "' must be an object");
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::String(StringRef value)
+    {
+      if (stack_.empty() || stack_.back().scope != Scope::kSchema)
+        return scalar();
+
+      Frame &frame = stack_.back();
+      switch (frame.keyword)
+      {
+      case Keyword::kType: frame.type = value.str(); break;
+      case Keyword::kTitle: frame.title = value.str(); break;
+      case Keyword::kRef: frame.ref = value.str(); break;
+      default: break;
+      }
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::Key(StringRef key)
+    {
+      Frame &frame = stack_.back();
+      if (frame.scope == Scope::kSchema)
+      {
+        if (key == "type") frame.keyword = Keyword::kType;
+        else if (key == "title") frame.keyword = Keyword::kTitle;
+        else if (key == "$ref") frame.keyword = Keyword::kRef;
+        else if (key == "properties") frame.keyword = Keyword::kProperties;
+        else if (key == "items") frame.keyword = Keyword::kItems;
+        // Named definitions can only be referred to at the root of a schema
+        else if ((key == "definitions" || key == "$defs") && stack_.size() == 1) frame.keyword = Keyword::kDefinitions;
+        else frame.keyword = Keyword::kOther;
+      }
+      else if (frame.scope != Scope::kSkip)
+        frame.key = key.str();
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::StartObject()
+    {
+      if (stack_.empty())
+      {
+        stack_.push_back(Frame(Scope::kSchema, name_));
+        return true;
+      }
+
+      Frame &frame = stack_.back();
+      switch (frame.scope)
+      {
+      case Scope::kSkip:
+        ++frame.depth;
+        return true;
+      case Scope::kProperties:
+      case Scope::kDefinitions:
+      case Scope::kItems:
+        stack_.push_back(Frame(Scope::kSchema, child_name()));
+        return true;
+      case Scope::kSchema:
+        break;
+      }
+
+      switch (frame.keyword)
+      {
+      case Keyword::kProperties:
+        frame.hasProperties = true;
+        stack_.push_back(Frame(Scope::kProperties));
+        break;
+      case Keyword::kDefinitions:
+        stack_.push_back(Frame(Scope::kDefinitions));
+        break;
+      case Keyword::kItems:
+        frame.hasItems = true;
+        stack_.push_back(Frame(Scope::kSchema, frame.name));
+        break;
+      default:
+        stack_.push_back(Frame(Scope::kSkip));
+        break;
+      }
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::StartArray()
+    {
+      if (stack_.empty())
+        return fail("a schema must be an object");
+
+      Frame &frame = stack_.back();
+      switch (frame.scope)
+      {
+      case Scope::kSkip:
+        ++frame.depth;
+        return true;
+      case Scope::kSchema:
+        break;
+      default:
+        return fail("the schema of '" + child_name() + "' must be an object");
+      }
+
+      if (frame.keyword == Keyword::kType)
+        return fail("lists of types are not supported");
+
+      if (frame.keyword == Keyword::kItems)
+      {
+        frame.hasItems = true;
+        stack_.push_back(Frame(Scope::kItems, frame.name));
+      }
+      else
+        stack_.push_back(Frame(Scope::kSkip));
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::EndArray()
+    {
+      Frame &frame = stack_.back();
+      if (frame.scope != Scope::kSkip || --frame.depth == 0)
+        stack_.pop_back();
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::EndObject()
+    {
+      Frame &frame = stack_.back();
+      if (frame.scope == Scope::kSkip)
+      {
+        if (--frame.depth == 0)
+          stack_.pop_back();
+        return true;
+      }
+
+      if (frame.scope != Scope::kSchema)
+      {
+        stack_.pop_back();
+        return true;
+      }
+
+      std::unique_ptr<ValueDefinition> definition;
+      if (!build(frame, definition))
+        return false;
+      stack_.pop_back();
+      return deliver(std::move(definition));
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::build(Frame &frame, std::unique_ptr<ValueDefinition> &result)
+    {
+      const std::string &name = frame.title.empty() ? frame.name : frame.title;
+
+      // A reference replaces the rest of the schema
+      if (!frame.ref.empty())
+      {
+        const DefinitionSlot *slot = library_.slot(frame.ref, name_);
+        if (slot == nullptr)
+          return fail("invalid $ref '" + frame.ref + "'");
+        result.reset(new ReferenceDefinition(name, slot));
+        return true;
+      }
+
+      const std::string &type = !frame.type.empty() ? frame.type :
+        frame.hasProperties ? std::string("object") : frame.hasItems ? std::string("array") : frame.type;
+      if (type == "object")
+      {
+        std::unique_ptr<ObjectDefinition> object(new ObjectDefinition(name, keys_));
+        for (auto &property : frame.properties)
+        {
+          if (!object->insert(property.first, std::move(property.second)))
+            return fail("duplicate property '" + property.first + "'");
+        }
+        result = std::move(object);
+      }
+      else if (type == "array")
+      {
+        std::unique_ptr<ArrayDefinition> array(new ArrayDefinition(name));
+        for (auto &item : frame.items)
+          array->push_back(std::move(item));
+        result = std::move(array);
+      }
+      else if (type == "string")
+        result.reset(new ScalarDefinition(name, ValueType::kString));
+      else if (type == "number")
+        result.reset(new ScalarDefinition(name, ValueType::kNumber));
+      else if (type == "integer")
+        result.reset(new ScalarDefinition(name, ValueType::kInteger));
+      else if (type == "boolean")
+        result.reset(new ScalarDefinition(name, ValueType::kBoolean));
+      else if (type.empty())
+        return fail("the schema of '" + name + "' has no type");
+      else
+        return fail("unsupported type '" + type + "'");
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool DefinitionBuilder::deliver(std::unique_ptr<ValueDefinition> definition)
+    {
+      if (stack_.empty())
+      {
+        root = std::move(definition);
+        return true;
+      }
+
+      Frame &frame = stack_.back();
+      switch (frame.scope)
+      {
+      case Scope::kSchema:
+        // The single schema of items
+        frame.items.push_back(std::move(definition));
+        break;
+      case Scope::kItems:
+        stack_[stack_.size() - 2].items.push_back(std::move(definition));
+        break;
+      case Scope::kProperties:
+        stack_[stack_.size() - 2].properties.emplace_back(frame.key, std::move(definition));
+        break;
+      case Scope::kDefinitions:
+        if (!definitions.emplace(frame.key, std::move(definition)).second)
+          return fail("duplicate definition '" + frame.key + "'");
+        break;
+      case Scope::kSkip:
+        break;
+      }
+      return true;
+    }
+  }
+
+  namespace
+  {
+    //-----------------------------------------------------------------------------------------------
+    /// FNV-1a hash of the text of a schema, used to skip reloads of unchanged schemas
+    uint64_t hash_text(const char *data, size_t length)
+    {
+      uint64_t hash = 14695981039346656037ull;
+      for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+      return hash;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Computes the definition a pointer refers to within a schema. Tokens are keywords of the
+    /// schema, so /properties/name is the member name of an object and /items the element of an
+    /// array.
+    const ValueDefinition* navigate(const detail::DefinitionEntry &entry, const JsonPointer &pointer)
+    {
+      if (!entry.loaded)
+        return nullptr;
+
+      const ValueDefinition *current = entry.root.get();
+      size_t i = 0;
+      if (pointer.size() >= 2 && (pointer.key(0) == "definitions" || pointer.key(0) == "$defs"))
+      {
+        auto it = entry.definitions.find(pointer.key(1).str());
+        if (it == entry.definitions.end())
+          return nullptr;
+        current = it->second.get();
+        i = 2;
+      }
+
+      while (i < pointer.size())
+      {
+        // References along the path are followed
+        if (current->base_type() == ValueType::kReference)
+        {
+          current = static_cast<const ReferenceDefinition*>(current)->target();
+          if (current == nullptr)
+            return nullptr;
+        }
+
+        StringRef key = pointer.key(i);
+        if (key == "properties" && i + 1 < pointer.size() && current->base_type() == ValueType::kObject)
+        {
+          ValueDefinition const* member;
+          if (!static_cast<const ObjectDefinition*>(current)->try_get(pointer.key(i + 1), member))
+            return nullptr;
+          current = member;
+          i += 2;
+        }
+        else if (key == "items" && current->base_type() == ValueType::kArray)
+        {
+          const ArrayDefinition &array = *static_cast<const ArrayDefinition*>(current);
+          if (array.size() == 0)
+            return nullptr;
+
+          // A tuple is indexed, a single schema of items is not
+          size_t index = 0;
+          for (; index < array.size() && !(i + 1 < pointer.size() && pointer.matches(i + 1, index)); ++index) {}
+          if (index < array.size())
+          {
+            current = &array.at(index);
+            i += 2;
+          }
+          else
+          {
+            current = &array.at(0);
+            i += 1;
+          }
+        }
+        else
+          return nullptr;
+      }
+      return current;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Returns the definition in a slot, resolving it again if a schema changed. Returns nullptr
+    /// for a slot that refers to itself through the references along its path.
+    const ValueDefinition* resolve_slot(const detail::DefinitionSlot &slot)
+    {
+      if (slot.generation != *slot.library)
+      {
+        // A slot that is needed again to resolve itself is part of a cycle of references through
+        // fragments, none of which resolve
+        if (slot.resolving)
+          return nullptr;
+
+        slot.resolving = true;
+        slot.resolved = navigate(*slot.entry, slot.pointer);
+        slot.generation = *slot.library;
+        slot.resolving = false;
+      }
+      return slot.resolved;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Follows references from the given definition until a definition of another type is found
+    const ValueDefinition* follow(const ValueDefinition *definition)
+    {
+      for (size_t hops = 0; definition != nullptr && hops < detail::kMaxReferenceHops; ++hops)
+      {
+        if (definition->base_type() != ValueType::kReference)
+          return definition;
+        definition = static_cast<const ReferenceDefinition*>(definition)->target();
+      }
+      return nullptr;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  const ValueDefinition* ReferenceDefinition::target() const
+  {
+    const ValueDefinition *definition = resolve_slot(*slot_);
+    for (size_t hops = 1; definition != nullptr && hops < detail::kMaxReferenceHops; ++hops)
+    {
+      if (definition->base_type() != ValueType::kReference)
+        return definition;
+      definition = resolve_slot(*static_cast<const ReferenceDefinition*>(definition)->slot_);
+    }
+    return nullptr;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  DefinitionLibrary::DefinitionLibrary(KeyTable *keys) :
+    keys_(keys),
+    loaded_(0),
+    builds_(0),
+    generation_(0)
+  {
+    if (keys_ == nullptr)
+    {
+      ownKeys_.reset(new KeyTable());
+      keys_ = ownKeys_.get();
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  DefinitionLibrary::~DefinitionLibrary()
+  {
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool DefinitionLibrary::load(StringRef name, const char *data, size_t length, std::string *error)
+  {
+    detail::DefinitionEntry &schema = *entry(name);
+    uint64_t hash = hash_text(data, length);
+    if (schema.loaded && schema.hash == hash)
+      return true;
+    return build(schema, data, length, hash, error);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool DefinitionLibrary::load(StringRef name, IJsonParserSource *source, std::string *error)
+  {
+    const char *data;
+    size_t length;
+    if (source->Span(data, length))
+      return load(name, data, length, error);
+
+    // The text is hashed before it is parsed, so the source is read completely
+    std::string text;
+    char block[64 * 1024];
+    for (uint32_t count; (count = source->Read(block, sizeof(block))) > 0;)
+      text.append(block, count);
+    return load(name, text.data(), text.size(), error);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void DefinitionLibrary::remove(StringRef name)
+  {
+    auto it = entries_.find(name.str());
+    if (it == entries_.end() || !it->second->loaded)
+      return;
+
+    detail::DefinitionEntry &schema = *it->second;
+    schema.loaded = false;
+    schema.hash = 0;
+    ++generation_;
+    schema.root.reset();
+    schema.definitions.clear();
+    --loaded_;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  const ValueDefinition* DefinitionLibrary::find(StringRef name) const
+  {
+    auto it = entries_.find(name.str());
+    return it != entries_.end() && it->second->loaded ? it->second->root.get() : nullptr;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  const ValueDefinition* DefinitionLibrary::resolve(StringRef ref, StringRef base)
+  {
+    const detail::DefinitionSlot *target = slot(ref, base);
+    return target != nullptr ? follow(resolve_slot(*target)) : nullptr;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  detail::DefinitionEntry* DefinitionLibrary::entry(StringRef name)
+  {
+    std::unique_ptr<detail::DefinitionEntry> &schema = entries_[name.str()];
+    if (schema == nullptr)
+    {
+      schema.reset(new detail::DefinitionEntry());
+      schema->name = name.str();
+    }
+    return schema.get();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  const detail::DefinitionSlot* DefinitionLibrary::slot(StringRef ref, StringRef base)
+  {
+    // Split the ref into the name of the schema and the pointer in the fragment
+    size_t split = 0;
+    while (split < ref.size() && ref[split] != '#')
+      ++split;
+    StringRef name = split == 0 ? base : StringRef(ref.data(), split);
+    StringRef fragment = split < ref.size() ? StringRef(ref.data() + split + 1, ref.size() - split - 1) : StringRef();
+
+    std::string key = name.str();
+    key += '#';
+    key.append(fragment.data(), fragment.size());
+
+    std::unique_ptr<detail::DefinitionSlot> &target = slots_[key];
+    if (target == nullptr)
+    {
+      std::unique_ptr<detail::DefinitionSlot> created(new detail::DefinitionSlot());
+      if (!created->pointer.parse(fragment))
+      {
+        slots_.erase(key);
+        return nullptr;
+      }
+      created->entry = entry(name);
+      created->library = &generation_;
+      target = std::move(created);
+    }
+    return target.get();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool DefinitionLibrary::build(detail::DefinitionEntry &schema, const char *data, size_t length, uint64_t hash,
+    std::string *error)
+  {
+    JsonParseErrorRecorder log;
+    detail::DefinitionBuilder builder(*this, schema.name, keys_);
+    if (!parse_json_events(data, length, builder, &log, JsonDocumentType::kNormal) || builder.root == nullptr)
+    {
+      if (error != nullptr)
+      {
+        char text[256];
+        *error = !builder.error().empty() ? builder.error() :
+          log.error.code != JsonParseErrorCode::kNone ? std::string(format_parse_error(log.error, text, sizeof(text))) :
+          std::string("a schema must be an object");
+      }
+      return false;
+    }
+
+    schema.root = std::move(builder.root);
+    schema.definitions = std::move(builder.definitions);
+    schema.hash = hash;
+    ++generation_;
+    if (!schema.loaded)
+      ++loaded_;
+    schema.loaded = true;
+    ++builds_;
+    return true;
+  }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "definition.h"
+#include "json_parser.h"
+#include "json_pointer.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace knowson {
+
+  namespace detail {
+    class DefinitionBuilder;
+    struct DefinitionEntry;
+    struct DefinitionSlot;
+  }
+
+  /**
+   * @brief Definition that stands for the target of a $ref. The target is looked up through the
+   *  library that loaded the reference, so it follows the target schema when that is reloaded.
+   */
+  class ReferenceDefinition : public ValueDefinition
+  {
+  public:
+    /// Constructs a reference through the given slot of a library
+    ReferenceDefinition(const std::string &name, const detail::DefinitionSlot *slot) :
+      ValueDefinition(name, ValueType::kReference), slot_(slot) {}
+
+    /// Returns the referenced definition, following references to references. Returns nullptr
+    /// if the target is not loaded or the references form a cycle.
+    const ValueDefinition* target() const;
+
+  private:
+    const detail::DefinitionSlot *slot_;
+  };
+
+  /**
+   * @brief Loads definitions from json schema documents such as test.json. Schemas are built
+   *  straight from the event stream of the parser without a JsonValue tree in between.
+   *
+   *  Every schema is loaded under a name, and a $ref names the schema it refers to followed by
+   *  an optional JSON Pointer fragment, e.g. "pet.json#/definitions/owner". A fragment without a
+   *  name refers to the schema that contains it. References are resolved on access through a
+   *  cache, so schemas can be loaded in any order and may refer to each other in cycles.
+   *
+   *  Reloading a schema only rebuilds that schema. References from other schemas see the new
+   *  version without being rebuilt, and a schema whose text did not change is not parsed again.
+   *  Definitions of a reloaded schema are destroyed, so keep pointers to a definition only until
+   *  its schema is reloaded or removed.
+   */
+  class DefinitionLibrary
+  {
+  public:
+    /// Default constructor. Member names are interned in the given key table, or in a table of
+    /// the library if there is none.
+    explicit DefinitionLibrary(KeyTable *keys = nullptr);
+
+    /// Default destructor
+    ~DefinitionLibrary();
+
+    /// Loads the schema with the given name from a buffer, replacing an earlier version. Returns
+    /// false and a description of the problem if the schema is malformed, the earlier version
+    /// is kept then.
+    bool load(StringRef name, const char *data, size_t length, std::string *error = nullptr);
+
+    /// Loads the schema with the given name from a source
+    bool load(StringRef name, IJsonParserSource *source, std::string *error = nullptr);
+
+    /// Unloads the schema with the given name, references to it no longer resolve
+    void remove(StringRef name);
+
+    /// Returns the root definition of the schema with the given name or nullptr
+    const ValueDefinition* find(StringRef name) const;
+
+    /// Resolves a $ref as if it appeared in the schema with the given name. Returns nullptr if
+    /// the target is not loaded.
+    const ValueDefinition* resolve(StringRef ref, StringRef base = StringRef());
+
+    /// Returns the number of loaded schemas
+    size_t size() const { return loaded_; }
+
+    /// Returns the number of schemas that were parsed, loads of unchanged text are not counted
+    size_t builds() const { return builds_; }
+
+  private:
+    DefinitionLibrary(const DefinitionLibrary&) = delete;
+    DefinitionLibrary& operator=(const DefinitionLibrary&) = delete;
+
+    friend class detail::DefinitionBuilder;
+
+    /// Returns the entry of the schema with the given name, adding an empty one if it is new
+    detail::DefinitionEntry* entry(StringRef name);
+
+    /// Returns the slot of a $ref in the schema with the given name. Returns nullptr if the
+    /// fragment is not a valid pointer.
+    const detail::DefinitionSlot* slot(StringRef ref, StringRef base);
+
+    /// Builds a schema from the given text and replaces the current version
+    bool build(detail::DefinitionEntry &entry, const char *data, size_t length, uint64_t hash, std::string *error);
+
+  private:
+    KeyTable *keys_;
+    std::unique_ptr<KeyTable> ownKeys_;
+    std::unordered_map<std::string, std::unique_ptr<detail::DefinitionEntry>> entries_;
+    std::unordered_map<std::string, std::unique_ptr<detail::DefinitionSlot>> slots_;
+    size_t loaded_;
+    size_t builds_;
+
+    /// Changes whenever a schema is built or removed, the slots resolve again once it does
+    uint64_t generation_;
+  };
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "string_ref.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace knowson {
+
+  namespace detail {
+    /// Returns the FNV-1a hash of the given characters
+    inline uint32_t hash_string(const char *data, size_t size)
+    {
+      uint32_t hash = 2166136261u;
+      for (size_t i = 0; i < size; ++i)
+      {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+      }
+      return hash;
+    }
+  }
+
+  /**
+   * @brief Associative container that stores its entries contiguously in insertion order. Small
+   *  maps are searched linearly; once a map grows beyond kLinearScanLimit entries an open
+   *  addressing hash index over the entries is maintained as well. Keys must be convertible to
+   *  StringRef.
+   */
+  template<typename Key, typename Value, typename Allocator = std::allocator<std::pair<Key, Value>>>
+  class FlatMap
+  {
+  public:
+    typedef std::pair<Key, Value> value_type;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<value_type> EntryAllocator;
+    typedef std::vector<value_type, EntryAllocator> EntryList;
+    typedef typename EntryList::iterator iterator;
+    typedef typename EntryList::const_iterator const_iterator;
+
+    /// Number of entries up to which lookups scan the entries instead of using the hash index
+    static const size_t kLinearScanLimit = 16;
+
+  public:
+    /// Default constructor
+    explicit FlatMap(const Allocator &allocator = Allocator()) :
+      entries_(EntryAllocator(allocator)),
+      index_(SlotAllocator(allocator)) {}
+
+    /// Returns an iterator to the entry with the given key or end() if there is no such entry
+    iterator find(StringRef key) { return entries_.begin() + find_index(key); }
+    const_iterator find(StringRef key) const { return entries_.begin() + find_index(key); }
+
+    /// Inserts a new entry at the end of the map unless an entry with the same key already
+    /// exists. Returns the entry with the key and whether it was inserted.
+    template<typename K, typename V>
+    std::pair<iterator, bool> emplace(K &&key, V &&value)
+    {
+      StringRef keyRef(key);
+      uint32_t hash = 0;
+      size_t existing;
+      if (index_.empty())
+        existing = scan(keyRef);
+      else
+      {
+        hash = detail::hash_string(keyRef.data(), keyRef.size());
+        existing = probe(keyRef, hash);
+      }
+
+      if (existing != entries_.size())
+        return std::make_pair(entries_.begin() + existing, false);
+
+      entries_.emplace_back(std::forward<K>(key), std::forward<V>(value));
+
+      if (!index_.empty())
+      {
+        if ((entries_.size() << 1) > index_.size())
+          rehash(index_.size() << 1);
+        else
+          insert_slot(hash, static_cast<uint32_t>(entries_.size() - 1));
+      }
+      else if (entries_.size() > kLinearScanLimit)
+        rehash(64);
+
+      return std::make_pair(entries_.end() - 1, true);
+    }
+
+    /// Inserts a new entry at the end of the map, or replaces the value of the entry with the
+    /// same key in place. Returns the entry with the key and whether it was inserted.
+    template<typename K, typename V>
+    std::pair<iterator, bool> insert_or_assign(K &&key, V &&value)
+    {
+      // emplace only consumes the value when it inserts it
+      std::pair<iterator, bool> result = emplace(std::forward<K>(key), std::forward<V>(value));
+      if (!result.second)
+        result.first->second = std::forward<V>(value);
+      return result;
+    }
+
+    /// Reserves storage for the given number of entries. The hash index is sized for them as
+    /// well, so inserting them builds it once instead of growing it.
+    void reserve(size_t size)
+    {
+      entries_.reserve(size);
+      if (size <= kLinearScanLimit)
+        return;
+
+      size_t slots = 64;
+      while (slots < (size << 1))
+        slots <<= 1;
+      if (slots > index_.size())
+        rehash(slots);
+    }
+
+    /// Removes all entries
+    void clear() { entries_.clear(); index_.clear(); }
+
+    /// Returns the number of entries
+    size_t size() const { return entries_.size(); }
+
+    /// Returns true if there are no entries
+    bool empty() const { return entries_.empty(); }
+
+    /// Returns an iterator to the first entry
+    iterator begin() { return entries_.begin(); }
+    const_iterator begin() const { return entries_.begin(); }
+
+    /// Returns an iterator to the past the last entry
+    iterator end() { return entries_.end(); }
+    const_iterator end() const { return entries_.end(); }
+
+  private:
+    /// Slot of the hash index. Entry is the index of the entry plus one, zero marks an empty slot.
+    struct Slot
+    {
+      uint32_t hash;
+      uint32_t entry;
+    };
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Slot> SlotAllocator;
+
+    /// Returns the index of the entry with the given key or size() if there is no such entry
+    size_t find_index(StringRef key) const
+    {
+      if (index_.empty())
+        return scan(key);
+      return probe(key, detail::hash_string(key.data(), key.size()));
+    }
+
+    /// Linearly searches the entries for the given key
+    size_t scan(StringRef key) const
+    {
+      size_t size = entries_.size();
+      for (size_t i = 0; i < size; ++i)
+        if (StringRef(entries_[i].first) == key)
+          return i;
+      return size;
+    }
+
+    /// Searches the hash index for the given key
+    size_t probe(StringRef key, uint32_t hash) const
+    {
+      size_t mask = index_.size() - 1;
+      for (size_t i = hash & mask;; i = (i + 1) & mask)
+      {
+        const Slot &slot = index_[i];
+        if (slot.entry == 0)
+          return entries_.size();
+        if (slot.hash == hash && StringRef(entries_[slot.entry - 1].first) == key)
+          return slot.entry - 1;
+      }
+    }
+
+    /// Inserts an entry into the hash index
+    void insert_slot(uint32_t hash, uint32_t entry)
+    {
+      size_t mask = index_.size() - 1;
+      size_t i = hash & mask;
+      while (index_[i].entry != 0)
+        i = (i + 1) & mask;
+      index_[i].hash = hash;
+      index_[i].entry = entry + 1;
+    }
+
+    /// Rebuilds the hash index with the given number of slots
+    void rehash(size_t slots)
+    {
+      Slot empty = { 0, 0 };
+      index_.assign(slots, empty);
+      for (size_t i = 0; i < entries_.size(); ++i)
+      {
+        StringRef key(entries_[i].first);
+        insert_slot(detail::hash_string(key.data(), key.size()), static_cast<uint32_t>(i));
+      }
+    }
+
+  private:
+    EntryList entries_;
+    std::vector<Slot, SlotAllocator> index_;
+  };
+}
@@ -1,21 +1,38 @@
 #include "json.h"
 
+#include <limits>
+
 namespace knowson {
 
 	//-----------------------------------------------------------------------------------------------
-	bool JsonObject::try_get(const std::string &key, JsonValue const *&value) const
+	bool JsonObject::try_get(StringRef key, JsonValue const *&value) const
 	{
+		load();
 		auto it = members_.find(key);
 		if(it == members_.end())
 			return false;
 
-		value = it->second.get();
+		value = it->second;
 		return true;
 	}
 
   //-----------------------------------------------------------------------------------------------
-  void JsonObject::insert(const std::string& key, std::unique_ptr<JsonValue> value)
+  bool JsonObject::insert(StringRef key, JsonValue *value, JsonDuplicateKeys duplicates)
   {
-    members_.insert(std::make_pair(key, std::move(value)));
+    load();
+    if (duplicates == JsonDuplicateKeys::kKeepLast)
+      return members_.insert_or_assign(key, value).second;
+    return members_.emplace(key, value).second;
   }
-}
\ No newline at end of file
+
+	//-----------------------------------------------------------------------------------------------
+	int64_t JsonNumber::truncate(double value)
+	{
+		// Converting a double outside the int64 range is undefined, 2^63 itself is already outside
+		if (value >= 9223372036854775808.0)
+			return std::numeric_limits<int64_t>::max();
+		if (value >= -9223372036854775808.0)
+			return static_cast<int64_t>(value);
+		return value < 0 ? std::numeric_limits<int64_t>::min() : 0;
+	}
+}
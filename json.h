@@ -1,7 +1,13 @@
 #pragma once
 
+#include "arena.h"
+#include "flat_map.h"
+#include "string_ref.h"
+
+#include <cassert>
+#include <cstdint>
 #include <type_traits>
-#include <map>
+#include <utility>
 #include <string>
 #include <vector>
 #include <memory>
@@ -19,6 +25,19 @@ namespace knowson {
 		kNull,
 	};
 
+	/// Describes what happens when an object receives a key it already has
+	enum class JsonDuplicateKeys
+	{
+		/// The first value is kept and later ones are dropped
+		kKeepFirst,
+
+		/// The last value replaces the earlier ones, the member keeps its first position
+		kKeepLast,
+
+		/// The document is rejected
+		kReject,
+	};
+
 	class JsonValue;
 	class JsonObject;
 	class JsonArray;
@@ -28,7 +47,9 @@ namespace knowson {
 	class JsonNull;
 
 	namespace detail {
-		template<typename T> struct JsonTypeConversion : public std::integral_constant<JsonType, JsonType::kNull> {};
+		struct LazyNode;
+
+		template<typename T> struct JsonTypeConversion;
 		template<> struct JsonTypeConversion<JsonObject> : public std::integral_constant<JsonType, JsonType::kObject> {};
 		template<> struct JsonTypeConversion<JsonArray> : public std::integral_constant<JsonType, JsonType::kArray> {};
 		template<> struct JsonTypeConversion<JsonBoolean> : public std::integral_constant<JsonType, JsonType::kBoolean> {};
@@ -37,23 +58,33 @@ namespace knowson {
 		template<> struct JsonTypeConversion<JsonNull> : public std::integral_constant<JsonType, JsonType::kNull> {};
 	};
 
+	/**
+	 * @brief Base class of all json values. Values are allocated from the Arena of the JsonDocument
+	 *  that owns them and are released together with the document; their destructors are not run.
+	 *  The concrete type is recorded in a tag, so values carry no vtable and conversions are a
+	 *  checked static_cast.
+	 */
 	class JsonValue
 	{
 	protected:
 		JsonValue(JsonType type) : type_(type) {};
 
 	public:
-		virtual ~JsonValue(){};
-
 		/// Returns the type of the json value
 		JsonType type() const { return type_; }
 
 		/// Returns true if this JsonValue is in fact
 		template<typename T> bool is() const { return detail::JsonTypeConversion<T>::value == type(); }
 
-		/// Converts this object to the specified json type
-		template<typename T> const T& as() const { return *dynamic_cast<T*>(this); }
-		template<typename T> T& as() const { return *dynamic_cast<T*>(this); }
+		/// Converts this object to the specified json type. The value must be of that type.
+		template<typename T> const T& as() const { assert(is<T>()); return static_cast<const T&>(*this); }
+		template<typename T> T& as() { assert(is<T>()); return static_cast<T&>(*this); }
+
+		/// Calls the visitor with this value converted to its concrete type and returns the result
+		template<typename Visitor>
+		auto visit(Visitor &&visitor) const -> decltype(visitor(std::declval<const JsonNull&>()));
+		template<typename Visitor>
+		auto visit(Visitor &&visitor) -> decltype(visitor(std::declval<JsonNull&>()));
 
 	private:
 		JsonType type_;
@@ -62,62 +93,95 @@ namespace knowson {
 	class JsonObject final : public JsonValue
 	{
 	public:
-		typedef std::map<std::string, std::unique_ptr<JsonValue>> MemberMap;
+		typedef std::pair<StringRef, JsonValue*> Member;
+		typedef FlatMap<StringRef, JsonValue*, ArenaAllocator<Member>> MemberMap;
 		typedef MemberMap::iterator iterator;
 		typedef MemberMap::const_iterator const_iterator;
 
 	public:
-		/// Default constructor
-		JsonObject() : JsonValue(JsonType::kObject) {};
+		/// Default constructor. An object of a lazy document parses its members from the node when
+		/// they are first accessed.
+		explicit JsonObject(Arena &arena, detail::LazyNode *lazy = nullptr) : JsonValue(JsonType::kObject), members_(arena), lazy_(lazy) {};
 
 		/// Returns true if the given key exists in this instance
-		bool has(const std::string& key) const { return members_.find(key) != members_.end(); }
+		bool has(StringRef key) const { load(); return members_.find(key) != members_.end(); }
 
 		/// Returns the value with the given key
-		const JsonValue& at(const std::string& key) const { return *members_.find(key)->second; }
+		const JsonValue& at(StringRef key) const { load(); return *members_.find(key)->second; }
 
 		/// Tries the get the value with the given key
-		bool try_get(const std::string& key, JsonValue const*& value) const;
+		bool try_get(StringRef key, JsonValue const*& value) const;
 
-    /// Insersts an item into the object
-    void insert(const std::string& key, std::unique_ptr<JsonValue> value);
+    /// Insersts an item into the object. The key and value must be owned by the same document as
+    /// this instance. Returns false if the key already exists, its value is then replaced only
+    /// with JsonDuplicateKeys::kKeepLast.
+    bool insert(StringRef key, JsonValue *value, JsonDuplicateKeys duplicates = JsonDuplicateKeys::kKeepFirst);
 
-		/// Returns an iterator to the first element
-		iterator begin() { return members_.begin(); }
-		const_iterator begin() const { return members_.begin(); }
+    /// Reserves storage for the given number of members
+    void reserve(size_t count) { load(); members_.reserve(count); }
+
+		/// Returns the number of members
+		size_t size() const { load(); return members_.size(); }
+
+		/// Returns an iterator to the first member. Members are iterated in insertion order.
+		iterator begin() { load(); return members_.begin(); }
+		const_iterator begin() const { load(); return members_.begin(); }
 
 		/// Returns an iterator to the past the last element
-		iterator end() { return members_.end(); }
-		const_iterator end() const { return members_.end(); }
+		iterator end() { load(); return members_.end(); }
+		const_iterator end() const { load(); return members_.end(); }
+
+	private:
+		/// Parses the members of an object of a lazy document on first access
+		void load() const { if (lazy_ != nullptr) materialize(); }
+		void materialize() const;
 
 	private:
 		MemberMap members_;
+		mutable detail::LazyNode *lazy_;
 	};
 
 	class JsonArray final : public JsonValue
 	{
 	public:
-		typedef std::vector<std::unique_ptr<JsonValue>> ElementList;
+		typedef std::vector<JsonValue*, ArenaAllocator<JsonValue*>> ElementList;
 		typedef ElementList::iterator iterator;
 		typedef ElementList::const_iterator const_iterator;
 
 	public:
-		/// Default constructor
-		JsonArray() : JsonValue(JsonType::kArray) {}
+		/// Default constructor. An array of a lazy document parses its elements from the node when
+		/// they are first accessed.
+		explicit JsonArray(Arena &arena, detail::LazyNode *lazy = nullptr) : JsonValue(JsonType::kArray), elements_(arena), lazy_(lazy) {}
+
+    /// Insert an element into the list. The element must be owned by the same document as this
+    /// instance or by a document attached to it.
+    void emplace_back(JsonValue *element) { load(); elements_.emplace_back(element); }
+
+    /// Reserves space for the given number of elements
+    void reserve(size_t count) { load(); elements_.reserve(count); }
+
+		/// Returns the number of elements
+		size_t size() const { load(); return elements_.size(); }
 
-    /// Insert an element into the list
-    void emplace_back(std::unique_ptr<JsonValue> &&element) { elements_.emplace_back(std::forward<std::unique_ptr<JsonValue>>(element)); }
+		/// Returns the element at the given index
+		const JsonValue& at(size_t index) const { load(); return *elements_[index]; }
 
 		/// Returns an iterator to the first element
-		iterator begin() { return elements_.begin(); }
-		const_iterator begin() const { return elements_.begin(); }
+		iterator begin() { load(); return elements_.begin(); }
+		const_iterator begin() const { load(); return elements_.begin(); }
 
 		/// Returns an iterator to the past the last element
-		iterator end() { return elements_.end(); }
-		const_iterator end() const { return elements_.end(); }
+		iterator end() { load(); return elements_.end(); }
+		const_iterator end() const { load(); return elements_.end(); }
+
+	private:
+		/// Parses the elements of an array of a lazy document on first access
+		void load() const { if (lazy_ != nullptr) materialize(); }
+		void materialize() const;
 
 	private:
 		ElementList elements_;
+		mutable detail::LazyNode *lazy_;
 	};
 
 	class JsonBoolean : public JsonValue
@@ -140,32 +204,50 @@ namespace knowson {
 	{
 	public:
 		/// Default constructor
-		explicit JsonNumber(double value = false) : JsonValue(JsonType::kNumber), value_(value) {}
+		explicit JsonNumber(double value = false) : JsonValue(JsonType::kNumber), isInteger_(false) { value_ = value; }
+		explicit JsonNumber(int64_t value) : JsonValue(JsonType::kNumber), isInteger_(true) { integer_ = value; }
+
+		/// Returns the number value. Integers of more than 53 bits are rounded.
+		double value() const { return isInteger_ ? static_cast<double>(integer_) : value_; }
+
+		/// Returns true if the number is stored as an exact integer
+		bool is_integer() const { return isInteger_; }
 
-		/// Returns the number value
-		double value() const { return value_; }
+		/// Returns the number value as an integer. Non-integer values are truncated, values out of the
+		/// int64 range are clamped to it and NaN is returned as 0.
+		int64_t integer_value() const { return isInteger_ ? integer_ : truncate(value_); }
 
 		/// Sets the value
-		void set_value(double value) { value_ = value; }
+		void set_value(double value) { value_ = value; isInteger_ = false; }
+		void set_value(int64_t value) { integer_ = value; isInteger_ = true; }
 
 	private:
-		double value_;
+		/// Converts a double to the nearest int64 towards zero
+		static int64_t truncate(double value);
+
+	private:
+		bool isInteger_;
+		union
+		{
+			double value_;
+			int64_t integer_;
+		};
 	};
 
 	class JsonString : public JsonValue
 	{
 	public:
-		/// Default constructor
-		explicit JsonString(const std::string& value) : JsonValue(JsonType::kString), value_(value) {}
+		/// Default constructor. The characters are not copied and must outlive this instance.
+		explicit JsonString(StringRef value) : JsonValue(JsonType::kString), value_(value) {}
 
 		/// Returns the string value
-		const std::string& value() const { return value_; }
+		StringRef value() const { return value_; }
 
-		/// Sets the value
-		void set_value(const std::string& value) { value_ = value; }
+		/// Sets the value. The characters are not copied and must outlive this instance.
+		void set_value(StringRef value) { value_ = value; }
 
 	private:
-		std::string value_;
+		StringRef value_;
 	};
 
 	class JsonNull : public JsonValue
@@ -174,4 +256,34 @@ namespace knowson {
 		/// Default constructor
 		JsonNull() : JsonValue(JsonType::kNull) {}
 	};
-}
\ No newline at end of file
+
+	//-----------------------------------------------------------------------------------------------
+	template<typename Visitor>
+	auto JsonValue::visit(Visitor &&visitor) const -> decltype(visitor(std::declval<const JsonNull&>()))
+	{
+		switch (type_)
+		{
+		case JsonType::kObject: return visitor(static_cast<const JsonObject&>(*this));
+		case JsonType::kArray: return visitor(static_cast<const JsonArray&>(*this));
+		case JsonType::kBoolean: return visitor(static_cast<const JsonBoolean&>(*this));
+		case JsonType::kString: return visitor(static_cast<const JsonString&>(*this));
+		case JsonType::kNumber: return visitor(static_cast<const JsonNumber&>(*this));
+		default: return visitor(static_cast<const JsonNull&>(*this));
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------------
+	template<typename Visitor>
+	auto JsonValue::visit(Visitor &&visitor) -> decltype(visitor(std::declval<JsonNull&>()))
+	{
+		switch (type_)
+		{
+		case JsonType::kObject: return visitor(static_cast<JsonObject&>(*this));
+		case JsonType::kArray: return visitor(static_cast<JsonArray&>(*this));
+		case JsonType::kBoolean: return visitor(static_cast<JsonBoolean&>(*this));
+		case JsonType::kString: return visitor(static_cast<JsonString&>(*this));
+		case JsonType::kNumber: return visitor(static_cast<JsonNumber&>(*this));
+		default: return visitor(static_cast<JsonNull&>(*this));
+		}
+	}
+}
@@ -0,0 +1,462 @@
+#include "json_batch.h"
+#include "json_dom_builder.h"
+#include "json_reader.h"
+#include "json_scan.h"
+
+#include <atomic>
+#include <string>
+
+namespace knowson {
+
+  namespace
+  {
+    /**
+     * @brief A range of complete lines, or of complete elements of a root array, that is parsed by
+     *  a single task
+     */
+    struct Chunk
+    {
+      const char *begin;
+      const char *end;
+    };
+
+    /**
+     * @brief The elements of a chunk of the root array, a range of the elements of one worker
+     */
+    struct ElementRange
+    {
+      size_t worker;
+      size_t begin;
+      size_t end;
+    };
+
+    //-----------------------------------------------------------------------------------------------
+    /// Splits the input into chunks of about the given size that end just past a newline
+    std::vector<Chunk> split_chunks(const char *data, size_t length, size_t chunkSize)
+    {
+      std::vector<Chunk> chunks;
+      const char *end = data + length;
+      for (const char *begin = data; begin < end;)
+      {
+        const char *split = static_cast<size_t>(end - begin) > chunkSize ? begin + chunkSize : end;
+        split = detail::find_newline(split, end);
+        if (split != end)
+          ++split;
+
+        Chunk chunk = { begin, split };
+        chunks.push_back(chunk);
+        begin = split;
+      }
+      return chunks;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Parses every non-empty line of the chunk into the document and reports its root and offset
+    template<typename Callback>
+    void parse_chunk(const Chunk &chunk, const char *base, JsonDocument &document, const JsonBatchOptions &options,
+      StringRef borrowed, const Callback &callback)
+    {
+      JsonDomBuilder builder(document);
+      builder.set_borrowed_input(borrowed);
+
+      for (const char *p = chunk.begin; p < chunk.end;)
+      {
+        const char *lineEnd = detail::find_newline(p, chunk.end);
+        const char *start = detail::skip_whitespace(p, lineEnd);
+        if (start != lineEnd)
+        {
+          builder.restart();
+          detail::ParseContext<detail::SpanInput> context(nullptr, options.documentType, start,
+            static_cast<size_t>(lineEnd - start));
+
+          // A line holds exactly one document
+          bool parsed = detail::parse_document_root(context, builder) &&
+            context.token().type == detail::TokenType::kEOF;
+          callback(parsed ? builder.root() : nullptr, static_cast<size_t>(start - base));
+        }
+        p = lineEnd + 1;
+      }
+    }
+
+    /**
+     * @brief Tracks the nesting of a root array over its structural characters and splits its
+     *  elements into chunks. Strings end at the next quote that is not escaped and comments at the
+     *  next newline, just like in the tokenizer.
+     */
+    class ElementSplitter
+    {
+    public:
+      enum Result { kContinue, kSkipLine, kDone, kInvalid };
+
+    public:
+      /// Constructs a splitter for the elements that start at begin
+      ElementSplitter(const char *begin, size_t chunkSize, std::vector<Chunk> &chunks) :
+        begin_(begin), chunkSize_(chunkSize), depth_(0), inString_(false), chunks_(chunks) {}
+
+      /// Processes a structural character. kSkipLine means the rest of the line is a comment.
+      Result visit(const char *p, const char *end)
+      {
+        if (inString_)
+        {
+          inString_ = *p != '"' || detail::is_escaped(begin_, p);
+          return kContinue;
+        }
+
+        switch (*p)
+        {
+        case '"':
+          inString_ = true;
+          return kContinue;
+        case '{':
+        case '[':
+          ++depth_;
+          return kContinue;
+        case '}':
+        case ']':
+          if (depth_ > 0)
+          {
+            --depth_;
+            return kContinue;
+          }
+          if (*p != ']')
+            return kInvalid;
+          add_chunk(p);
+          return kDone;
+        case ',':
+          if (depth_ == 0 && static_cast<size_t>(p - begin_) >= chunkSize_)
+          {
+            add_chunk(p);
+            begin_ = p + 1;
+          }
+          return kContinue;
+        default:
+          // Either a sign or a comment
+          return p + 1 != end && p[1] == *p ? kSkipLine : kContinue;
+        }
+      }
+
+    private:
+      void add_chunk(const char *end)
+      {
+        Chunk chunk = { begin_, end };
+        chunks_.push_back(chunk);
+      }
+
+    private:
+      const char *begin_;
+      size_t chunkSize_;
+      size_t depth_;
+      bool inString_;
+      std::vector<Chunk> &chunks_;
+    };
+
+    //-----------------------------------------------------------------------------------------------
+    /// Splits the elements of a root array into chunks of about the given size. Chunks end just
+    /// before a comma that separates two elements and the last chunk ends before the closing
+    /// bracket. Returns false if the root is not an array or the nesting is not balanced, the
+    /// document is then left to the serial parser.
+    bool split_elements(const char *data, size_t length, size_t chunkSize, std::vector<Chunk> &chunks)
+    {
+      const char *end = data + length;
+      const char *p = detail::skip_whitespace(data, end);
+      if (p == end || *p != '[')
+        return false;
+
+      ElementSplitter splitter(++p, chunkSize, chunks);
+      ElementSplitter::Result result = ElementSplitter::kContinue;
+      while (p != end)
+      {
+#if defined(KNOWSON_SCAN_SIMD)
+        // Visit all structural characters of a chunk before loading the next one
+        if (static_cast<size_t>(end - p) >= detail::ScanChunk::kSize)
+        {
+          uint32_t mask = detail::structural_mask(p);
+          const char *next = p + detail::ScanChunk::kSize;
+          for (; mask != 0; mask &= mask - 1)
+          {
+            const char *c = p + detail::trailing_zeros(mask);
+            if ((result = splitter.visit(c, end)) != ElementSplitter::kContinue)
+            {
+              next = c + 1;
+              break;
+            }
+          }
+          p = next;
+        }
+        else
+#endif
+        if (detail::is_structural(*p))
+          result = splitter.visit(p++, end);
+        else
+          ++p;
+
+        if (result == ElementSplitter::kSkipLine)
+        {
+          p = detail::find_newline(p, end);
+          result = ElementSplitter::kContinue;
+        }
+        else if (result != ElementSplitter::kContinue)
+          break;
+      }
+
+      // Trailing comments are rare enough to leave to the serial parser
+      return result == ElementSplitter::kDone && detail::skip_whitespace(p, end) == end;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Parses the comma separated elements of a chunk of the root array with the builder of a
+    /// worker. Only the last chunk may be empty or end with a comma, like the closing of an array.
+    bool parse_elements(const Chunk &chunk, bool last, JsonDomBuilder &builder, std::vector<JsonValue*> &elements)
+    {
+      typedef detail::ParseContext<detail::SpanInput> Context;
+      Context input(nullptr, JsonDocumentType::kNormal, chunk.begin, static_cast<size_t>(chunk.end - chunk.begin));
+      detail::DialectContext<Context, JsonDocumentType::kNormal> context(input);
+      context.next();
+      if (!last && context.token().type == detail::TokenType::kEOF)
+        return false;
+
+      while (context.token().type != detail::TokenType::kEOF)
+      {
+        builder.restart();
+        if (!detail::parse_value(context, builder))
+          return false;
+        elements.push_back(builder.root());
+
+        if (context.token().type == detail::TokenType::kComma)
+        {
+          context.next();
+          if (!last && context.token().type == detail::TokenType::kEOF)
+            return false;
+        }
+        else if (context.token().type != detail::TokenType::kEOF)
+          return false;
+      }
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Reads the remainder of a source into the buffer
+    void read_source(IJsonParserSource *source, std::string &buffer)
+    {
+      char block[64 * 1024];
+      for (uint32_t count; (count = source->Read(block, sizeof(block))) > 0;)
+        buffer.append(block, count);
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonBatch& JsonBatch::operator=(JsonBatch &&other)
+  {
+    if (this != &other)
+    {
+      records_ = std::move(other.records_);
+      documents_ = std::move(other.documents_);
+      errors_ = other.errors_;
+      other.errors_ = 0;
+    }
+    return *this;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonBatch::clear()
+  {
+    records_.clear();
+    documents_.clear();
+    errors_ = 0;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool parse_json_lines(const char *data, size_t length, JsonBatch &batch, const JsonBatchOptions &options)
+  {
+    batch.clear();
+
+    std::unique_ptr<ThreadPool> ownPool;
+    ThreadPool *pool = options.pool;
+    if (pool == nullptr)
+    {
+      ownPool.reset(new ThreadPool());
+      pool = ownPool.get();
+    }
+
+    // Every worker allocates from its own document so the workers do not share an arena
+    for (size_t i = 0; i < pool->size(); ++i)
+      batch.documents_.emplace_back(new JsonDocument());
+
+    std::vector<Chunk> chunks = split_chunks(data, length, options.chunkSize);
+    std::vector<std::vector<JsonBatch::Record>> results(chunks.size());
+    std::atomic<size_t> errors(0);
+    StringRef borrowed = options.borrowInput ? StringRef(data, length) : StringRef();
+
+    pool->run(chunks.size(), [&](size_t task, size_t worker) {
+      std::vector<JsonBatch::Record> &records = results[task];
+      size_t chunkErrors = 0;
+      parse_chunk(chunks[task], data, *batch.documents_[worker], options, borrowed,
+        [&](const JsonValue *root, size_t offset) {
+          JsonBatch::Record record = { root, offset };
+          records.push_back(record);
+          chunkErrors += root == nullptr ? 1 : 0;
+        });
+      errors += chunkErrors;
+    });
+
+    // Chunks are in input order, so concatenating them restores the order of the records
+    size_t count = 0;
+    for (const std::vector<JsonBatch::Record> &records : results)
+      count += records.size();
+
+    batch.records_.reserve(count);
+    for (const std::vector<JsonBatch::Record> &records : results)
+      batch.records_.insert(batch.records_.end(), records.begin(), records.end());
+    batch.errors_ = errors;
+    return batch.errors_ == 0;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool parse_json_lines(IJsonParserSource *source, JsonBatch &batch, const JsonBatchOptions &options)
+  {
+    const char *data;
+    size_t length;
+    if (source->Span(data, length))
+      return parse_json_lines(data, length, batch, options);
+
+    // The chunks have to be split up front, so other sources are read completely first. The
+    // buffer does not outlive the call and can not be borrowed.
+    std::string buffer;
+    read_source(source, buffer);
+
+    JsonBatchOptions copyOptions = options;
+    copyOptions.borrowInput = false;
+    return parse_json_lines(buffer.data(), buffer.size(), batch, copyOptions);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool parse_json_lines(const char *data, size_t length, const JsonRecordCallback &callback, const JsonBatchOptions &options)
+  {
+    std::unique_ptr<ThreadPool> ownPool;
+    ThreadPool *pool = options.pool;
+    if (pool == nullptr)
+    {
+      ownPool.reset(new ThreadPool());
+      pool = ownPool.get();
+    }
+
+    std::vector<std::unique_ptr<JsonDocument>> documents;
+    for (size_t i = 0; i < pool->size(); ++i)
+      documents.emplace_back(new JsonDocument());
+
+    std::vector<Chunk> chunks = split_chunks(data, length, options.chunkSize);
+    std::atomic<size_t> errors(0);
+    StringRef borrowed = options.borrowInput ? StringRef(data, length) : StringRef();
+
+    pool->run(chunks.size(), [&](size_t task, size_t worker) {
+      JsonDocument &document = *documents[worker];
+      size_t chunkErrors = 0;
+      parse_chunk(chunks[task], data, document, options, borrowed,
+        [&](const JsonValue *root, size_t offset) {
+          callback(root, offset);
+          chunkErrors += root == nullptr ? 1 : 0;
+        });
+
+      // The values were only lent to the callback, the memory is kept for the next chunk
+      document.reset();
+      errors += chunkErrors;
+    });
+
+    return errors == 0;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool parse_json_parallel(const char *data, size_t length, JsonDocument &document, const JsonBatchOptions &options,
+    IJsonParserLog *log)
+  {
+    document.clear();
+
+    std::vector<Chunk> chunks;
+    if (options.documentType == JsonDocumentType::kSimplified ||
+      !split_elements(data, length, options.chunkSize, chunks))
+    {
+      JsonParserOptions parserOptions;
+      parserOptions.documentType = options.documentType;
+      parserOptions.borrowInput = options.borrowInput;
+      return parse_json(data, length, document, parserOptions, log);
+    }
+
+    std::unique_ptr<ThreadPool> ownPool;
+    ThreadPool *pool = options.pool;
+    if (pool == nullptr)
+    {
+      ownPool.reset(new ThreadPool());
+      pool = ownPool.get();
+    }
+
+    // A worker builds all of its chunks, so the memory of its builder is reused between them
+    StringRef borrowed = options.borrowInput ? StringRef(data, length) : StringRef();
+    std::vector<std::unique_ptr<JsonDocument>> documents;
+    std::vector<std::unique_ptr<JsonDomBuilder>> builders;
+    for (size_t i = 0; i < pool->size(); ++i)
+    {
+      documents.emplace_back(new JsonDocument());
+      builders.emplace_back(new JsonDomBuilder(*documents.back()));
+      builders.back()->set_borrowed_input(borrowed);
+    }
+
+    // The elements of a worker are appended to a single list, a chunk remembers its range of it
+    std::vector<std::vector<JsonValue*>> elements(pool->size());
+    std::vector<ElementRange> results(chunks.size());
+    std::atomic<bool> failed(false);
+
+    pool->run(chunks.size(), [&](size_t task, size_t worker) {
+      if (failed)
+        return;
+      ElementRange range = { worker, elements[worker].size(), 0 };
+      if (!parse_elements(chunks[task], task + 1 == chunks.size(), *builders[worker], elements[worker]))
+        failed = true;
+      range.end = elements[worker].size();
+      results[task] = range;
+    });
+
+    // Parse the document again to report the error with its location
+    if (failed)
+    {
+      builders.clear();
+      documents.clear();
+      JsonParserOptions parserOptions;
+      parserOptions.documentType = JsonDocumentType::kNormal;
+      parserOptions.borrowInput = options.borrowInput;
+      return parse_json(data, length, document, parserOptions, log);
+    }
+
+    size_t count = 0;
+    for (const std::vector<JsonValue*> &worker : elements)
+      count += worker.size();
+
+    // The elements stay in the arenas of the workers, which the document takes over
+    JsonArray *root = document.create_array();
+    root->reserve(count);
+    for (const ElementRange &range : results)
+      for (size_t i = range.begin; i < range.end; ++i)
+        root->emplace_back(elements[range.worker][i]);
+
+    for (std::unique_ptr<JsonDocument> &worker : documents)
+      document.attach(std::move(worker));
+    document.set_root(root);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool parse_json_parallel(IJsonParserSource *source, JsonDocument &document, const JsonBatchOptions &options,
+    IJsonParserLog *log)
+  {
+    const char *data;
+    size_t length;
+    if (source->Span(data, length))
+      return parse_json_parallel(data, length, document, options, log);
+
+    std::string buffer;
+    read_source(source, buffer);
+
+    JsonBatchOptions copyOptions = options;
+    copyOptions.borrowInput = false;
+    return parse_json_parallel(buffer.data(), buffer.size(), document, copyOptions, log);
+  }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "json_parser.h"
+#include "thread_pool.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace knowson {
+
+  /**
+   * @brief Options that control how a stream of newline delimited documents is parsed
+   */
+  struct JsonBatchOptions
+  {
+  public:
+    /// Default constructor
+    JsonBatchOptions() : documentType(JsonDocumentType::kNormal), borrowInput(false), chunkSize(1024 * 1024), pool(nullptr) {}
+
+    /// The dialect of the records. The simplified dialect spans lines, so kUnknown detects the
+    /// dialect of every record separately.
+    JsonDocumentType documentType;
+
+    /// Set to true to promise that the input outlives the batch, strings are then referenced in
+    /// place instead of copied
+    bool borrowInput;
+
+    /// Approximate number of bytes that a worker parses per task. Chunks always end at a newline,
+    /// or for parse_json_parallel, between two elements of the root array.
+    size_t chunkSize;
+
+    /// Pool that parses the chunks, if nullptr a pool with a worker per hardware thread is
+    /// created for the call
+    ThreadPool *pool;
+  };
+
+  /**
+   * @brief The documents of a newline delimited json stream, in input order. The values of all
+   *  documents parsed by the same worker share an arena that the batch owns.
+   */
+  class JsonBatch
+  {
+  public:
+    /**
+     * @brief A single line of the input
+     */
+    struct Record
+    {
+      /// The root value of the document, nullptr if the line could not be parsed
+      const JsonValue *root;
+
+      /// Offset of the document in the input, the first character of the line that is not
+      /// whitespace
+      size_t offset;
+    };
+
+    typedef std::vector<Record>::const_iterator const_iterator;
+
+  public:
+    /// Default constructor
+    JsonBatch() : errors_(0) {}
+
+    /// Move constructor
+    JsonBatch(JsonBatch &&other) : records_(std::move(other.records_)), documents_(std::move(other.documents_)), errors_(other.errors_) { other.errors_ = 0; }
+
+    /// Move assignment
+    JsonBatch& operator=(JsonBatch &&other);
+
+    /// Returns the number of records, lines that only contain whitespace are not records
+    size_t size() const { return records_.size(); }
+
+    /// Returns the record with the given index
+    const Record& operator[](size_t index) const { return records_[index]; }
+
+    /// Returns the number of records that could not be parsed
+    size_t error_count() const { return errors_; }
+
+    /// Returns an iterator to the first record
+    const_iterator begin() const { return records_.begin(); }
+
+    /// Returns an iterator to the past the last record
+    const_iterator end() const { return records_.end(); }
+
+    /// Releases all records
+    void clear();
+
+  private:
+    friend bool parse_json_lines(const char *data, size_t length, JsonBatch &batch, const JsonBatchOptions &options);
+
+    JsonBatch(const JsonBatch&) = delete;
+    JsonBatch& operator=(const JsonBatch&) = delete;
+
+  private:
+    std::vector<Record> records_;
+    std::vector<std::unique_ptr<JsonDocument>> documents_;
+    size_t errors_;
+  };
+
+  /// Called for every record of a stream. The root is nullptr if the line could not be parsed.
+  /// Records are reported from the worker threads as they are parsed; the values are only valid
+  /// during the call.
+  typedef std::function<void(const JsonValue *root, size_t offset)> JsonRecordCallback;
+
+  /// Parses newline delimited json documents on multiple threads. Any previous content of the
+  /// batch is released. Returns false if any of the records could not be parsed.
+  bool parse_json_lines(const char *data, size_t length, JsonBatch &batch, const JsonBatchOptions &options = JsonBatchOptions());
+  bool parse_json_lines(IJsonParserSource *source, JsonBatch &batch, const JsonBatchOptions &options = JsonBatchOptions());
+
+  /// Parses newline delimited json documents on multiple threads and hands every record to the
+  /// callback. The callback is called concurrently from the workers.
+  bool parse_json_lines(const char *data, size_t length, const JsonRecordCallback &callback, const JsonBatchOptions &options = JsonBatchOptions());
+
+  /// Parses a single json document whose root is an array on multiple threads. A structural
+  /// pre-scan splits the array between its elements, the workers parse the elements of every chunk
+  /// into their own arena and the elements are then added to the root array in order. Documents
+  /// with any other root, and malformed documents, are parsed serially, so errors are reported to
+  /// the log exactly as parse_json would. Any previous content of the document is released.
+  bool parse_json_parallel(const char *data, size_t length, JsonDocument &document, const JsonBatchOptions &options = JsonBatchOptions(), IJsonParserLog *log = nullptr);
+  bool parse_json_parallel(IJsonParserSource *source, JsonDocument &document, const JsonBatchOptions &options = JsonBatchOptions(), IJsonParserLog *log = nullptr);
+}
@@ -0,0 +1,567 @@
+#include "json_binary.h"
+#include "json_dom_builder.h"
+
+#include <algorithm>
+
+namespace knowson {
+
+  using detail::BinaryTag;
+  using detail::read_word;
+
+  namespace
+  {
+    /// Returns the size of a string record with the given length
+    uint64_t string_record_size(uint64_t length) { return (8 + length + 1 + 3) & ~uint64_t(3); }
+
+    /**
+     * @brief Checks the records of a binary document in a single pass over the buffer. Every
+     *  reference must point to the start of an earlier record of the right kind, and containers
+     *  may only be referenced once, so replaying a verified document always terminates and
+     *  visits every record at most once. Since the children of a container come before it, the
+     *  depth of every container is known by the time it is reached.
+     */
+    class BinaryVerifier
+    {
+    public:
+      BinaryVerifier(const char *data, size_t size) : data_(data), size_(size),
+        starts_(size / 4, false), used_(size / 4, false), depths_(size / 4, 0) {}
+
+      //-----------------------------------------------------------------------------------------------
+      /// Checks the document and returns the depth of its root, which is 0 for a scalar
+      bool verify(uint32_t root, uint32_t dictionary, uint32_t &depth)
+      {
+        for (uint64_t offset = detail::kBinaryHeaderSize; offset < size_;)
+        {
+          uint64_t size;
+          if (!record(static_cast<uint32_t>(offset), size))
+            return false;
+          starts_[offset / 4] = true;
+          offset += size;
+          if (offset > size_)
+            return false;
+        }
+
+        depth = 0;
+        if (!value(root, size_, depth) || (dictionary != 0 && !is(dictionary, BinaryTag::kDictionary, size_)))
+          return false;
+        return true;
+      }
+
+    private:
+      //-----------------------------------------------------------------------------------------------
+      /// Checks the record at the given offset and returns its size
+      bool record(uint32_t offset, uint64_t &size)
+      {
+        if (size_ - offset < 8 && read_word(data_ + offset) > static_cast<uint32_t>(BinaryTag::kTrue))
+          return false;
+
+        BinaryTag tag = static_cast<BinaryTag>(read_word(data_ + offset));
+        uint64_t count = tag >= BinaryTag::kString ? read_word(data_ + offset + 4) : 0;
+        uint32_t &depth = depths_[offset / 4];
+        switch (tag)
+        {
+        case BinaryTag::kNull:
+        case BinaryTag::kFalse:
+        case BinaryTag::kTrue:
+          size = 4;
+          return true;
+        case BinaryTag::kInteger:
+        case BinaryTag::kNumber:
+          size = 12;
+          return size_ - offset >= size;
+        case BinaryTag::kString:
+          size = string_record_size(count);
+          return size_ - offset >= size && data_[offset + 8 + count] == '\0';
+        case BinaryTag::kArray:
+          size = 8 + count * 4;
+          if (size_ - offset < size)
+            return false;
+          for (uint64_t i = 0; i < count; ++i)
+            if (!value(word(offset, 2 + i), offset, depth))
+              return false;
+          ++depth;
+          return true;
+        case BinaryTag::kObject:
+        case BinaryTag::kIndexedObject:
+          size = 8 + count * (tag == BinaryTag::kIndexedObject ? 12 : 8);
+          if (size_ - offset < size)
+            return false;
+          for (uint64_t i = 0; i < count; ++i)
+            if (!is(word(offset, 2 + i * 2), BinaryTag::kString, offset) || !value(word(offset, 3 + i * 2), offset, depth))
+              return false;
+          ++depth;
+          return tag == BinaryTag::kObject || index(offset, count);
+        case BinaryTag::kDictionary:
+          size = 8 + count * 4;
+          if (size_ - offset < size)
+            return false;
+          for (uint64_t i = 0; i < count; ++i)
+            if (!is(word(offset, 2 + i), BinaryTag::kString, offset))
+              return false;
+          return true;
+        default:
+          return false;
+        }
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Checks that the key index of an object holds every position in the order of the keys
+      bool index(uint32_t offset, uint64_t count)
+      {
+        JsonBinaryValue object(data_, offset);
+        seen_.assign(count, false);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+          uint32_t position = word(offset, 2 + count * 2 + i);
+          if (position >= count || seen_[position])
+            return false;
+          seen_[position] = true;
+          if (i > 0 && object.key(position) < object.key(word(offset, 2 + count * 2 + i - 1)))
+            return false;
+        }
+        return true;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Checks a reference to a value from the record at the given offset and raises the depth of
+      /// the children of that record to the depth of the value
+      bool value(uint32_t target, uint64_t from, uint32_t &depth)
+      {
+        if (!is_record(target, from))
+          return false;
+
+        BinaryTag tag = static_cast<BinaryTag>(read_word(data_ + target));
+        if (tag == BinaryTag::kDictionary)
+          return false;
+        if (tag == BinaryTag::kArray || tag == BinaryTag::kObject || tag == BinaryTag::kIndexedObject)
+        {
+          if (used_[target / 4])
+            return false;
+          used_[target / 4] = true;
+          depth = std::max(depth, depths_[target / 4]);
+        }
+        return true;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Checks a reference to a record of the given kind
+      bool is(uint32_t target, BinaryTag tag, uint64_t from)
+      {
+        return is_record(target, from) && static_cast<BinaryTag>(read_word(data_ + target)) == tag;
+      }
+
+      bool is_record(uint32_t target, uint64_t from) const { return target < from && target % 4 == 0 && starts_[target / 4]; }
+      uint32_t word(uint32_t offset, uint64_t index) const { return read_word(data_ + offset + index * 4); }
+
+    private:
+      const char *data_;
+      uint64_t size_;
+      std::vector<bool> starts_;
+      std::vector<bool> used_;
+      std::vector<bool> seen_;
+      std::vector<uint32_t> depths_;
+    };
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonType JsonBinaryValue::type() const
+  {
+    switch (tag())
+    {
+    case BinaryTag::kFalse:
+    case BinaryTag::kTrue:
+      return JsonType::kBoolean;
+    case BinaryTag::kInteger:
+    case BinaryTag::kNumber:
+      return JsonType::kNumber;
+    case BinaryTag::kString:
+      return JsonType::kString;
+    case BinaryTag::kArray:
+      return JsonType::kArray;
+    case BinaryTag::kObject:
+    case BinaryTag::kIndexedObject:
+      return JsonType::kObject;
+    default:
+      return JsonType::kNull;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  double JsonBinaryValue::number() const
+  {
+    if (is_integer())
+      return static_cast<double>(integer());
+
+    double value;
+    std::memcpy(&value, data_ + offset_ + 4, sizeof(value));
+    return value;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  int64_t JsonBinaryValue::integer() const
+  {
+    if (!is_integer())
+      return static_cast<int64_t>(number());
+
+    int64_t value;
+    std::memcpy(&value, data_ + offset_ + 4, sizeof(value));
+    return value;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryValue::try_get(StringRef name, JsonBinaryValue &result) const
+  {
+    size_t count = size();
+    if (tag() != BinaryTag::kIndexedObject)
+    {
+      for (size_t i = 0; i < count; ++i)
+      {
+        if (key(i) == name)
+        {
+          result = value(i);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Binary search for the first member with the key in the sorted positions
+    size_t first = 0, last = count;
+    while (first < last)
+    {
+      size_t middle = first + (last - first) / 2;
+      if (key(word(2 + count * 2 + middle)) < name)
+        first = middle + 1;
+      else
+        last = middle;
+    }
+
+    if (first == count || !(key(word(2 + count * 2 + first)) == name))
+      return false;
+    result = value(word(2 + count * 2 + first));
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryDocument::open(const char *data, size_t length, bool verify)
+  {
+    data_ = nullptr;
+    if (length < detail::kBinaryHeaderSize || length > UINT32_MAX || length % 4 != 0 ||
+      read_word(data) != detail::kBinaryMagic || read_word(data + 4) != detail::kBinaryVersion)
+      return false;
+
+    uint32_t root = read_word(data + 8), dictionary = read_word(data + 12), depth = 0;
+    if (verify ? !BinaryVerifier(data, length).verify(root, dictionary, depth) :
+      root < detail::kBinaryHeaderSize || root >= length || (dictionary != 0 && dictionary >= length))
+      return false;
+
+    data_ = data;
+    size_ = length;
+    root_ = root;
+    dictionary_ = dictionary;
+    depth_ = depth;
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonBinaryWriter::JsonBinaryWriter(const JsonBinaryOptions &options) : options_(options)
+  {
+    reset();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonBinaryWriter::reset()
+  {
+    buffer_.assign(detail::kBinaryHeaderSize, '\0');
+    put(0, detail::kBinaryMagic);
+    put(4, detail::kBinaryVersion);
+    stack_.clear();
+    items_.clear();
+    keys_.clear();
+    dictionary_.clear();
+    constants_[0] = constants_[1] = constants_[2] = 0;
+    keyPending_ = false;
+    complete_ = false;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  uint32_t JsonBinaryWriter::append(BinaryTag tag, size_t size)
+  {
+    size_t offset = buffer_.size();
+    if (size > UINT32_MAX - offset)
+      return 0;
+
+    buffer_.resize(offset + size, '\0');
+    put(offset, static_cast<uint32_t>(tag));
+    return static_cast<uint32_t>(offset);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  uint32_t JsonBinaryWriter::string(StringRef value, bool key)
+  {
+    std::unordered_map<std::string, uint32_t>::iterator it;
+    if (key && options_.keyDictionary)
+    {
+      it = keys_.emplace(std::string(value.data(), value.size()), 0).first;
+      if (it->second != 0)
+        return it->second;
+    }
+
+    uint32_t offset = value.size() < UINT32_MAX ?
+      append(BinaryTag::kString, static_cast<size_t>(string_record_size(value.size()))) : 0;
+    if (offset == 0)
+      return 0;
+
+    put(offset + 4, static_cast<uint32_t>(value.size()));
+    std::memcpy(&buffer_[offset + 8], value.data(), value.size());
+    if (key && options_.keyDictionary)
+    {
+      it->second = offset;
+      dictionary_.push_back(offset);
+    }
+    return offset;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  uint32_t JsonBinaryWriter::scalar(BinaryTag tag, const void *payload, size_t size)
+  {
+    // Constants are written once and shared by every value that refers to them
+    uint32_t *constant = tag <= BinaryTag::kTrue ? &constants_[static_cast<uint32_t>(tag)] : nullptr;
+    if (constant != nullptr && *constant != 0)
+      return *constant;
+
+    uint32_t offset = append(tag, 4 + size);
+    if (offset != 0 && size > 0)
+      std::memcpy(&buffer_[offset + 4], payload, size);
+    if (constant != nullptr)
+      *constant = offset;
+    return offset;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::can_add() const
+  {
+    if (stack_.empty())
+      return !complete_;
+    return !stack_.back().object || keyPending_;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::add(uint32_t offset)
+  {
+    if (offset == 0)
+      return false;
+
+    if (!stack_.empty())
+    {
+      keyPending_ = false;
+      items_.push_back(offset);
+      return true;
+    }
+
+    // The root is complete, the dictionary follows it
+    if (options_.keyDictionary && !dictionary_.empty())
+    {
+      uint32_t dictionary = append(BinaryTag::kDictionary, 8 + dictionary_.size() * 4);
+      if (dictionary == 0)
+        return false;
+      put(dictionary + 4, static_cast<uint32_t>(dictionary_.size()));
+      std::memcpy(&buffer_[dictionary + 8], dictionary_.data(), dictionary_.size() * 4);
+      put(12, dictionary);
+    }
+
+    put(8, offset);
+    complete_ = true;
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::Null()
+  {
+    return can_add() && add(scalar(BinaryTag::kNull, nullptr, 0));
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::Boolean(bool value)
+  {
+    return can_add() && add(scalar(value ? BinaryTag::kTrue : BinaryTag::kFalse, nullptr, 0));
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::Number(double value)
+  {
+    return can_add() && add(scalar(BinaryTag::kNumber, &value, sizeof(value)));
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::Integer(int64_t value)
+  {
+    return can_add() && add(scalar(BinaryTag::kInteger, &value, sizeof(value)));
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::String(StringRef value)
+  {
+    return can_add() && add(string(value, false));
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::StartObject()
+  {
+    if (!can_add())
+      return false;
+
+    keyPending_ = false;
+    Frame frame = { true, items_.size() };
+    stack_.push_back(frame);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::Key(StringRef key)
+  {
+    if (stack_.empty() || !stack_.back().object || keyPending_)
+      return false;
+
+    uint32_t offset = string(key, true);
+    if (offset == 0)
+      return false;
+
+    items_.push_back(offset);
+    keyPending_ = true;
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::EndObject()
+  {
+    return end_container(true);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::StartArray()
+  {
+    if (!can_add())
+      return false;
+
+    keyPending_ = false;
+    Frame frame = { false, items_.size() };
+    stack_.push_back(frame);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::EndArray()
+  {
+    return end_container(false);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::end_container(bool object)
+  {
+    if (stack_.empty() || stack_.back().object != object || keyPending_)
+      return false;
+
+    // The children were written before, now the table that refers to them follows
+    size_t first = stack_.back().first;
+    size_t words = items_.size() - first;
+    size_t count = object ? words / 2 : words;
+    bool indexed = object && count > options_.indexThreshold;
+    BinaryTag tag = !object ? BinaryTag::kArray : indexed ? BinaryTag::kIndexedObject : BinaryTag::kObject;
+
+    uint32_t offset = append(tag, 8 + (words + (indexed ? count : 0)) * 4);
+    if (offset == 0)
+      return false;
+
+    put(offset + 4, static_cast<uint32_t>(count));
+    if (words > 0)
+      std::memcpy(&buffer_[offset + 8], &items_[first], words * 4);
+
+    if (indexed)
+    {
+      JsonBinaryValue value(buffer_.data(), offset);
+      order_.resize(count);
+      for (size_t i = 0; i < count; ++i)
+        order_[i] = static_cast<uint32_t>(i);
+
+      // A stable sort keeps the first of duplicate keys first, which is the one that is found
+      std::stable_sort(order_.begin(), order_.end(), [&value](uint32_t a, uint32_t b) {
+        return value.key(a) < value.key(b);
+      });
+      std::memcpy(&buffer_[offset + 8 + words * 4], order_.data(), count * 4);
+    }
+
+    items_.resize(first);
+    stack_.pop_back();
+    return add(offset);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonBinaryWriter::Value(const JsonValue &value)
+  {
+    switch (value.type())
+    {
+    case JsonType::kObject:
+      if (!StartObject())
+        return false;
+      for (const JsonObject::Member &member : value.as<JsonObject>())
+        if (!Key(member.first) || !Value(*member.second))
+          return false;
+      return EndObject();
+    case JsonType::kArray:
+      if (!StartArray())
+        return false;
+      for (const JsonValue *element : value.as<JsonArray>())
+        if (!Value(*element))
+          return false;
+      return EndArray();
+    case JsonType::kBoolean:
+      return Boolean(value.as<JsonBoolean>().value());
+    case JsonType::kNumber:
+    {
+      const JsonNumber &number = value.as<JsonNumber>();
+      return number.is_integer() ? Integer(number.integer_value()) : Number(number.value());
+    }
+    case JsonType::kString:
+      return String(value.as<JsonString>().value());
+    default:
+      return Null();
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool encode_json_binary(const JsonValue &value, std::string &output, const JsonBinaryOptions &options)
+  {
+    JsonBinaryWriter writer(options);
+    if (!writer.Value(value))
+      return false;
+
+    StringRef data = writer.data();
+    output.assign(data.data(), data.size());
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool decode_json_binary(const char *data, size_t length, JsonDocument &document, const JsonParserOptions &options)
+  {
+    document.reset();
+
+    JsonBinaryDocument binary;
+    if (!binary.open(data, length) || (options.limits.maxDepth != 0 && binary.depth() > options.limits.maxDepth))
+      return false;
+
+    JsonDomBuilder builder(document);
+    if (options.borrowInput)
+      builder.set_borrowed_input(StringRef(data, length));
+    builder.set_key_table(options.keyTable);
+    builder.set_duplicate_keys(options.duplicateKeys);
+    if (!replay_json_binary(binary.root(), builder))
+    {
+      document.reset();
+      return false;
+    }
+
+    document.set_root(builder.root());
+    return true;
+  }
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace knowson {
+
+  namespace detail {
+
+    /// The kind of a record of the binary format, stored in its first word
+    enum class BinaryTag : uint32_t
+    {
+      kNull,
+      kFalse,
+      kTrue,
+      kInteger,
+      kNumber,
+      kString,
+      kArray,
+      kObject,
+      kIndexedObject,
+      kDictionary,
+    };
+
+    /// "KNBJ" read as a word in the byte order of the writer
+    const uint32_t kBinaryMagic = 0x4A424E4Bu;
+    const uint32_t kBinaryVersion = 1;
+    const uint32_t kBinaryHeaderSize = 16;
+
+    /// Reads a word of the binary format
+    inline uint32_t read_word(const char *data)
+    {
+      uint32_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return value;
+    }
+  }
+
+  /**
+   * @brief Options that control how documents are encoded in the binary format
+   */
+  struct JsonBinaryOptions
+  {
+  public:
+    /// Default constructor
+    JsonBinaryOptions() : keyDictionary(true), indexThreshold(8) {}
+
+    /// Set to true to store every distinct key once and to list the keys in a dictionary. Without
+    /// it, every member stores its own copy of its key.
+    bool keyDictionary;
+
+    /// Objects with more members than this get a sorted key index, so a member is found by binary
+    /// search instead of a linear scan
+    uint32_t indexThreshold;
+  };
+
+  /**
+   * @brief A value of a document in the binary format, read in place. The handle is two words and
+   *  is only valid while the buffer of the document is.
+   */
+  class JsonBinaryValue
+  {
+  public:
+    /// Constructs a handle that refers to no value
+    JsonBinaryValue() : data_(nullptr), offset_(0) {}
+    JsonBinaryValue(const char *data, uint32_t offset) : data_(data), offset_(offset) {}
+
+    /// Returns true if the handle refers to a value
+    bool valid() const { return data_ != nullptr; }
+
+    /// Returns the type of the value
+    JsonType type() const;
+
+    /// Returns the value of a boolean
+    bool boolean() const { return tag() == detail::BinaryTag::kTrue; }
+
+    /// Returns true if the value is a number without a fraction or exponent
+    bool is_integer() const { return tag() == detail::BinaryTag::kInteger; }
+
+    /// Returns the value of a number
+    double number() const;
+    int64_t integer() const;
+
+    /// Returns the value of a string, the string is null terminated
+    StringRef string() const { return StringRef(data_ + offset_ + 8, word(1)); }
+
+    /// Returns the number of elements of an array or members of an object
+    size_t size() const { return word(1); }
+
+    /// Returns the element of an array at the given index
+    JsonBinaryValue at(size_t index) const { return JsonBinaryValue(data_, word(2 + index)); }
+
+    /// Returns the key and value of the member of an object at the given position
+    StringRef key(size_t index) const { return JsonBinaryValue(data_, word(2 + index * 2)).string(); }
+    JsonBinaryValue value(size_t index) const { return JsonBinaryValue(data_, word(3 + index * 2)); }
+
+    /// Tries to return the member of an object with the given key. If the key occurs more than
+    /// once the first member is returned.
+    bool try_get(StringRef key, JsonBinaryValue &value) const;
+
+  private:
+    detail::BinaryTag tag() const { return static_cast<detail::BinaryTag>(word(0)); }
+    uint32_t word(size_t index) const { return detail::read_word(data_ + offset_ + index * 4); }
+
+  private:
+    const char *data_;
+    uint32_t offset_;
+  };
+
+  /**
+   * @brief A document in the binary format, read in place from a buffer or a mapped file.
+   *
+   *  The format is a header followed by 4 byte aligned records in the byte order of the machine
+   *  that wrote it. Every record starts with a word that holds its tag. Numbers follow as 8
+   *  bytes, strings as a length, the characters and a null terminator. Arrays hold a table with
+   *  the offsets of their elements, objects a table with the offsets of the key and value of
+   *  every member and, above the index threshold, the member positions sorted by key. Records
+   *  only refer to records before them, so a document is written in a single pass and checked in
+   *  another.
+   */
+  class JsonBinaryDocument
+  {
+  public:
+    /// Default constructor
+    JsonBinaryDocument() : data_(nullptr), size_(0), root_(0), dictionary_(0), depth_(0) {}
+
+    /// Opens a document in the given buffer, which must outlive the document. The header is
+    /// always checked; unless verify is false, so are all records, which reads the entire buffer.
+    /// Only skip verification for buffers that were written by this library.
+    bool open(const char *data, size_t length, bool verify = true);
+
+    /// Returns the root value or an invalid handle if no document is open
+    JsonBinaryValue root() const { return data_ != nullptr ? JsonBinaryValue(data_, root_) : JsonBinaryValue(); }
+
+    /// Returns the number of keys in the dictionary, which is 0 if there is none
+    size_t key_count() const { return dictionary_ != 0 ? detail::read_word(data_ + dictionary_ + 4) : 0; }
+
+    /// Returns the key at the given index of the dictionary
+    StringRef key(size_t index) const
+    {
+      return JsonBinaryValue(data_, detail::read_word(data_ + dictionary_ + 8 + index * 4)).string();
+    }
+
+    /// Returns the deepest nesting of objects and arrays, which is only known once the document
+    /// was verified and 0 otherwise
+    uint32_t depth() const { return depth_; }
+
+  private:
+    const char *data_;
+    size_t size_;
+    uint32_t root_;
+    uint32_t dictionary_;
+    uint32_t depth_;
+  };
+
+  /**
+   * @brief Encodes a stream of events in the binary format. The writer has the same methods as a
+   *  json handler, so it can be passed to parse_json_events directly to convert text without
+   *  building a tree. Every method returns false if the event is not valid at this point or the
+   *  document does not fit in 4 GiB.
+   */
+  class JsonBinaryWriter
+  {
+  public:
+    explicit JsonBinaryWriter(const JsonBinaryOptions &options = JsonBinaryOptions());
+
+    /// Json event handler
+    bool Null();
+    bool Boolean(bool value);
+    bool Number(double value);
+    bool Integer(int64_t value);
+    bool String(StringRef value);
+    bool StartObject();
+    bool Key(StringRef key);
+    bool EndObject();
+    bool StartArray();
+    bool EndArray();
+
+    /// Writes a value and everything in it
+    bool Value(const JsonValue &value);
+
+    /// Returns true once the root value is complete
+    bool complete() const { return complete_; }
+
+    /// Returns the encoded document, which is only complete once the root value is
+    StringRef data() const { return StringRef(buffer_.data(), buffer_.size()); }
+
+    /// Discards the output to prepare the writer for another document
+    void reset();
+
+  private:
+    struct Frame
+    {
+      bool object;
+      size_t first;
+    };
+
+    JsonBinaryWriter(const JsonBinaryWriter&) = delete;
+    JsonBinaryWriter& operator=(const JsonBinaryWriter&) = delete;
+
+    /// Returns true if a value may be written at this point
+    bool can_add() const;
+
+    /// Adds the record at the given offset as the next value
+    bool add(uint32_t offset);
+
+    /// Appends a record of the given size and returns its offset, or 0 if it does not fit
+    uint32_t append(detail::BinaryTag tag, size_t size);
+
+    /// Writes a word at the given offset
+    void put(size_t offset, uint32_t value) { std::memcpy(&buffer_[offset], &value, sizeof(value)); }
+
+    /// Appends a string record or returns the one that holds the same key
+    uint32_t string(StringRef value, bool key);
+
+    uint32_t scalar(detail::BinaryTag tag, const void *payload, size_t size);
+    bool end_container(bool object);
+
+  private:
+    JsonBinaryOptions options_;
+    std::string buffer_;
+    std::vector<Frame> stack_;
+    std::vector<uint32_t> items_;
+    std::vector<uint32_t> order_;
+    std::unordered_map<std::string, uint32_t> keys_;
+    std::vector<uint32_t> dictionary_;
+    uint32_t constants_[3];
+    bool keyPending_;
+    bool complete_;
+  };
+
+  /// Passes the events of a value in the binary format to a handler, for instance a JsonWriter
+  /// to convert it back to text. Returns false if the handler stopped. The containers are
+  /// replayed from an explicit stack, so deep documents do not depend on the size of the thread
+  /// stack.
+  template<typename Handler>
+  bool replay_json_binary(const JsonBinaryValue &root, Handler &handler)
+  {
+    struct Frame
+    {
+      JsonBinaryValue container;
+      size_t next;
+      bool object;
+    };
+
+    std::vector<Frame> stack;
+    JsonBinaryValue value = root;
+    for (;;)
+    {
+      bool handled;
+      switch (value.type())
+      {
+      case JsonType::kObject:
+      {
+        handled = handler.StartObject();
+        Frame frame = { value, 0, true };
+        stack.push_back(frame);
+        break;
+      }
+      case JsonType::kArray:
+      {
+        handled = handler.StartArray();
+        Frame frame = { value, 0, false };
+        stack.push_back(frame);
+        break;
+      }
+      case JsonType::kBoolean:
+        handled = handler.Boolean(value.boolean());
+        break;
+      case JsonType::kNumber:
+        handled = value.is_integer() ? handler.Integer(value.integer()) : handler.Number(value.number());
+        break;
+      case JsonType::kString:
+        handled = handler.String(value.string());
+        break;
+      default:
+        handled = handler.Null();
+        break;
+      }
+      if (!handled)
+        return false;
+
+      // Moves on to the next child of the innermost container, closing the containers that are
+      // complete on the way
+      for (;;)
+      {
+        if (stack.empty())
+          return true;
+
+        Frame &frame = stack.back();
+        if (frame.next < frame.container.size())
+        {
+          if (frame.object && !handler.Key(frame.container.key(frame.next)))
+            return false;
+          value = frame.object ? frame.container.value(frame.next) : frame.container.at(frame.next);
+          ++frame.next;
+          break;
+        }
+
+        if (!(frame.object ? handler.EndObject() : handler.EndArray()))
+          return false;
+        stack.pop_back();
+      }
+    }
+  }
+
+  /// Encodes a value in the binary format
+  bool encode_json_binary(const JsonValue &value, std::string &output, const JsonBinaryOptions &options = JsonBinaryOptions());
+
+  /// Decodes a document in the binary format into a tree. The buffer is verified first. With
+  /// options.borrowInput strings and keys are referenced in the buffer instead of copied, with
+  /// options.keyTable keys are interned and documents nested deeper than options.limits.maxDepth
+  /// are rejected; the other options do not apply.
+  bool decode_json_binary(const char *data, size_t length, JsonDocument &document,
+    const JsonParserOptions &options = JsonParserOptions());
+}
@@ -0,0 +1,512 @@
+#pragma once
+
+#include "flat_map.h"
+#include "json_reader.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace knowson {
+
+  /**
+   * @brief Specialize this template to make a struct bindable. The specialization provides a
+   *  static bind function that lists the members of the struct and their keys:
+   *
+   *    template<> struct JsonBinding<Person>
+   *    {
+   *      static void bind(JsonObjectBinder<Person> &binder)
+   *      {
+   *        binder.member("name", &Person::name, true);
+   *        binder.member("age", &Person::age);
+   *      }
+   *    };
+   *
+   *  Members can be bools, arithmetic types, std::string, std::vector of a bindable type or other
+   *  bound structs. None of them accepts null, a member that is null fails the bind; optional
+   *  members are left out of the document instead.
+   */
+  template<typename T> struct JsonBinding;
+
+  template<typename T> class JsonObjectBinder;
+
+  namespace detail {
+
+    struct ObjectBindingTable;
+
+    /**
+     * @brief Table of functions that store events in a value of a specific type. Entries that are
+     *  nullptr mark events that the type does not accept.
+     */
+    struct TypeBinder
+    {
+      bool (*null)(void *target);
+      bool (*boolean)(void *target, bool value);
+      bool (*number)(void *target, double value);
+      bool (*integer)(void *target, int64_t value);
+      bool (*string)(void *target, StringRef value);
+
+      /// Returns the members of a struct, binders are resolved lazily so types can be recursive
+      const ObjectBindingTable* (*object)();
+
+      /// Clears an array and appends a new element to it
+      void (*clear)(void *target);
+      void* (*append)(void *target, const TypeBinder *&binder);
+    };
+
+    /// Returns the binder of a type
+    template<typename T, typename Enable = void> struct TypeBinderFor;
+
+    /**
+     * @brief A member of a bound struct
+     */
+    struct MemberBinding
+    {
+      /// Storage for a pointer to a data member, they are plain offsets on all supported ABIs
+      typedef unsigned char MemberPointer[16];
+
+      StringRef name;
+      uint32_t hash;
+      uint64_t requiredBit;
+      const TypeBinder* (*binder)();
+      void* (*field)(const MemberPointer &pointer, void *object);
+      MemberPointer pointer;
+    };
+
+    /**
+     * @brief Members of a bound struct with a hash index over their keys. The table of a type is
+     *  built the first time a value of the type is bound.
+     */
+    struct ObjectBindingTable
+    {
+      std::vector<MemberBinding> members;
+      std::vector<uint32_t> slots;
+      uint64_t requiredMask;
+
+      /// False if the struct has more required members than fit in the mask
+      bool valid;
+
+      /// Returns the member with the given key or nullptr
+      const MemberBinding* find(StringRef key) const
+      {
+        if (slots.empty())
+          return nullptr;
+
+        uint32_t hash = hash_string(key.data(), key.size());
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; slots[i] != 0; i = (i + 1) & mask)
+        {
+          const MemberBinding &member = members[slots[i] - 1];
+          if (member.hash == hash && member.name == key)
+            return &member;
+        }
+        return nullptr;
+      }
+    };
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename T>
+    bool store_integer(void *target, int64_t value)
+    {
+      // Reject values that do not fit the member
+      if (std::is_unsigned<T>::value ? (value < 0 || static_cast<uint64_t>(value) > static_cast<uint64_t>(std::numeric_limits<T>::max())) :
+        (value < static_cast<int64_t>(std::numeric_limits<T>::min()) || value > static_cast<int64_t>(std::numeric_limits<T>::max())))
+        return false;
+
+      *static_cast<T*>(target) = static_cast<T>(value);
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename T>
+    bool store_integral_number(void *target, double value)
+    {
+      // Numbers with a fraction or out of the int64 range can not be stored in an integer
+      if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0) || std::floor(value) != value)
+        return false;
+      return store_integer<T>(target, static_cast<int64_t>(value));
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename T> bool store_floating(void *target, double value) { *static_cast<T*>(target) = static_cast<T>(value); return true; }
+    template<typename T> bool store_floating_integer(void *target, int64_t value) { *static_cast<T*>(target) = static_cast<T>(value); return true; }
+    inline bool store_boolean(void *target, bool value) { *static_cast<bool*>(target) = value; return true; }
+    inline bool store_string(void *target, StringRef value) { static_cast<std::string*>(target)->assign(value.data(), value.size()); return true; }
+
+    template<>
+    struct TypeBinderFor<bool>
+    {
+      static const TypeBinder* get()
+      {
+        static const TypeBinder binder = { nullptr, &store_boolean, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+        return &binder;
+      }
+    };
+
+    template<typename T>
+    struct TypeBinderFor<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+    {
+      static const TypeBinder* get()
+      {
+        static const TypeBinder binder = { nullptr, nullptr, &store_integral_number<T>, &store_integer<T>, nullptr, nullptr, nullptr, nullptr };
+        return &binder;
+      }
+    };
+
+    template<typename T>
+    struct TypeBinderFor<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    {
+      static const TypeBinder* get()
+      {
+        static const TypeBinder binder = { nullptr, nullptr, &store_floating<T>, &store_floating_integer<T>, nullptr, nullptr, nullptr, nullptr };
+        return &binder;
+      }
+    };
+
+    template<>
+    struct TypeBinderFor<std::string>
+    {
+      static const TypeBinder* get()
+      {
+        static const TypeBinder binder = { nullptr, nullptr, nullptr, nullptr, &store_string, nullptr, nullptr, nullptr };
+        return &binder;
+      }
+    };
+
+    template<typename T, typename Allocator>
+    struct TypeBinderFor<std::vector<T, Allocator>>
+    {
+      typedef std::vector<T, Allocator> Vector;
+      static_assert(!std::is_same<T, bool>::value, "std::vector<bool> can not be bound");
+
+      static void clear(void *target) { static_cast<Vector*>(target)->clear(); }
+
+      /// Elements are constructed in place and then filled by their own binder
+      static void* append(void *target, const TypeBinder *&binder)
+      {
+        Vector &vector = *static_cast<Vector*>(target);
+        vector.emplace_back();
+        binder = TypeBinderFor<T>::get();
+        return &vector.back();
+      }
+
+      static const TypeBinder* get()
+      {
+        static const TypeBinder binder = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &clear, &append };
+        return &binder;
+      }
+    };
+
+    template<typename T, typename Enable>
+    struct TypeBinderFor
+    {
+      static const ObjectBindingTable* table();
+      static ObjectBindingTable build();
+
+      static const TypeBinder* get()
+      {
+        static const TypeBinder binder = { nullptr, nullptr, nullptr, nullptr, nullptr, &table, nullptr, nullptr };
+        return &binder;
+      }
+    };
+  }
+
+  /**
+   * @brief Collects the members of a struct for JsonBinding
+   */
+  template<typename T>
+  class JsonObjectBinder
+  {
+  public:
+    /// Binds the member to the given key. Required members have to be present in every object, up
+    /// to 64 members per struct can be required; a struct with more fails every bind. Keys must be
+    /// string literals or otherwise outlive the program.
+    template<typename M>
+    JsonObjectBinder& member(const char *key, M T::*pointer, bool required = false)
+    {
+      static_assert(sizeof(pointer) <= sizeof(detail::MemberBinding::MemberPointer), "unsupported member pointer");
+
+      detail::MemberBinding member;
+      member.name = StringRef(key);
+      member.hash = detail::hash_string(member.name.data(), member.name.size());
+      member.requiredBit = 0;
+      assert(!required || requiredCount_ < 64);
+      if (required && requiredCount_++ < 64)
+        member.requiredBit = uint64_t(1) << (requiredCount_ - 1);
+      member.binder = &detail::TypeBinderFor<M>::get;
+      member.field = &field<M>;
+      std::memset(member.pointer, 0, sizeof(member.pointer));
+      std::memcpy(member.pointer, &pointer, sizeof(pointer));
+      table_.members.push_back(member);
+      return *this;
+    }
+
+  private:
+    template<typename, typename> friend struct detail::TypeBinderFor;
+
+    explicit JsonObjectBinder(detail::ObjectBindingTable &table) : table_(table), requiredCount_(0) {}
+
+    /// Returns the member of the object that the stored pointer refers to
+    template<typename M>
+    static void* field(const detail::MemberBinding::MemberPointer &storage, void *object)
+    {
+      M T::*pointer;
+      std::memcpy(&pointer, storage, sizeof(pointer));
+      return &(static_cast<T*>(object)->*pointer);
+    }
+
+    /// Builds the hash index once all members are known
+    void finish()
+    {
+      table_.requiredMask = 0;
+      for (const detail::MemberBinding &member : table_.members)
+        table_.requiredMask |= member.requiredBit;
+      table_.valid = requiredCount_ <= 64;
+
+      size_t slotCount = 4;
+      while (slotCount < table_.members.size() * 2)
+        slotCount <<= 1;
+      table_.slots.assign(slotCount, 0);
+
+      for (uint32_t i = 0; i < table_.members.size(); ++i)
+      {
+        size_t slot = table_.members[i].hash & (slotCount - 1);
+        while (table_.slots[slot] != 0)
+          slot = (slot + 1) & (slotCount - 1);
+        table_.slots[slot] = i + 1;
+      }
+    }
+
+  private:
+    detail::ObjectBindingTable &table_;
+    size_t requiredCount_;
+  };
+
+  namespace detail {
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename T, typename Enable>
+    const ObjectBindingTable* TypeBinderFor<T, Enable>::table()
+    {
+      static const ObjectBindingTable table = build();
+      return &table;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename T, typename Enable>
+    ObjectBindingTable TypeBinderFor<T, Enable>::build()
+    {
+      ObjectBindingTable table;
+      JsonObjectBinder<T> binder(table);
+      JsonBinding<T>::bind(binder);
+      binder.finish();
+      return table;
+    }
+  }
+
+  /**
+   * @brief Json event handler that fills a bound value directly from the token stream, without
+   *  building a tree. Keys that are not bound are skipped.
+   */
+  template<typename T>
+  class JsonBindingHandler
+  {
+  public:
+    /// Constructs a handler that fills the given value, the value must outlive the handler
+    explicit JsonBindingHandler(T &value) : value_(value), skipDepth_(0), error_(nullptr) { stack_.reserve(16); }
+
+    /// Returns a description of the reason the handler stopped the parse or nullptr
+    const char* error() const { return error_; }
+
+    /// Json event handler
+    bool Null() { return scalar([](const detail::TypeBinder &b, void *t) { return b.null != nullptr && b.null(t); }); }
+    bool Boolean(bool value) { return scalar([value](const detail::TypeBinder &b, void *t) { return b.boolean != nullptr && b.boolean(t, value); }); }
+    bool Number(double value) { return scalar([value](const detail::TypeBinder &b, void *t) { return b.number != nullptr && b.number(t, value); }); }
+    bool Integer(int64_t value) { return scalar([value](const detail::TypeBinder &b, void *t) { return b.integer != nullptr && b.integer(t, value); }); }
+    bool String(StringRef value) { return scalar([value](const detail::TypeBinder &b, void *t) { return b.string != nullptr && b.string(t, value); }); }
+
+    //-----------------------------------------------------------------------------------------------
+    bool StartObject()
+    {
+      void *target;
+      const detail::TypeBinder *binder;
+      if (!next(target, binder))
+        return true;
+      if (binder->object == nullptr)
+        return fail("object for a member that is not a struct");
+      if (!binder->object()->valid)
+        return fail("struct with more than 64 required members");
+
+      Frame frame = { target, binder, binder->object(), nullptr, nullptr, 0 };
+      stack_.push_back(frame);
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool Key(StringRef key)
+    {
+      if (skipDepth_ > 0)
+        return true;
+
+      Frame &frame = stack_.back();
+      const detail::MemberBinding *member = frame.table->find(key);
+      if (member == nullptr)
+      {
+        frame.next = nullptr;
+        return true;
+      }
+
+      frame.next = member->field(member->pointer, frame.target);
+      frame.nextBinder = member->binder();
+      frame.seen |= member->requiredBit;
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool EndObject()
+    {
+      if (skipDepth_ > 0)
+      {
+        --skipDepth_;
+        return true;
+      }
+
+      Frame &frame = stack_.back();
+      if ((frame.seen & frame.table->requiredMask) != frame.table->requiredMask)
+        return fail("missing required member");
+      stack_.pop_back();
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool StartArray()
+    {
+      void *target;
+      const detail::TypeBinder *binder;
+      if (!next(target, binder))
+        return true;
+      if (binder->append == nullptr)
+        return fail("array for a member that is not a vector");
+
+      binder->clear(target);
+      Frame frame = { target, binder, nullptr, nullptr, nullptr, 0 };
+      stack_.push_back(frame);
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool EndArray()
+    {
+      if (skipDepth_ > 0)
+        --skipDepth_;
+      else
+        stack_.pop_back();
+      return true;
+    }
+
+  private:
+    struct Frame
+    {
+      void *target;
+      const detail::TypeBinder *binder;
+      const detail::ObjectBindingTable *table;
+      void *next;
+      const detail::TypeBinder *nextBinder;
+      uint64_t seen;
+    };
+
+    //-----------------------------------------------------------------------------------------------
+    /// Returns the value that the next event is stored in. Returns false if the value is skipped,
+    /// containers that are skipped are tracked by depth only.
+    bool next(void *&target, const detail::TypeBinder *&binder)
+    {
+      if (skipDepth_ > 0)
+      {
+        ++skipDepth_;
+        return false;
+      }
+
+      if (stack_.empty())
+      {
+        target = &value_;
+        binder = detail::TypeBinderFor<T>::get();
+        return true;
+      }
+
+      Frame &frame = stack_.back();
+      if (frame.table == nullptr)
+      {
+        target = frame.binder->append(frame.target, binder);
+        return true;
+      }
+
+      if (frame.next == nullptr)
+      {
+        skipDepth_ = 1;
+        return false;
+      }
+
+      target = frame.next;
+      binder = frame.nextBinder;
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename Store>
+    bool scalar(const Store &store)
+    {
+      if (skipDepth_ > 0)
+        return true;
+
+      void *target;
+      const detail::TypeBinder *binder;
+      if (!next(target, binder))
+      {
+        // A skipped scalar does not open a container
+        skipDepth_ = 0;
+        return true;
+      }
+
+      if (!store(*binder, target))
+        return fail("value does not match the type of the member");
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    bool fail(const char *error)
+    {
+      error_ = error;
+      return false;
+    }
+
+  private:
+    T &value_;
+    std::vector<Frame> stack_;
+    size_t skipDepth_;
+    const char *error_;
+  };
+
+  /// Parses a json document from a contiguous buffer straight into a bound value. Returns false if
+  /// the document is malformed or does not match the bound types.
+  template<typename T>
+  bool parse_json_into(const char *data, size_t length, T &value, IJsonParserLog *log = nullptr,
+    JsonDocumentType documentType = JsonDocumentType::kUnknown)
+  {
+    JsonBindingHandler<T> handler(value);
+    return parse_json_events(data, length, handler, log, documentType);
+  }
+
+  /// Parses a json document from a source straight into a bound value
+  template<typename T>
+  bool parse_json_into(IJsonParserSource *source, T &value, IJsonParserLog *log = nullptr,
+    JsonDocumentType documentType = JsonDocumentType::kUnknown)
+  {
+    JsonBindingHandler<T> handler(value);
+    return parse_json_events(source, handler, log, documentType);
+  }
+}
@@ -0,0 +1,56 @@
+#include "json_document.h"
+#include "json_lazy.h"
+
+namespace knowson {
+
+  //-----------------------------------------------------------------------------------------------
+  JsonDocument::JsonDocument(JsonDocument &&other) :
+    arena_(new Arena(Arena::kDefaultPageSize)),
+    root_(other.root_),
+    attached_(std::move(other.attached_)),
+    lazy_(other.lazy_)
+  {
+    arena_.swap(other.arena_);
+    other.root_ = nullptr;
+    other.lazy_ = nullptr;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonDocument& JsonDocument::operator=(JsonDocument &&other)
+  {
+    if (this != &other)
+    {
+      // The other document takes over the arena of this one and releases its values
+      arena_.swap(other.arena_);
+      root_ = other.root_;
+      attached_ = std::move(other.attached_);
+      lazy_ = other.lazy_;
+      other.clear();
+    }
+    return *this;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonDocument::clear()
+  {
+    root_ = nullptr;
+    lazy_ = nullptr;
+    arena_->clear();
+    attached_.clear();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonDocument::reset()
+  {
+    root_ = nullptr;
+    lazy_ = nullptr;
+    arena_->reset();
+    attached_.clear();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonDocument::valid() const
+  {
+    return lazy_ == nullptr || lazy_->valid;
+  }
+}
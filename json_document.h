@@ -0,0 +1,82 @@
+#pragma once
+
+#include "json.h"
+
+#include <memory>
+
+namespace knowson {
+
+  namespace detail {
+    struct LazyIndex;
+  }
+
+  /**
+   * @brief Owns a tree of json values. All values and their strings are allocated from a single
+   *  Arena and are freed together when the document is cleared or destroyed.
+   */
+  class JsonDocument
+  {
+  public:
+    /// Default constructor
+    explicit JsonDocument(size_t pageSize = Arena::kDefaultPageSize) : arena_(new Arena(pageSize)), root_(nullptr), lazy_(nullptr) {}
+
+    /// Move constructor. The values keep pointing at the arena they were allocated from, so the
+    /// arena itself is handed over and the other document continues with a new, empty one.
+    JsonDocument(JsonDocument &&other);
+
+    /// Move assignment, the values of this document are released
+    JsonDocument& operator=(JsonDocument &&other);
+
+    /// Returns the root value of the document or nullptr if the document is empty
+    const JsonValue* root() const { return root_; }
+    JsonValue* root() { return root_; }
+
+    /// Sets the root value. The value must be owned by this document.
+    void set_root(JsonValue *root) { root_ = root; }
+
+    /// Releases all values owned by the document
+    void clear();
+
+    /// Releases all values but keeps the memory of the document, values created afterwards reuse
+    /// it. Parsing into a document resets it, so parsing documents of a similar size into the
+    /// same JsonDocument does not allocate once it is warm.
+    void reset();
+
+    /// Transfers ownership of another document to this one. Values of this document may then refer
+    /// to values of the attached document, which is released together with this document.
+    void attach(std::unique_ptr<JsonDocument> document) { attached_.push_back(std::move(document)); }
+
+    /// Returns false if a container of a lazily parsed document turned out to be malformed when it
+    /// was first accessed. Such a container only holds the values that precede the error.
+    bool valid() const;
+
+    /// Sets the structural index of a lazily parsed document, see JsonParserOptions::lazy
+    void set_lazy_index(detail::LazyIndex *index) { lazy_ = index; }
+
+    /// Returns the arena that owns the values of this document
+    Arena& arena() { return *arena_; }
+
+    /// Creates values that are owned by this document
+    JsonObject* create_object() { return arena_->create<JsonObject>(*arena_); }
+    JsonArray* create_array() { return arena_->create<JsonArray>(*arena_); }
+    JsonBoolean* create_boolean(bool value) { return arena_->create<JsonBoolean>(value); }
+    JsonNumber* create_number(double value) { return arena_->create<JsonNumber>(value); }
+    JsonNumber* create_integer(int64_t value) { return arena_->create<JsonNumber>(value); }
+    JsonString* create_string(StringRef value) { return arena_->create<JsonString>(copy_string(value)); }
+    JsonNull* create_null() { return arena_->create<JsonNull>(); }
+
+    /// Copies the given string into the document
+    StringRef copy_string(StringRef value) { return StringRef(arena_->copy_string(value.data(), value.size()), value.size()); }
+
+  private:
+    JsonDocument(const JsonDocument&) = delete;
+    JsonDocument& operator=(const JsonDocument&) = delete;
+
+  private:
+    /// Containers hold a pointer to the arena, so it must not move when the document does
+    std::unique_ptr<Arena> arena_;
+    JsonValue *root_;
+    std::vector<std::unique_ptr<JsonDocument>> attached_;
+    detail::LazyIndex *lazy_;
+  };
+}
@@ -0,0 +1,75 @@
+#include "json_dom_builder.h"
+
+namespace knowson {
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonDomBuilder::StartObject()
+  {
+    JsonObject *object = document_.create_object();
+    if (!add(object))
+      return false;
+
+    stack_.push_back(object);
+    starts_.push_back(members_.size());
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonDomBuilder::EndObject()
+  {
+    JsonObject *object = static_cast<JsonObject*>(stack_.back());
+    stack_.pop_back();
+    size_t start = starts_.back();
+    starts_.pop_back();
+
+    // Sizing the object up front builds its storage and hash index once
+    object->reserve(members_.size() - start);
+    for (size_t i = start; i < members_.size(); ++i)
+    {
+      if (!object->insert(members_[i].first, members_[i].second, duplicates_) &&
+        duplicates_ == JsonDuplicateKeys::kReject)
+      {
+        duplicate_ = true;
+        return false;
+      }
+    }
+    members_.resize(start);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonDomBuilder::StartArray()
+  {
+    JsonArray *arr = document_.create_array();
+    if (!add(arr))
+      return false;
+
+    stack_.push_back(arr);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonDomBuilder::add(JsonValue *value)
+  {
+    if (++nodes_ > maxNodes_ && maxNodes_ != 0)
+      return false;
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+    if (stats_ != nullptr)
+      ++stats_->nodes[static_cast<size_t>(value->type())];
+#endif
+
+    if (stack_.empty())
+    {
+      root_ = value;
+      return true;
+    }
+
+    JsonValue *parent = stack_.back();
+    if (parent->type() == JsonType::kObject)
+      members_.emplace_back(key_, value);
+    else
+      static_cast<JsonArray*>(parent)->emplace_back(value);
+    return true;
+  }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "json_document.h"
+#include "json_parser.h"
+#include "key_table.h"
+
+#include <vector>
+
+namespace knowson {
+
+  /**
+   * @brief Json event handler that builds a tree of values in a JsonDocument. Strings and keys are
+   *  copied into the document unless they lie within the borrowed input range, or for keys, unless
+   *  a key table is set. Members of an object are collected until it closes and then inserted
+   *  at once. The stack of open containers and the collected members are allocated from the
+   *  document as well, so the builder must be reset after the document is.
+   */
+  class JsonDomBuilder
+  {
+  public:
+    /// Default constructor
+    explicit JsonDomBuilder(JsonDocument &document) : document_(document), root_(nullptr),
+      stack_(document.arena()), members_(document.arena()), starts_(document.arena()), keys_(nullptr),
+      nodes_(0), maxNodes_(0), duplicates_(JsonDuplicateKeys::kKeepFirst), duplicate_(false) {}
+
+    /// Returns the root value that was built or nullptr if no value was completed yet
+    JsonValue* root() const { return root_; }
+
+    /// Prepares the builder for another document in the same JsonDocument after the document was
+    /// reset
+    void reset()
+    {
+      root_ = nullptr;
+      Stack(document_.arena()).swap(stack_);
+      MemberList(document_.arena()).swap(members_);
+      OffsetList(document_.arena()).swap(starts_);
+      nodes_ = 0;
+      duplicate_ = false;
+    }
+
+    /// Prepares the builder for another value in the same JsonDocument without the document being
+    /// reset in between. The memory of the stack and the collected members is kept for reuse.
+    void restart()
+    {
+      root_ = nullptr;
+      stack_.clear();
+      members_.clear();
+      starts_.clear();
+      nodes_ = 0;
+      duplicate_ = false;
+    }
+
+    /// Sets a range of memory that outlives the document. Strings and keys that lie within this
+    /// range are referenced by the document instead of copied.
+    void set_borrowed_input(StringRef input) { borrowed_ = input; }
+
+    /// Sets a table that keys are interned in instead of being stored in the document. The table
+    /// must outlive the document.
+    void set_key_table(KeyTable *keys) { keys_ = keys; }
+
+    /// Sets the statistics that created values are counted in. Does nothing unless the library is
+    /// built with KNOWSON_ENABLE_PARSE_STATS.
+    void set_stats(JsonParseStats *stats)
+    {
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+      stats_ = stats;
+#else
+      (void)stats;
+#endif
+    }
+
+    /// Sets the maximum number of values that are built, 0 means no limit. Adding a value beyond
+    /// the limit stops the parse.
+    void set_max_nodes(size_t maxNodes) { maxNodes_ = maxNodes; }
+
+    /// Returns true if the parse was stopped because the maximum number of values was reached
+    bool limit_exceeded() const { return maxNodes_ != 0 && nodes_ > maxNodes_; }
+
+    /// Sets what happens with a key that occurs twice in an object. With kReject the parse stops
+    /// when the object that contains the duplicate closes.
+    void set_duplicate_keys(JsonDuplicateKeys duplicates) { duplicates_ = duplicates; }
+
+    /// Returns true if the parse was stopped because of a duplicate key
+    bool duplicate_key() const { return duplicate_; }
+
+    /// Json event handler
+    bool Null() { return add(document_.create_null()); }
+    bool Boolean(bool value) { return add(document_.create_boolean(value)); }
+    bool Number(double value) { return add(document_.create_number(value)); }
+    bool Integer(int64_t value) { return add(document_.create_integer(value)); }
+    bool String(StringRef value) { return add(document_.arena().create<JsonString>(store(value))); }
+    bool Key(StringRef key) { key_ = keys_ != nullptr ? keys_->intern(key) : store(key); return true; }
+    bool StartObject();
+    bool EndObject();
+    bool StartArray();
+    bool EndArray() { stack_.pop_back(); return true; }
+
+  private:
+    typedef std::vector<JsonValue*, ArenaAllocator<JsonValue*>> Stack;
+    typedef std::vector<JsonObject::Member, ArenaAllocator<JsonObject::Member>> MemberList;
+    typedef std::vector<size_t, ArenaAllocator<size_t>> OffsetList;
+
+    /// Adds a value to the container that is currently being built
+    bool add(JsonValue *value);
+
+    /// Returns the given string in memory that lives at least as long as the document
+    StringRef store(StringRef value)
+    {
+      if (!borrowed_.empty() && value.data() >= borrowed_.data() && value.end() <= borrowed_.end())
+        return value;
+      return document_.copy_string(value);
+    }
+
+  private:
+    JsonDocument &document_;
+    JsonValue *root_;
+    Stack stack_;
+    MemberList members_;
+    OffsetList starts_;
+    StringRef key_;
+    StringRef borrowed_;
+    KeyTable *keys_;
+    size_t nodes_;
+    size_t maxNodes_;
+    JsonDuplicateKeys duplicates_;
+    bool duplicate_;
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+    JsonParseStats *stats_ = nullptr;
+#endif
+  };
+}
@@ -0,0 +1,454 @@
+#include "json_lazy.h"
+#include "json_reader.h"
+#include "json_scan.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace knowson {
+
+  namespace
+  {
+    /**
+     * @brief Records the position of every object and array of a document from its structural
+     *  characters. Strings end at the next quote that is not escaped and comments at the next
+     *  newline, just like in the tokenizer. A quote or comment within an identifier is part of
+     *  the identifier.
+     */
+    class BracketIndexer
+    {
+    public:
+      enum Result { kContinue, kSkipLine, kDone, kInvalid };
+
+    public:
+      /// Constructs an indexer for the document that starts at data
+      BracketIndexer(const char *data, bool simplified, std::vector<detail::LazyContainer> &containers) :
+        data_(data), stringEnd_(nullptr), simplified_(simplified), inString_(false), containers_(containers) {}
+
+      /// Processes a structural character. kSkipLine means the rest of the line is a comment,
+      /// kDone that the root ended.
+      Result visit(const char *p, const char *end)
+      {
+        if (inString_)
+        {
+          inString_ = *p != '"' || detail::is_escaped(data_, p);
+          stringEnd_ = p;
+          return kContinue;
+        }
+
+        switch (*p)
+        {
+        case '"':
+          inString_ = starts_token(p);
+          return kContinue;
+        case '{':
+        case '[':
+        {
+          stack_.push_back(static_cast<uint32_t>(containers_.size()));
+          detail::LazyContainer container = { offset(p), 0, 0 };
+          containers_.push_back(container);
+          return kContinue;
+        }
+        case '}':
+        case ']':
+        {
+          // The braceless root of a simplified document ends at a closing brace, a stray bracket
+          // is left to the parser of the root
+          if (stack_.empty())
+            return *p == '}' ? kDone : kContinue;
+
+          detail::LazyContainer &container = containers_[stack_.back()];
+          if (data_[container.open] != (*p == '}' ? '{' : '['))
+            return kInvalid;
+
+          container.close = offset(p);
+          container.after = static_cast<uint32_t>(containers_.size());
+          stack_.pop_back();
+          return stack_.empty() && !simplified_ ? kDone : kContinue;
+        }
+        case ',':
+          return kContinue;
+        default:
+          // Either a sign or a comment. Comments only start where a token can start.
+          return p + 1 != end && p[1] == *p && starts_token(p) ? kSkipLine : kContinue;
+        }
+      }
+
+      /// Returns true if every string and container that was opened is closed again
+      bool balanced() const { return !inString_ && stack_.empty(); }
+
+    private:
+      uint32_t offset(const char *p) const { return static_cast<uint32_t>(p - data_); }
+
+      /// Returns true if a token can start at the character, which is the case after a delimiter
+      /// or a string
+      bool starts_token(const char *p) const
+      {
+        return p == data_ || p - 1 == stringEnd_ || detail::is_delimiter(p[-1], simplified_);
+      }
+
+    private:
+      const char *data_;
+      const char *stringEnd_;
+      bool simplified_;
+      bool inString_;
+      std::vector<uint32_t> stack_;
+      std::vector<detail::LazyContainer> &containers_;
+    };
+
+    //-----------------------------------------------------------------------------------------------
+    /// Feeds the structural characters of [p, end) to the indexer until it is done. Returns the
+    /// result and the position after the last character visited.
+    BracketIndexer::Result index_brackets(const char *&p, const char *end, BracketIndexer &indexer)
+    {
+      BracketIndexer::Result result = BracketIndexer::kContinue;
+      while (p != end)
+      {
+#if defined(KNOWSON_SCAN_SIMD)
+        // Visit all structural characters of a chunk before loading the next one
+        if (static_cast<size_t>(end - p) >= detail::ScanChunk::kSize)
+        {
+          uint32_t mask = detail::structural_mask(p);
+          const char *next = p + detail::ScanChunk::kSize;
+          for (; mask != 0; mask &= mask - 1)
+          {
+            const char *c = p + detail::trailing_zeros(mask);
+            if ((result = indexer.visit(c, end)) != BracketIndexer::kContinue)
+            {
+              next = c + 1;
+              break;
+            }
+          }
+          p = next;
+        }
+        else
+#endif
+        if (detail::is_structural(*p))
+          result = indexer.visit(p++, end);
+        else
+          ++p;
+
+        if (result == BracketIndexer::kSkipLine)
+        {
+          p = detail::find_newline(p, end);
+          result = BracketIndexer::kContinue;
+        }
+        else if (result != BracketIndexer::kContinue)
+          break;
+      }
+      return result;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Reports an error at the given position of the text
+    bool report(IJsonParserLog *log, const char *data, size_t length, const char *p, JsonParseErrorCode code,
+      detail::TokenType found)
+    {
+      if (log == nullptr)
+        return false;
+
+      detail::SpanInput input(data, length);
+      input.advance(static_cast<size_t>(p - data));
+
+      JsonParseError error;
+      error.code = code;
+      error.found = static_cast<uint32_t>(found);
+      error.offset = input.offset();
+      input.location(error.line, error.column);
+      log->Report(error);
+      return false;
+    }
+
+    /**
+     * @brief Parses the direct children of a container of a lazy document. Nested containers are
+     *  not parsed but skipped over with the index, they become lazy containers themselves.
+     */
+    class LazyLoader
+    {
+    public:
+      /// Constructs a loader for the text between the brackets of the container
+      explicit LazyLoader(const detail::LazyNode &node) :
+        index_(*node.index),
+        context_(nullptr, index_.documentType, begin(node), static_cast<size_t>(end(node) - begin(node))),
+        child_(node.container == detail::kLazyRoot ? 0 : node.container + 1) {}
+
+      /// Parses the members of an object
+      bool load(JsonObject &object)
+      {
+        JsonDocumentType type = context_.document_type();
+        context_.next();
+        while (context_.token().type != detail::TokenType::kEOF)
+        {
+          if ((type == JsonDocumentType::kNormal && !detail::expect<detail::TokenType::kString>(context_, false)) ||
+            (type == JsonDocumentType::kSimplified && !detail::expect<detail::TokenType::kString, detail::TokenType::kIdentifier>(context_, false)))
+            return false;
+
+          StringRef key = index_.keys != nullptr ? index_.keys->intern(context_.text()) : string_text();
+          context_.next();
+
+          if (!detail::expect<detail::TokenType::kSeperator>(context_))
+            return false;
+
+          JsonValue *value = parse_value();
+          if (value == nullptr)
+            return false;
+          object.insert(key, value);
+
+          // Must be a comma present in normal json
+          if (type == JsonDocumentType::kNormal &&
+            context_.token().type != detail::TokenType::kComma &&
+            context_.token().type != detail::TokenType::kEOF)
+            return false;
+
+          if (context_.token().type == detail::TokenType::kComma)
+            context_.next();
+        }
+        return true;
+      }
+
+      /// Parses the elements of an array
+      bool load(JsonArray &array)
+      {
+        JsonDocumentType type = context_.document_type();
+        context_.next();
+        while (context_.token().type != detail::TokenType::kEOF)
+        {
+          JsonValue *value = parse_value();
+          if (value == nullptr)
+            return false;
+          array.emplace_back(value);
+
+          // Must be a comma present in normal json
+          if (type == JsonDocumentType::kNormal &&
+            context_.token().type != detail::TokenType::kComma &&
+            context_.token().type != detail::TokenType::kEOF)
+            return false;
+
+          if (context_.token().type == detail::TokenType::kComma)
+            context_.next();
+        }
+        return true;
+      }
+
+    private:
+      /// Returns the text of the node without its brackets
+      static const char* begin(const detail::LazyNode &node)
+      {
+        return node.container == detail::kLazyRoot ? node.index->data :
+          node.index->data + node.index->containers[node.container].open + 1;
+      }
+      static const char* end(const detail::LazyNode &node)
+      {
+        return node.index->data + (node.container == detail::kLazyRoot ? node.index->rootEnd :
+          node.index->containers[node.container].close);
+      }
+
+      /// Returns the text of the current string. Strings are referenced in the text of the
+      /// document unless their escape sequences had to be decoded.
+      StringRef string_text()
+      {
+        return context_.token().escaped ? index_.values->copy_string(context_.text()) : context_.text();
+      }
+
+      /// Creates the value of the current token and moves past it. Returns nullptr if the token
+      /// does not start a value.
+      JsonValue* parse_value()
+      {
+        JsonDocument &values = *index_.values;
+        JsonValue *value;
+        switch (context_.token().type)
+        {
+        case detail::TokenType::kBraceLeft:
+        case detail::TokenType::kCurlyLeft:
+          return skip_container();
+        case detail::TokenType::kNumber:
+        {
+          StringRef text(context_.text());
+          detail::ParsedNumber number;
+          if (!detail::parse_number(text.begin(), text.end(), number))
+            return nullptr;
+          value = number.isInteger ? values.create_integer(number.integer) : values.create_number(number.value);
+          break;
+        }
+        case detail::TokenType::kString:
+          value = values.arena().create<JsonString>(string_text());
+          break;
+        case detail::TokenType::kTrue:
+          value = values.create_boolean(true);
+          break;
+        case detail::TokenType::kFalse:
+          value = values.create_boolean(false);
+          break;
+        case detail::TokenType::kNull:
+          value = values.create_null();
+          break;
+        default:
+          return nullptr;
+        }
+
+        context_.next();
+        return value;
+      }
+
+      /// Creates a lazy container for the nested container at the current token and moves past
+      /// its closing bracket
+      JsonValue* skip_container()
+      {
+        // The tokenizer has to agree with the index on where the container starts
+        if (child_ >= index_.count ||
+          context_.token().selection.start != index_.data + index_.containers[child_].open)
+          return nullptr;
+
+        const detail::LazyContainer &container = index_.containers[child_];
+        Arena &arena = index_.values->arena();
+        detail::LazyNode *node = arena.create<detail::LazyNode>();
+        node->index = &index_;
+        node->container = child_;
+
+        JsonValue *value;
+        if (context_.token().type == detail::TokenType::kCurlyLeft)
+          value = arena.create<JsonObject>(arena, node);
+        else
+          value = arena.create<JsonArray>(arena, node);
+
+        context_.source().seek(index_.data + container.close + 1);
+        child_ = container.after;
+        context_.next();
+        return value;
+      }
+
+    private:
+      detail::LazyIndex &index_;
+      detail::ParseContext<detail::SpanInput> context_;
+      uint32_t child_;
+    };
+
+    //-----------------------------------------------------------------------------------------------
+    /// Indexes the brackets of a document whose values are kept in the given document, copying
+    /// the text into that document first if requested
+    bool parse_lazy(std::unique_ptr<JsonDocument> values, const char *data, size_t length, bool copyText,
+      JsonDocument &document, const JsonParserOptions &options, IJsonParserLog *log)
+    {
+      document.reset();
+
+      // The containers are parsed on access, so only the size of the text is limited
+      if (options.limits.maxBytes != 0 && length > options.limits.maxBytes)
+        return report(log, data, length, data + options.limits.maxBytes, JsonParseErrorCode::kSizeLimit,
+          detail::TokenType::kEOF);
+
+      // Positions in the index are 32 bit
+      if (length >= detail::kLazyRoot)
+      {
+        JsonParserOptions eager = options;
+        eager.lazy = false;
+        return parse_json(data, length, document, eager, log);
+      }
+
+      if (copyText)
+        data = values->arena().copy_string(data, length);
+      const char *end = data + length;
+
+      // Determine content type
+      JsonDocumentType documentType = options.documentType;
+      detail::ParseContext<detail::SpanInput> probe(nullptr, documentType, data, length);
+      probe.next();
+      bool bracket = probe.token().type == detail::TokenType::kCurlyLeft || probe.token().type == detail::TokenType::kBraceLeft;
+      if (documentType == JsonDocumentType::kUnknown)
+        documentType = bracket ? JsonDocumentType::kNormal : JsonDocumentType::kSimplified;
+
+      if (documentType == JsonDocumentType::kNormal && !bracket)
+      {
+        detail::ParseContext<detail::SpanInput> context(log, documentType, data, length);
+        context.next();
+        return detail::unexpected_token<detail::TokenType::kCurlyLeft, detail::TokenType::kBraceLeft>(context);
+      }
+
+      // Index the brackets of the root and everything it contains
+      std::vector<detail::LazyContainer> containers;
+      bool simplified = documentType == JsonDocumentType::kSimplified;
+      BracketIndexer indexer(data, simplified, containers);
+      const char *p = simplified ? data : probe.token().selection.start;
+      BracketIndexer::Result result = index_brackets(p, end, indexer);
+      if (result == BracketIndexer::kInvalid)
+        return report(log, data, length, p - 1, JsonParseErrorCode::kUnexpectedToken,
+          p[-1] == '}' ? detail::TokenType::kCurlyRight : detail::TokenType::kBraceRight);
+      if (result != BracketIndexer::kDone && !(simplified && indexer.balanced()))
+        return report(log, data, length, end, JsonParseErrorCode::kUnexpectedEOF, detail::TokenType::kEOF);
+
+      Arena &arena = values->arena();
+      detail::LazyContainer *copy = nullptr;
+      if (!containers.empty())
+      {
+        copy = static_cast<detail::LazyContainer*>(arena.allocate(containers.size() * sizeof(detail::LazyContainer), alignof(detail::LazyContainer)));
+        std::memcpy(copy, containers.data(), containers.size() * sizeof(detail::LazyContainer));
+      }
+
+      detail::LazyIndex *index = arena.create<detail::LazyIndex>();
+      index->values = values.get();
+      index->data = data;
+      index->containers = copy;
+      index->count = static_cast<uint32_t>(containers.size());
+      index->rootEnd = static_cast<uint32_t>((result == BracketIndexer::kDone ? p - 1 : end) - data);
+      index->documentType = documentType;
+      index->keys = options.keyTable;
+      index->valid = true;
+
+      detail::LazyNode *node = arena.create<detail::LazyNode>();
+      node->index = index;
+      node->container = simplified ? detail::kLazyRoot : 0;
+
+      JsonValue *root;
+      if (simplified || data[copy[0].open] == '{')
+        root = arena.create<JsonObject>(arena, node);
+      else
+        root = arena.create<JsonArray>(arena, node);
+
+      document.set_root(root);
+      document.set_lazy_index(index);
+      document.attach(std::move(values));
+      return true;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  // The members of JsonObject and JsonArray that parse lazy containers live here with the rest of
+  // the lazy parser.
+  void JsonObject::materialize() const
+  {
+    detail::LazyNode *node = lazy_;
+    lazy_ = nullptr;
+
+    LazyLoader loader(*node);
+    if (!loader.load(const_cast<JsonObject&>(*this)))
+      node->index->valid = false;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonArray::materialize() const
+  {
+    detail::LazyNode *node = lazy_;
+    lazy_ = nullptr;
+
+    LazyLoader loader(*node);
+    if (!loader.load(const_cast<JsonArray&>(*this)))
+      node->index->valid = false;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool detail::parse_json_lazy(const char *data, size_t length, JsonDocument &document,
+    const JsonParserOptions &options, IJsonParserLog *log)
+  {
+    // The values live in a document of their own so they keep their address when the parsed
+    // document is moved
+    return parse_lazy(std::unique_ptr<JsonDocument>(new JsonDocument()), data, length, !options.borrowInput,
+      document, options, log);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool detail::parse_json_lazy(std::unique_ptr<JsonDocument> values, const char *data, size_t length,
+    JsonDocument &document, const JsonParserOptions &options, IJsonParserLog *log)
+  {
+    return parse_lazy(std::move(values), data, length, false, document, options, log);
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace knowson {
+
+  namespace detail {
+
+    /**
+     * @brief The position of an object or array in the text of a lazy document. Containers are
+     *  stored in the order of their opening brackets, so the containers nested in one directly
+     *  follow it, up to the index in after.
+     */
+    struct LazyContainer
+    {
+      uint32_t open;
+      uint32_t close;
+      uint32_t after;
+    };
+
+    /**
+     * @brief Structural index of a lazily parsed document. The index and the values that are
+     *  materialized from it are owned by a document that is attached to the parsed document.
+     */
+    struct LazyIndex
+    {
+      /// Document that owns the index and the materialized values
+      JsonDocument *values;
+
+      /// The text of the document, which outlives the values
+      const char *data;
+
+      /// The containers of the document
+      const LazyContainer *containers;
+      uint32_t count;
+
+      /// The range of a simplified root object, which has no brackets
+      uint32_t rootBegin;
+      uint32_t rootEnd;
+
+      JsonDocumentType documentType;
+      KeyTable *keys;
+
+      /// Set to false once a container turns out to be malformed
+      bool valid;
+    };
+
+    /// Container index of the braceless root of a simplified document
+    const uint32_t kLazyRoot = UINT32_MAX;
+
+    /**
+     * @brief The text of an object or array that has not been parsed yet
+     */
+    struct LazyNode
+    {
+      LazyIndex *index;
+      uint32_t container;
+    };
+
+    /// Indexes the brackets of a document and creates a root whose children are parsed on first
+    /// access. The text must outlive the document. Only the nesting of brackets, strings and the
+    /// root are checked here; any other error is found when the container that holds it is
+    /// accessed, see JsonDocument::valid.
+    bool parse_json_lazy(const char *data, size_t length, JsonDocument &document, const JsonParserOptions &options,
+      IJsonParserLog *log);
+
+    /// Indexes a text that is kept in the arena of the given document instead of copying it. The
+    /// document becomes the owner of the values.
+    bool parse_json_lazy(std::unique_ptr<JsonDocument> values, const char *data, size_t length, JsonDocument &document,
+      const JsonParserOptions &options, IJsonParserLog *log);
+  }
+}
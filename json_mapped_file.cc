@@ -0,0 +1,199 @@
+#include "json_mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace knowson {
+
+  namespace
+  {
+    //-----------------------------------------------------------------------------------------------
+    /// Maps the entire file at the given path read-only. An empty file results in a null mapping.
+    bool map_file(const char *path, const char *&data, size_t &size)
+    {
+      data = nullptr;
+      size = 0;
+
+#if defined(_WIN32)
+      HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+      LARGE_INTEGER fileSize;
+      if (!GetFileSizeEx(file, &fileSize))
+      {
+        CloseHandle(file);
+        return false;
+      }
+
+      if (fileSize.QuadPart == 0)
+      {
+        CloseHandle(file);
+        return true;
+      }
+
+      // The mapping object and file handle can be closed once the view exists
+      HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      CloseHandle(file);
+      if (mapping == nullptr)
+        return false;
+
+      void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+      if (view == nullptr)
+        return false;
+
+      data = static_cast<const char*>(view);
+      size = static_cast<size_t>(fileSize.QuadPart);
+      return true;
+#else
+      int file = ::open(path, O_RDONLY);
+      if (file < 0)
+        return false;
+
+      struct stat info;
+      if (fstat(file, &info) != 0 || !S_ISREG(info.st_mode))
+      {
+        ::close(file);
+        return false;
+      }
+
+      if (info.st_size == 0)
+      {
+        ::close(file);
+        return true;
+      }
+
+      // The mapping keeps the file referenced, so the descriptor is not needed afterwards
+      void *view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+      ::close(file);
+      if (view == MAP_FAILED)
+        return false;
+
+      // The parser reads front to back, let the kernel read ahead aggressively
+      madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+      data = static_cast<const char*>(view);
+      size = static_cast<size_t>(info.st_size);
+      return true;
+#endif
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    void unmap_file(const char *data, size_t size)
+    {
+      if (data == nullptr)
+        return;
+
+#if defined(_WIN32)
+      UnmapViewOfFile(data);
+#else
+      munmap(const_cast<char*>(data), size);
+#endif
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  MappedFileJsonParserSource::MappedFileJsonParserSource() :
+    data_(nullptr),
+    size_(0),
+    position_(0),
+    isOpen_(false)
+  {
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  MappedFileJsonParserSource::MappedFileJsonParserSource(const char *path) :
+    MappedFileJsonParserSource()
+  {
+    open(path);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  MappedFileJsonParserSource::MappedFileJsonParserSource(MappedFileJsonParserSource &&other) :
+    data_(other.data_),
+    size_(other.size_),
+    position_(other.position_),
+    isOpen_(other.isOpen_)
+  {
+    other.data_ = nullptr;
+    other.size_ = other.position_ = 0;
+    other.isOpen_ = false;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  MappedFileJsonParserSource::~MappedFileJsonParserSource()
+  {
+    close();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  MappedFileJsonParserSource& MappedFileJsonParserSource::operator=(MappedFileJsonParserSource &&other)
+  {
+    if (this != &other)
+    {
+      close();
+      data_ = other.data_;
+      size_ = other.size_;
+      position_ = other.position_;
+      isOpen_ = other.isOpen_;
+      other.data_ = nullptr;
+      other.size_ = other.position_ = 0;
+      other.isOpen_ = false;
+    }
+    return *this;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool MappedFileJsonParserSource::open(const char *path)
+  {
+    close();
+    isOpen_ = map_file(path, data_, size_);
+    return isOpen_;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void MappedFileJsonParserSource::close()
+  {
+    unmap_file(data_, size_);
+    data_ = nullptr;
+    size_ = position_ = 0;
+    isOpen_ = false;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  uint32_t MappedFileJsonParserSource::Read(char* buffer, uint32_t length)
+  {
+    size_t count = std::min<size_t>(length, size_ - position_);
+    if (count > 0)
+      std::memcpy(buffer, data_ + position_, count);
+    position_ += count;
+    return static_cast<uint32_t>(count);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool MappedFileJsonParserSource::Span(const char *&data, size_t &length)
+  {
+    if (!isOpen_)
+      return false;
+
+    // The parser consumes the entire span
+    data = data_ + position_;
+    length = size_ - position_;
+    position_ = size_;
+    return true;
+  }
+}
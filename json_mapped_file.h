@@ -0,0 +1,60 @@
+#pragma once
+
+#include "json_parser.h"
+
+namespace knowson {
+
+  /**
+   * @brief Source that maps a file into memory. The parser reads the mapping in place as a single
+   *  span, so no read calls are made and the file content is not copied. The mapping is shared
+   *  with the OS page cache and thus with other processes that read the same file.
+   */
+  class MappedFileJsonParserSource : public IJsonParserSource
+  {
+  public:
+    /// Default constructor, creates a source without a file
+    MappedFileJsonParserSource();
+
+    /// Maps the file at the given path, check is_open to see if this succeeded
+    explicit MappedFileJsonParserSource(const char *path);
+
+    /// Move constructor
+    MappedFileJsonParserSource(MappedFileJsonParserSource &&other);
+
+    /// Destructor, unmaps the file
+    ~MappedFileJsonParserSource();
+
+    /// Move assignment
+    MappedFileJsonParserSource& operator=(MappedFileJsonParserSource &&other);
+
+    /// Maps the file at the given path, replacing any previously mapped file. Returns false if the
+    /// file could not be opened or mapped.
+    bool open(const char *path);
+
+    /// Unmaps the file
+    void close();
+
+    /// Returns true if a file is mapped
+    bool is_open() const { return isOpen_; }
+
+    /// Returns the content of the file
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    /// Copies the next part of the file to the given buffer
+    uint32_t Read(char* buffer, uint32_t length) override;
+
+    /// Returns the unread part of the file
+    bool Span(const char *&data, size_t &length) override;
+
+  private:
+    MappedFileJsonParserSource(const MappedFileJsonParserSource&) = delete;
+    MappedFileJsonParserSource& operator=(const MappedFileJsonParserSource&) = delete;
+
+  private:
+    const char *data_;
+    size_t size_;
+    size_t position_;
+    bool isOpen_;
+  };
+}
@@ -0,0 +1,52 @@
+#include "json_number.h"
+
+#include <cstdlib>
+#include <string>
+
+#if defined(_WIN32)
+#  include <locale.h>
+#elif defined(__APPLE__)
+#  include <xlocale.h>
+#else
+#  include <locale.h>
+#endif
+
+namespace knowson {
+
+  namespace detail {
+
+    namespace
+    {
+      //-----------------------------------------------------------------------------------------------
+#if defined(_WIN32)
+      typedef _locale_t CLocale;
+      CLocale create_c_locale() { return _create_locale(LC_NUMERIC, "C"); }
+      double strtod_c(const char *str, CLocale locale) { return _strtod_l(str, nullptr, locale); }
+#else
+      typedef locale_t CLocale;
+      CLocale create_c_locale() { return newlocale(LC_NUMERIC_MASK, "C", (locale_t)0); }
+      double strtod_c(const char *str, CLocale locale) { return strtod_l(str, nullptr, locale); }
+#endif
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    double parse_double_slow(const char *begin, const char *end)
+    {
+      // The "C" locale guarantees '.' as the decimal point regardless of the global locale
+      static const CLocale locale = create_c_locale();
+
+      // strtod needs a terminated string; numbers rarely need more than the stack buffer
+      char buffer[128];
+      size_t length = static_cast<size_t>(end - begin);
+      if (length < sizeof(buffer))
+      {
+        std::char_traits<char>::copy(buffer, begin, length);
+        buffer[length] = '\0';
+        return strtod_c(buffer, locale);
+      }
+
+      std::string copy(begin, end);
+      return strtod_c(copy.c_str(), locale);
+    }
+  }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "json_scan.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace knowson {
+
+  namespace detail {
+
+    /**
+     * @brief The value of a number token. Numbers without a fraction or exponent that fit in 64
+     *  bits are stored exactly as integers.
+     */
+    struct ParsedNumber
+    {
+      bool isInteger;
+      int64_t integer;
+      double value;
+    };
+
+    /// Converts decimal digits to the nearest double using the C library. Only used for the rare
+    /// numbers the fast path in parse_number can not represent exactly.
+    double parse_double_slow(const char *begin, const char *end);
+
+    /// Parses the number in [begin, end). Accepts an optional sign, digits with an optional
+    /// fraction and an optional exponent. Returns false if the text is not a valid number or its
+    /// magnitude is too large for a double, since json has no way to write infinity.
+    inline bool parse_number(const char *begin, const char *end, ParsedNumber &result)
+    {
+      static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+      };
+
+      const char *p = begin;
+      bool negative = false;
+      if (p != end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+      // Accumulate up to 19 significant digits, which always fit in 64 bits
+      uint64_t mantissa = 0;
+      int32_t exponent = 0;
+      uint32_t significantDigits = 0;
+      bool truncated = false;
+      bool hadDigits = false;
+      for (; p != end && is_digit(*p); ++p)
+      {
+        hadDigits = true;
+        if (significantDigits < 19)
+        {
+          mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+          if (mantissa != 0)
+            ++significantDigits;
+        }
+        else
+        {
+          truncated = truncated || *p != '0';
+          ++exponent;
+        }
+      }
+
+      bool isInteger = true;
+      if (p != end && *p == '.')
+      {
+        isInteger = false;
+        for (++p; p != end && is_digit(*p); ++p)
+        {
+          hadDigits = true;
+          if (significantDigits < 19)
+          {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            if (mantissa != 0)
+              ++significantDigits;
+            --exponent;
+          }
+          else
+            truncated = truncated || *p != '0';
+        }
+      }
+
+      if (!hadDigits)
+        return false;
+
+      if (p != end && (*p == 'e' || *p == 'E'))
+      {
+        isInteger = false;
+        ++p;
+
+        bool negativeExponent = false;
+        if (p != end && (*p == '-' || *p == '+'))
+          negativeExponent = *p++ == '-';
+
+        if (p == end || !is_digit(*p))
+          return false;
+
+        int32_t explicitExponent = 0;
+        for (; p != end && is_digit(*p); ++p)
+          if (explicitExponent < 100000)
+            explicitExponent = explicitExponent * 10 + (*p - '0');
+
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+      }
+
+      if (p != end)
+        return false;
+
+      // Integers that fit in 64 bits are stored exactly. Negative zero is kept as a double so
+      // its sign is not lost.
+      if (isInteger && !truncated && exponent == 0 && !(negative && mantissa == 0))
+      {
+        if (!negative && mantissa <= static_cast<uint64_t>(INT64_MAX))
+        {
+          result.isInteger = true;
+          result.integer = static_cast<int64_t>(mantissa);
+          result.value = static_cast<double>(result.integer);
+          return true;
+        }
+        if (negative && mantissa <= static_cast<uint64_t>(INT64_MAX) + 1)
+        {
+          result.isInteger = true;
+          result.integer = static_cast<int64_t>(0 - mantissa);
+          result.value = static_cast<double>(result.integer);
+          return true;
+        }
+      }
+
+      result.isInteger = false;
+      result.integer = 0;
+
+      // When both the mantissa and the power of ten are exactly representable as doubles a single
+      // multiplication or division is correctly rounded.
+      if (!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+      {
+        double value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+        result.value = negative ? -value : value;
+        return true;
+      }
+
+      if (mantissa == 0 && !truncated)
+      {
+        result.value = negative ? -0.0 : 0.0;
+        return true;
+      }
+
+      result.value = parse_double_slow(begin, end);
+      return !std::isinf(result.value);
+    }
+  }
+}
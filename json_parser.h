@@ -1,8 +1,12 @@
 #pragma once
 
-#include "json.h"
+#include "json_document.h"
+#include "key_table.h"
 
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
 
 namespace knowson {
 
@@ -13,20 +17,245 @@ namespace knowson {
 		kSimplified,
 	};
 
+  /// Describes why a document could not be parsed
+  enum class JsonParseErrorCode
+  {
+    kNone,
+    kUnexpectedToken,
+    kUnexpectedEOF,
+    kInvalidNumber,
+    kDepthLimit,
+    kSizeLimit,
+    kStringLimit,
+    kNodeLimit,
+    kDuplicateKey,
+    kInvalidEscape,
+    kInvalidUtf8,
+  };
+
+  /**
+   * @brief Describes a parse error. Errors are reported in this form without formatting or
+   *  allocating, format_parse_error turns them into text when that is needed.
+   */
+  struct JsonParseError
+  {
+  public:
+    /// Default constructor
+    JsonParseError() : code(JsonParseErrorCode::kNone), found(0), expected(0), offset(0), line(0), column(0) {}
+
+    JsonParseErrorCode code;
+
+    /// The detail::TokenType of the token at the error
+    uint32_t found;
+
+    /// The token types that would have been valid, bit n stands for detail::TokenType n
+    uint32_t expected;
+
+    /// Byte offset of the error from the start of the document
+    uint64_t offset;
+
+    /// Line and column of the error. The line is 0 if the location is not known, which is the
+    /// case for errors in sources that are parsed with failFast.
+    uint32_t line;
+    uint32_t column;
+  };
+
+  /// Describes the error as text, like "Unexpected }, expected string or ]". At most size
+  /// characters including the terminator are written to the buffer, which is returned.
+  const char* format_parse_error(const JsonParseError &error, char *buffer, size_t size);
+
 	struct IJsonParserLog
 	{
 	public:
-		/// Called when an error ocurred while parsing a document.
+		/// Called with the text of an error that ocurred while parsing a document.
 		virtual void Error(const char* msg, uint32_t line, uint32_t column) = 0;
+
+    /// Called when an error ocurred while parsing a document. The default formats the error and
+    /// passes it on to Error, override it to receive errors without formatting them.
+    virtual void Report(const JsonParseError &error);
 	};
 
+  /**
+   * @brief Log that keeps the first error that is reported and ignores the others
+   */
+  struct JsonParseErrorRecorder : public IJsonParserLog
+  {
+  public:
+    /// Not called, errors are kept without formatting them
+    void Error(const char*, uint32_t, uint32_t) override {}
+
+    /// Keeps the error if it is the first
+    void Report(const JsonParseError &e) override
+    {
+      if (error.code == JsonParseErrorCode::kNone)
+        error = e;
+    }
+
+    /// Forgets the error
+    void reset() { error = JsonParseError(); }
+
+    JsonParseError error;
+  };
+
 	struct IJsonParserSource
 	{
 	public:
 		/// Reads character data from the source
 		virtual uint32_t Read(char* buffer, uint32_t length) = 0;
+
+		/// Returns true and the entire remaining content of the source if it is available as a single
+		/// contiguous range in memory. The parser then reads the range in place instead of calling Read.
+		virtual bool Span(const char *&, size_t &) { return false; }
 	};
 
+  struct IJsonBlockAllocator
+  {
+  public:
+    /// Returns memory for a block of input characters, aligned for any pointer type
+    virtual void* Allocate(size_t size) = 0;
+
+    /// Releases memory that was returned by Allocate
+    virtual void Free(void *memory, size_t size) = 0;
+  };
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+  /// True if the library is built to collect parse statistics
+  const bool kParseStatsEnabled = true;
+#else
+  const bool kParseStatsEnabled = false;
+#endif
+
+  /**
+   * @brief Counters that describe where the time and memory of parsing goes. The counters are
+   *  only updated when the library and the code that includes it are built with
+   *  KNOWSON_ENABLE_PARSE_STATS defined, otherwise the instrumentation is compiled out. Parses
+   *  add to the counters, so one instance can aggregate any number of documents.
+   */
+  struct JsonParseStats
+  {
+  public:
+    /// The number of token types and of value types that are counted
+    static const size_t kTokenTypes = 16;
+    static const size_t kValueTypes = 6;
+
+    /// Default constructor
+    JsonParseStats() { reset(); }
+
+    /// Sets all counters to zero
+    void reset() { std::memset(this, 0, sizeof(*this)); }
+
+    /// Characters the tokenizer consumed
+    uint64_t bytes;
+
+    /// Tokens read, indexed by detail::TokenType
+    uint64_t tokens[kTokenTypes];
+
+    /// Input blocks that were allocated and blocks that were reused from the free list of the pool
+    uint64_t blocksAllocated;
+    uint64_t blocksReused;
+
+    /// The deepest nesting of objects and arrays
+    uint32_t maxDepth;
+
+    /// Values created in the tree, indexed by JsonType
+    uint64_t nodes[kValueTypes];
+
+    /// Time spent reading tokens and time spent in the entire parse. The difference is the time
+    /// spent building the tree.
+    uint64_t tokenizeNanoseconds;
+    uint64_t totalNanoseconds;
+  };
+
+  /**
+   * @brief Bounds on the resources a parse may use, for documents from untrusted sources. A
+   *  limit of 0 means there is no limit. Exceeding a limit fails the parse with an error.
+   */
+  struct JsonParserLimits
+  {
+  public:
+    /// Default constructor, sets no limits
+    JsonParserLimits() : maxDepth(0), maxBytes(0), maxStringLength(0), maxNodes(0) {}
+
+    /// The deepest nesting of objects and arrays
+    uint32_t maxDepth;
+
+    /// The number of characters read from the input
+    uint64_t maxBytes;
+
+    /// The number of characters in a single string, key or identifier
+    uint32_t maxStringLength;
+
+    /// The number of values created in the tree
+    uint64_t maxNodes;
+  };
+
+  /**
+   * @brief Options that control how a document is parsed
+   */
+  struct JsonParserOptions
+  {
+  public:
+    /// Default constructor
+    JsonParserOptions() : documentType(JsonDocumentType::kUnknown), borrowInput(false), keyTable(nullptr),
+      blockSize(16 * 1024), blockAllocator(nullptr), lazy(false), stats(nullptr), failFast(false),
+      iterative(false), duplicateKeys(JsonDuplicateKeys::kKeepFirst), readAhead(0) {}
+
+    /// The dialect of the document, kUnknown detects the dialect from the first token
+    JsonDocumentType documentType;
+
+    /// When parsing from a contiguous buffer or a source that provides a Span, set to true to promise
+    /// that the buffer outlives the document. Strings and keys are then referenced in place instead
+    /// of being copied into the document.
+    bool borrowInput;
+
+    /// Optional table that object keys are interned in. Documents parsed with the same table share
+    /// a single copy of every key and their keys can be compared by pointer. The table must outlive
+    /// the documents.
+    KeyTable *keyTable;
+
+    /// Number of characters read from a source per Read call. Input is kept in blocks of this size
+    /// while a token spans them. Not used when the input is a contiguous buffer.
+    uint32_t blockSize;
+
+    /// Optional allocator for the input blocks, blocks come from the global heap if there is none.
+    /// The allocator must outlive the parse, or the parser when used with a JsonParser.
+    IJsonBlockAllocator *blockAllocator;
+
+    /// Set to true to only index the brackets of the document up front. Objects and arrays are
+    /// then parsed the first time they are accessed, which saves most of the work when only a few
+    /// values are read. The text is copied into the document unless borrowInput is set. Errors
+    /// within a container are only found when it is accessed, see JsonDocument::valid. A lazy
+    /// document must not be accessed from multiple threads at once, not even for reading.
+    bool lazy;
+
+    /// Optional statistics the parse is counted in, see JsonParseStats. Lazy documents are not
+    /// counted since most of their work happens after the parse.
+    JsonParseStats *stats;
+
+    /// Set to true to stop at the first error instead of reporting every error that follows from
+    /// it. Lines are then not counted while reading from a source, so errors in sources only
+    /// carry their byte offset.
+    bool failFast;
+
+    /// Limits for untrusted input. Lazy documents only check maxBytes up front, their containers
+    /// are parsed without limits.
+    JsonParserLimits limits;
+
+    /// Set to true to parse with an explicit stack instead of recursing for every object and
+    /// array, so deep documents do not depend on the size of the thread stack
+    bool iterative;
+
+    /// What to do with a key that occurs twice in an object. Members are collected until the
+    /// object closes, so a rejected duplicate is reported at the end of its object. Lazy documents
+    /// always keep the first value.
+    JsonDuplicateKeys duplicateKeys;
+
+    /// Number of blocks that are read ahead from a source on a background thread, so waiting on
+    /// slow storage overlaps with parsing, see PrefetchJsonParserSource. 0 reads blocks when the
+    /// parser needs them. Not used for sources that provide a Span.
+    uint32_t readAhead;
+  };
+
 	template<typename S>
 	struct StreamJsonParserSource : public IJsonParserSource
 	{
@@ -44,6 +273,47 @@ namespace knowson {
 		S& stream_;
 	};
 
-	/// Parses a json document
-	bool parse_json(IJsonParserSource *source, std::unique_ptr<JsonValue>& document, IJsonParserLog *log = nullptr, JsonDocumentType documentType = JsonDocumentType::kUnknown);
+	/// Parses a json document. Any previous content of the document is released, but its memory is
+	/// kept and reused for the new values.
+	bool parse_json(IJsonParserSource *source, JsonDocument& document, IJsonParserLog *log = nullptr, JsonDocumentType documentType = JsonDocumentType::kUnknown);
+  bool parse_json(IJsonParserSource *source, JsonDocument& document, const JsonParserOptions &options, IJsonParserLog *log = nullptr);
+
+  /// Parses a json document from a contiguous buffer. The buffer is read in place and only has to 
+  /// stay alive for the duration of the call.
+  bool parse_json(const char *data, size_t length, JsonDocument& document, IJsonParserLog *log = nullptr, JsonDocumentType documentType = JsonDocumentType::kUnknown);
+  bool parse_json(const char *data, size_t length, JsonDocument& document, const JsonParserOptions &options, IJsonParserLog *log = nullptr);
+
+  namespace detail {
+    class BlockPool;
+  }
+
+  /**
+   * @brief Parses many documents with the same options. The input blocks of one parse are kept 
+   *  and reused by the next, so parsing a stream of documents from sources into the same
+   *  JsonDocument does not allocate at all once the parser and the document are warm. A parser
+   *  must only be used by one thread at a time.
+   */
+  class JsonParser
+  {
+  public:
+    explicit JsonParser(const JsonParserOptions &options = JsonParserOptions());
+    ~JsonParser();
+
+    /// Parses a json document. Any previous content of the document is released, but its memory
+    /// is kept and reused for the new values.
+    bool parse(IJsonParserSource *source, JsonDocument& document, IJsonParserLog *log = nullptr);
+
+    /// Parses a json document from a contiguous buffer
+    bool parse(const char *data, size_t length, JsonDocument& document, IJsonParserLog *log = nullptr);
+
+    /// Returns the options documents are parsed with
+    const JsonParserOptions& options() const { return options_; }
+
+  private:
+    JsonParser(const JsonParser&) = delete;
+    JsonParser& operator=(const JsonParser&) = delete;
+
+    JsonParserOptions options_;
+    std::unique_ptr<detail::BlockPool> blocks_;
+  };
 }
\ No newline at end of file
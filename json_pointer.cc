@@ -0,0 +1,301 @@
+#include "json_pointer.h"
+#include "json_reader.h"
+
+namespace knowson {
+
+  namespace
+  {
+    //-----------------------------------------------------------------------------------------------
+    /// Parses an array index, which is either 0 or a number without leading zeros
+    bool parse_index(StringRef text, size_t &index)
+    {
+      if (text.empty() || (text[0] == '0' && text.size() > 1))
+        return false;
+
+      index = 0;
+      for (char c : text)
+      {
+        if (!detail::is_digit(c) || index > (SIZE_MAX - 9) / 10)
+          return false;
+        index = index * 10 + static_cast<size_t>(c - '0');
+      }
+      return true;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonPointer::parse(StringRef text)
+  {
+    if (!text.empty() && text[0] != '/')
+      return false;
+
+    std::string keys;
+    std::vector<Token> tokens;
+    for (size_t i = 0; i < text.size();)
+    {
+      // Skip the /
+      ++i;
+
+      Token token;
+      token.offset = static_cast<uint32_t>(keys.size());
+      for (; i < text.size() && text[i] != '/'; ++i)
+      {
+        char c = text[i];
+        if (c == '~')
+        {
+          if (++i == text.size() || (text[i] != '0' && text[i] != '1'))
+            return false;
+          c = text[i] == '0' ? '~' : '/';
+        }
+        keys.push_back(c);
+      }
+
+      token.length = static_cast<uint32_t>(keys.size() - token.offset);
+      token.isIndex = parse_index(StringRef(keys.data() + token.offset, token.length), token.index);
+      tokens.push_back(token);
+    }
+
+    keys_.swap(keys);
+    tokens_.swap(tokens);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  const JsonValue* JsonPointer::resolve(const JsonValue &root) const
+  {
+    const JsonValue *value = &root;
+    for (size_t i = 0; i < tokens_.size(); ++i)
+    {
+      if (value->is<JsonObject>())
+      {
+        if (!value->as<JsonObject>().try_get(key(i), value))
+          return nullptr;
+      }
+      else if (value->is<JsonArray>())
+      {
+        const JsonArray &array = value->as<JsonArray>();
+        if (!tokens_[i].isIndex || tokens_[i].index >= array.size())
+          return nullptr;
+        value = &array.at(tokens_[i].index);
+      }
+      else
+        return nullptr;
+    }
+    return value;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  size_t JsonQuery::add(const JsonPointer &pointer)
+  {
+    Entry entry;
+    entry.pointer = pointer;
+    entry.matched = 0;
+    entry.depth = 0;
+    entry.capturing = false;
+    entry.missing = false;
+    entry.result = nullptr;
+    entry.builder.reset(new JsonDomBuilder(values_));
+    entries_.push_back(std::move(entry));
+    return entries_.size() - 1;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonQuery::reset()
+  {
+    for (Entry &entry : entries_)
+    {
+      entry.matched = 0;
+      entry.capturing = false;
+      entry.missing = false;
+      entry.result = nullptr;
+      entry.builder->reset();
+    }
+    stack_.clear();
+    active_.clear();
+    values_.clear();
+    found_ = 0;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  template<typename Step>
+  void JsonQuery::step(const Step &step)
+  {
+    // The members of the top frame are at this position of a pointer
+    size_t position = stack_.size() - 1;
+    for (Entry &entry : entries_)
+    {
+      if (entry.result != nullptr || entry.capturing || entry.missing)
+        continue;
+
+      // A previous member of this object matched already. Another one can only match if it
+      // repeats the key, and like the tree the query keeps the first of duplicate keys, so the
+      // value does not exist.
+      if (entry.matched > position)
+      {
+        entry.missing = true;
+        continue;
+      }
+      if (entry.matched == position && entry.pointer.size() > position && step(entry.pointer, position))
+        entry.matched = position + 1;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonQuery::begin_value()
+  {
+    if (!stack_.empty() && stack_.back().array)
+    {
+      size_t index = stack_.back().index++;
+      step([index](const JsonPointer &pointer, size_t position) { return pointer.matches(position, index); });
+    }
+
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+      Entry &entry = entries_[i];
+      if (entry.result == nullptr && !entry.capturing && !entry.missing && entry.matched == stack_.size() &&
+        entry.pointer.size() == stack_.size())
+      {
+        entry.capturing = true;
+        entry.depth = stack_.size();
+        entry.builder->reset();
+        active_.push_back(i);
+      }
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  template<typename Event>
+  void JsonQuery::forward(const Event &event)
+  {
+    for (size_t i : active_)
+      event(*entries_[i].builder);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::end_value()
+  {
+    for (size_t i = 0; i < active_.size();)
+    {
+      Entry &entry = entries_[active_[i]];
+      if (entry.depth != stack_.size())
+      {
+        ++i;
+        continue;
+      }
+
+      entry.capturing = false;
+      entry.result = entry.builder->root();
+      ++found_;
+      active_.erase(active_.begin() + i);
+    }
+    return !complete();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::Null()
+  {
+    begin_value();
+    forward([](JsonDomBuilder &builder) { builder.Null(); });
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::Boolean(bool value)
+  {
+    begin_value();
+    forward([value](JsonDomBuilder &builder) { builder.Boolean(value); });
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::Number(double value)
+  {
+    begin_value();
+    forward([value](JsonDomBuilder &builder) { builder.Number(value); });
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::Integer(int64_t value)
+  {
+    begin_value();
+    forward([value](JsonDomBuilder &builder) { builder.Integer(value); });
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::String(StringRef value)
+  {
+    begin_value();
+    forward([value](JsonDomBuilder &builder) { builder.String(value); });
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::StartObject()
+  {
+    begin_value();
+    forward([](JsonDomBuilder &builder) { builder.StartObject(); });
+    Frame frame = { false, 0 };
+    stack_.push_back(frame);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::Key(StringRef key)
+  {
+    forward([key](JsonDomBuilder &builder) { builder.Key(key); });
+    step([key](const JsonPointer &pointer, size_t position) { return pointer.matches(position, key); });
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::EndObject()
+  {
+    forward([](JsonDomBuilder &builder) { builder.EndObject(); });
+    stack_.pop_back();
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::StartArray()
+  {
+    begin_value();
+    forward([](JsonDomBuilder &builder) { builder.StartArray(); });
+    Frame frame = { true, 0 };
+    stack_.push_back(frame);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonQuery::EndArray()
+  {
+    forward([](JsonDomBuilder &builder) { builder.EndArray(); });
+    stack_.pop_back();
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool parse_json_query(const char *data, size_t length, JsonQuery &query, IJsonParserLog *log,
+    JsonDocumentType documentType)
+  {
+    query.reset();
+    if (query.complete())
+      return true;
+
+    bool parsed = parse_json_events(data, length, query, log, documentType);
+    return parsed || query.complete();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool parse_json_query(IJsonParserSource *source, JsonQuery &query, IJsonParserLog *log,
+    JsonDocumentType documentType)
+  {
+    query.reset();
+    if (query.complete())
+      return true;
+
+    bool parsed = parse_json_events(source, query, log, documentType);
+    return parsed || query.complete();
+  }
+}
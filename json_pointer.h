@@ -0,0 +1,157 @@
+#pragma once
+
+#include "json_document.h"
+#include "json_dom_builder.h"
+#include "json_parser.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace knowson {
+
+  /**
+   * @brief A JSON Pointer (RFC 6901) such as /pets/0/name. The pointer is parsed once and can then
+   *  be resolved against any number of values without allocating.
+   */
+  class JsonPointer
+  {
+  public:
+    /// Constructs a pointer to the root value
+    JsonPointer() {}
+
+    /// Parses a pointer. Returns false if the text is not a valid pointer, the pointer is left
+    /// unchanged then.
+    bool parse(StringRef text);
+
+    /// Returns the number of reference tokens
+    size_t size() const { return tokens_.size(); }
+
+    /// Returns the reference token at the given position with ~0 and ~1 decoded
+    StringRef key(size_t position) const
+    {
+      return StringRef(keys_.data() + tokens_[position].offset, tokens_[position].length);
+    }
+
+    /// Returns true if the token at the given position refers to the member with the given key
+    bool matches(size_t position, StringRef name) const { return key(position) == name; }
+
+    /// Returns true if the token at the given position refers to the array element with the given
+    /// index
+    bool matches(size_t position, size_t index) const
+    {
+      return tokens_[position].isIndex && tokens_[position].index == index;
+    }
+
+    /// Returns the value the pointer refers to or nullptr if there is none
+    const JsonValue* resolve(const JsonValue &root) const;
+    const JsonValue* resolve(const JsonDocument &document) const
+    {
+      return document.root() != nullptr ? resolve(*document.root()) : nullptr;
+    }
+
+  private:
+    struct Token
+    {
+      uint32_t offset;
+      uint32_t length;
+      bool isIndex;
+      size_t index;
+    };
+
+  private:
+    std::string keys_;
+    std::vector<Token> tokens_;
+  };
+
+  /**
+   * @brief Json event handler that extracts the values at a set of pointers from the event stream.
+   *  The handler stops the parse as soon as all values were found, so only the document up to the
+   *  last of them is read. The values are built in a document owned by the query and are valid
+   *  until the query is reset. Of members with the same key only the first is followed, which
+   *  gives the same values as resolving the pointers in a tree parsed with the default
+   *  JsonDuplicateKeys::kKeepFirst.
+   */
+  class JsonQuery
+  {
+  public:
+    /// Default constructor
+    JsonQuery() : found_(0) {}
+
+    /// Adds a pointer to look for and returns the index of its result
+    size_t add(const JsonPointer &pointer);
+
+    /// Returns the value found for the pointer with the given index or nullptr
+    const JsonValue* result(size_t index) const { return entries_[index].result; }
+
+    /// Returns true once the values of all pointers were found
+    bool complete() const { return found_ == entries_.size(); }
+
+    /// Forgets the results to prepare the query for another document
+    void reset();
+
+    /// Json event handler
+    bool Null();
+    bool Boolean(bool value);
+    bool Number(double value);
+    bool Integer(int64_t value);
+    bool String(StringRef value);
+    bool StartObject();
+    bool Key(StringRef key);
+    bool EndObject();
+    bool StartArray();
+    bool EndArray();
+
+  private:
+    struct Entry
+    {
+      JsonPointer pointer;
+      size_t matched;
+      size_t depth;
+      bool capturing;
+      bool missing;
+      JsonValue *result;
+      std::unique_ptr<JsonDomBuilder> builder;
+    };
+
+    struct Frame
+    {
+      bool array;
+      size_t index;
+    };
+
+    JsonQuery(const JsonQuery&) = delete;
+    JsonQuery& operator=(const JsonQuery&) = delete;
+
+    /// Matches the pointers against the next member or element of the top frame
+    template<typename Step>
+    void step(const Step &step);
+
+    /// Moves to the next value and starts building it for every pointer that refers to it
+    void begin_value();
+
+    /// Passes an event to the builders of the values that are being built
+    template<typename Event>
+    void forward(const Event &event);
+
+    /// Completes the values that end at the current depth. Returns false to stop the parse once
+    /// all values were found.
+    bool end_value();
+
+  private:
+    std::vector<Entry> entries_;
+    std::vector<Frame> stack_;
+    std::vector<size_t> active_;
+    JsonDocument values_;
+    size_t found_;
+  };
+
+  /// Extracts the values of the query from a json document in a contiguous buffer. Returns true if
+  /// the document was read up to the last value, or to its end if some values do not exist.
+  bool parse_json_query(const char *data, size_t length, JsonQuery &query, IJsonParserLog *log = nullptr,
+    JsonDocumentType documentType = JsonDocumentType::kUnknown);
+
+  /// Extracts the values of the query from a json document read from a source
+  bool parse_json_query(IJsonParserSource *source, JsonQuery &query, IJsonParserLog *log = nullptr,
+    JsonDocumentType documentType = JsonDocumentType::kUnknown);
+}
@@ -0,0 +1,109 @@
+#include "json_prefetch.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace knowson {
+
+  //-----------------------------------------------------------------------------------------------
+  PrefetchJsonParserSource::PrefetchJsonParserSource(IJsonParserSource *source, uint32_t chunkSize, uint32_t depth) :
+    source_(source),
+    chunks_(std::max<uint32_t>(depth, 1)),
+    head_(0),
+    filled_(0),
+    offset_(0),
+    drained_(false),
+    stopping_(false),
+    stalls_(0)
+  {
+    for (Chunk &chunk : chunks_)
+    {
+      chunk.data.resize(std::max<uint32_t>(chunkSize, 1));
+      chunk.size = 0;
+    }
+    thread_ = std::thread(&PrefetchJsonParserSource::read_main, this);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  PrefetchJsonParserSource::~PrefetchJsonParserSource()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    emptiedCondition_.notify_one();
+    thread_.join();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  uint32_t PrefetchJsonParserSource::Read(char *buffer, uint32_t length)
+  {
+    uint32_t copied = 0;
+    while (copied < length)
+    {
+      {
+        // Only wait if nothing was copied yet, a short read is fine
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (filled_ == 0)
+        {
+          if (drained_ || copied != 0)
+            break;
+
+          ++stalls_;
+          filledCondition_.wait(lock, [this]() { return filled_ != 0 || drained_; });
+          if (filled_ == 0)
+            break;
+        }
+      }
+
+      // The background thread does not touch a filled chunk, so it is read without the lock
+      const Chunk &chunk = chunks_[head_];
+      uint32_t count = std::min(length - copied, chunk.size - offset_);
+      std::memcpy(buffer + copied, chunk.data.data() + offset_, count);
+      copied += count;
+      offset_ += count;
+
+      if (offset_ == chunk.size)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          offset_ = 0;
+          head_ = (head_ + 1) % chunks_.size();
+          --filled_;
+        }
+        emptiedCondition_.notify_one();
+      }
+    }
+    return copied;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void PrefetchJsonParserSource::read_main()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+      emptiedCondition_.wait(lock, [this]() { return stopping_ || filled_ < chunks_.size(); });
+      if (stopping_)
+        return;
+
+      // Every read becomes a chunk of its own, so characters that arrive in pieces are passed on
+      // as soon as they are there
+      Chunk &chunk = chunks_[(head_ + filled_) % chunks_.size()];
+      lock.unlock();
+      uint32_t size = source_->Read(chunk.data.data(), static_cast<uint32_t>(chunk.data.size()));
+      lock.lock();
+
+      if (size == 0)
+      {
+        drained_ = true;
+        filledCondition_.notify_one();
+        return;
+      }
+
+      chunk.size = size;
+      ++filled_;
+      filledCondition_.notify_one();
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace knowson {
+
+  /**
+   * @brief Source that reads ahead from another source on a background thread. While the parser
+   *  works on the characters of one chunk the next chunks are already being read, so waiting on
+   *  slow storage such as a network file system overlaps with parsing instead of adding to it.
+   *
+   *  Reading starts when the source is constructed. The wrapped source is only read from the
+   *  background thread and must outlive this instance. Read must not be called from multiple
+   *  threads at once.
+   */
+  class PrefetchJsonParserSource : public IJsonParserSource
+  {
+  public:
+    /// Starts reading ahead from the given source in chunks of the given size. At most depth
+    /// chunks are kept that were not consumed yet, two double-buffer the source.
+    explicit PrefetchJsonParserSource(IJsonParserSource *source, uint32_t chunkSize = 64 * 1024, uint32_t depth = 2);
+
+    /// Stops reading ahead. Waits for a read of the wrapped source that is in progress.
+    ~PrefetchJsonParserSource();
+
+    /// Copies characters that were read ahead to the given buffer, waiting for them if none are
+    /// available yet
+    uint32_t Read(char* buffer, uint32_t length) override;
+
+    /// Returns the number of reads that had to wait for the wrapped source. Only valid while no
+    /// read is in progress.
+    uint64_t stalls() const { return stalls_; }
+
+  private:
+    PrefetchJsonParserSource(const PrefetchJsonParserSource&) = delete;
+    PrefetchJsonParserSource& operator=(const PrefetchJsonParserSource&) = delete;
+
+    /// Main loop of the background thread
+    void read_main();
+
+  private:
+    struct Chunk
+    {
+      std::vector<char> data;
+      uint32_t size;
+    };
+
+    IJsonParserSource *source_;
+    std::vector<Chunk> chunks_;
+
+    /// The chunk that is consumed next, the number of chunks that were read but not consumed and
+    /// the number of characters of the first chunk that were consumed already
+    size_t head_;
+    size_t filled_;
+    uint32_t offset_;
+
+    bool drained_;
+    bool stopping_;
+    uint64_t stalls_;
+
+    std::mutex mutex_;
+    std::condition_variable filledCondition_;
+    std::condition_variable emptiedCondition_;
+    std::thread thread_;
+  };
+}
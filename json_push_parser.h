@@ -0,0 +1,365 @@
+#pragma once
+
+#include "json_reader.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace knowson {
+
+  /// The state of a push parser after it received input
+  enum class JsonPushStatus
+  {
+    kNeedMoreInput,
+    kComplete,
+    kError,
+  };
+
+  /**
+   * @brief Parses a json document that arrives in fragments and reports its contents to a
+   *  handler as the fragments are fed to it. The grammar is the same as for parse_json_events,
+   *  but instead of recursing it is driven from an explicit stack, so parsing stops at the end of
+   *  every fragment and resumes when the next one arrives.
+   *
+   *  A token that is cut off by the end of a fragment is kept and parsed once it is complete;
+   *  everything else is read from the fragment in place. Strings passed to the handler are only
+   *  valid for the duration of the call.
+   */
+  template<typename Handler>
+  class JsonPushParser
+  {
+  public:
+    /// Constructs a parser that reports to the given handler
+    explicit JsonPushParser(Handler &handler, IJsonParserLog *log = nullptr, JsonDocumentType documentType = JsonDocumentType::kUnknown) :
+      handler_(handler), log_(log)
+    {
+      reset(documentType);
+    }
+
+    /// Parses the next fragment of the document. Once the root value is complete any further
+    /// input is ignored.
+    JsonPushStatus feed(const char *data, size_t length)
+    {
+      if (status_ != JsonPushStatus::kNeedMoreInput || length == 0)
+        return status_;
+
+      // Only as much of the fragment as completes the token that was cut off is appended to it,
+      // the rest of the fragment is parsed in place
+      size_t used = 0;
+      while (!pending_.empty())
+      {
+        const char *end = pending_end(data + used, data + length);
+        if (end == data + length)
+        {
+          // The token can not end in this fragment, so it is not scanned again until one arrives
+          // in which it can
+          pending_.append(data + used, length - used);
+          return status_;
+        }
+
+        pending_.append(data + used, static_cast<size_t>(end + 1 - (data + used)));
+        used = static_cast<size_t>(end + 1 - data);
+        if (pending_[0] == '"' && detail::is_escaped(pending_.data() + 1, &pending_.back()))
+          continue;
+
+        if (parse(pending_.data(), pending_.size(), true) != JsonPushStatus::kNeedMoreInput)
+          return status_;
+
+        // Once the token is complete whatever is kept lies within the fragment
+        if (pending_.size() <= used)
+        {
+          size_t tail = pending_.size();
+          pending_.clear();
+          return parse(data + used - tail, length - used + tail, true);
+        }
+      }
+
+      return parse(data, length, true);
+    }
+
+    /// Signals that there is no more input. Completes the document if it ends with the input,
+    /// like the root object of a simplified document, or reports the document as truncated.
+    JsonPushStatus finish()
+    {
+      if (status_ != JsonPushStatus::kNeedMoreInput)
+        return status_;
+      return parse(pending_.data(), pending_.size(), false);
+    }
+
+    /// Returns the current state
+    JsonPushStatus status() const { return status_; }
+
+    /// Prepares the parser for another document
+    void reset(JsonDocumentType documentType = JsonDocumentType::kUnknown)
+    {
+      documentType_ = documentType;
+      state_ = State::kRoot;
+      status_ = JsonPushStatus::kNeedMoreInput;
+      stack_.clear();
+      pending_.clear();
+      lines_ = 0;
+      columns_ = 0;
+      offset_ = 0;
+    }
+
+  private:
+    typedef detail::ParseContext<detail::FragmentInput> Context;
+
+    /// What the parser expects next
+    enum class State
+    {
+      kRoot,
+      kArrayValue,
+      kArrayNext,
+      kObjectKey,
+      kObjectSeperator,
+      kObjectValue,
+      kObjectNext,
+    };
+
+    /// The containers that are open
+    enum class Container
+    {
+      kArray,
+      kObject,
+      kRootObject,
+    };
+
+    JsonPushParser(const JsonPushParser&) = delete;
+    JsonPushParser& operator=(const JsonPushParser&) = delete;
+
+    /// Parses the tokens in the buffer. If the buffer is partial, the token at its end is held
+    /// back until it is complete.
+    JsonPushStatus parse(const char *data, size_t length, bool partial)
+    {
+      Context context(log_, documentType_, data, length, partial, lines_, columns_, offset_, scratch_);
+      for (;;)
+      {
+        context.next();
+        if (context.token().type == detail::TokenType::kIncomplete)
+        {
+          keep_tail(data, length, context.source().token_start());
+          return status_;
+        }
+
+        if (!process(context))
+          status_ = JsonPushStatus::kError;
+
+        if (status_ != JsonPushStatus::kNeedMoreInput)
+        {
+          pending_.clear();
+          return status_;
+        }
+      }
+    }
+
+    /// Returns the first character in [begin, end) that may complete the token that was cut off,
+    /// or end if there is none. Strings end at a quote, comments at a newline and other tokens at
+    /// a delimiter.
+    const char* pending_end(const char *begin, const char *end) const
+    {
+      if (pending_[0] == '"')
+      {
+        const void *quote = begin != end ? std::memchr(begin, '"', static_cast<size_t>(end - begin)) : nullptr;
+        return quote != nullptr ? static_cast<const char*>(quote) : end;
+      }
+      if (pending_.size() > 1 && (pending_[0] == '-' || pending_[0] == '/') && pending_[1] == pending_[0])
+        return detail::find_newline(begin, end);
+      return detail::find_delimiter(begin, end, true);
+    }
+
+    /// Keeps the characters from the given position onwards for the next fragment
+    void keep_tail(const char *data, size_t length, const char *tail)
+    {
+      const char *lastNewline = detail::scan_newlines(data, tail, lines_);
+      if (lastNewline != nullptr)
+        columns_ = detail::count_columns(lastNewline + 1, tail);
+      else
+        columns_ += detail::count_columns(data, tail);
+
+      size_t offset = static_cast<size_t>(tail - data);
+      offset_ += offset;
+      if (data == pending_.data())
+        pending_.erase(0, offset);
+      else
+        pending_.assign(tail, length - offset);
+    }
+
+    /// Consumes the current token. Returns false if the document is malformed or the handler
+    /// stopped the parse.
+    bool process(Context &context)
+    {
+      detail::TokenType type = context.token().type;
+      for (;;)
+      {
+        switch (state_)
+        {
+        case State::kRoot:
+          if (context.document_type() == JsonDocumentType::kUnknown)
+          {
+            documentType_ = type == detail::TokenType::kCurlyLeft || type == detail::TokenType::kBraceLeft ?
+              JsonDocumentType::kNormal : JsonDocumentType::kSimplified;
+            context.set_document_type(documentType_);
+          }
+
+          // The root object of a simplified document has no braces
+          if (documentType_ == JsonDocumentType::kSimplified)
+          {
+            if (!handler_.StartObject())
+              return false;
+            stack_.push_back(Container::kRootObject);
+            state_ = State::kObjectKey;
+            continue;
+          }
+
+          if (type != detail::TokenType::kCurlyLeft && type != detail::TokenType::kBraceLeft)
+            return detail::unexpected_token<detail::TokenType::kCurlyLeft, detail::TokenType::kBraceLeft>(context);
+          return begin_value(context);
+
+        case State::kArrayValue:
+          if (type == detail::TokenType::kBraceRight)
+            return end_container();
+          return begin_value(context);
+
+        case State::kArrayNext:
+          if (type == detail::TokenType::kComma)
+          {
+            state_ = State::kArrayValue;
+            return true;
+          }
+          if (type == detail::TokenType::kBraceRight)
+            return end_container();
+
+          // Must be a comma present in normal json
+          if (documentType_ == JsonDocumentType::kNormal)
+            return detail::unexpected_token<detail::TokenType::kComma, detail::TokenType::kBraceRight>(context);
+          state_ = State::kArrayValue;
+          continue;
+
+        case State::kObjectKey:
+          // The root object of a simplified document also ends with the input
+          if (type == detail::TokenType::kCurlyRight ||
+            (stack_.back() == Container::kRootObject && type == detail::TokenType::kEOF))
+            return end_container();
+
+          if ((documentType_ == JsonDocumentType::kNormal && !detail::expect<detail::TokenType::kString>(context, false)) ||
+            (documentType_ == JsonDocumentType::kSimplified && !detail::expect<detail::TokenType::kString, detail::TokenType::kIdentifier>(context, false)))
+            return false;
+
+          state_ = State::kObjectSeperator;
+          return handler_.Key(context.text());
+
+        case State::kObjectSeperator:
+          if (type != detail::TokenType::kSeperator)
+            return detail::unexpected_token<detail::TokenType::kSeperator>(context);
+          state_ = State::kObjectValue;
+          return true;
+
+        case State::kObjectValue:
+          return begin_value(context);
+
+        case State::kObjectNext:
+          if (type == detail::TokenType::kComma)
+          {
+            state_ = State::kObjectKey;
+            return true;
+          }
+
+          // Must be a comma present in normal json
+          if (documentType_ == JsonDocumentType::kNormal && type != detail::TokenType::kCurlyRight)
+            return detail::unexpected_token<detail::TokenType::kComma, detail::TokenType::kCurlyRight>(context);
+          state_ = State::kObjectKey;
+          continue;
+        }
+      }
+    }
+
+    /// Starts the value of the current token. Scalars are complete immediately, containers are
+    /// opened.
+    bool begin_value(Context &context)
+    {
+      switch (context.token().type)
+      {
+      case detail::TokenType::kBraceLeft:
+        if (!handler_.StartArray())
+          return false;
+        stack_.push_back(Container::kArray);
+        state_ = State::kArrayValue;
+        return true;
+      case detail::TokenType::kCurlyLeft:
+        if (!handler_.StartObject())
+          return false;
+        stack_.push_back(Container::kObject);
+        state_ = State::kObjectKey;
+        return true;
+      case detail::TokenType::kNumber:
+      {
+        StringRef text(context.text());
+        detail::ParsedNumber number;
+        if (!detail::parse_number(text.begin(), text.end(), number))
+          return context.error(JsonParseErrorCode::kInvalidNumber, detail::TokenType::kNumber);
+        if (!(number.isInteger ? handler_.Integer(number.integer) : handler_.Number(number.value)))
+          return false;
+        break;
+      }
+      case detail::TokenType::kString:
+        if (!handler_.String(context.text()))
+          return false;
+        break;
+      case detail::TokenType::kTrue:
+        if (!handler_.Boolean(true))
+          return false;
+        break;
+      case detail::TokenType::kFalse:
+        if (!handler_.Boolean(false))
+          return false;
+        break;
+      case detail::TokenType::kNull:
+        if (!handler_.Null())
+          return false;
+        break;
+      default:
+        return detail::unexpected_token<detail::TokenType::kCurlyLeft, detail::TokenType::kBraceLeft, detail::TokenType::kString,
+          detail::TokenType::kNumber, detail::TokenType::kTrue, detail::TokenType::kFalse, detail::TokenType::kNull>(context);
+      }
+
+      end_value();
+      return true;
+    }
+
+    /// Closes the innermost container
+    bool end_container()
+    {
+      if (!(stack_.back() == Container::kArray ? handler_.EndArray() : handler_.EndObject()))
+        return false;
+
+      stack_.pop_back();
+      end_value();
+      return true;
+    }
+
+    /// Moves on to whatever follows a completed value, the document is complete once the root
+    /// value is
+    void end_value()
+    {
+      if (stack_.empty())
+        status_ = JsonPushStatus::kComplete;
+      else
+        state_ = stack_.back() == Container::kArray ? State::kArrayNext : State::kObjectNext;
+    }
+
+  private:
+    Handler &handler_;
+    IJsonParserLog *log_;
+    JsonDocumentType documentType_;
+    State state_;
+    JsonPushStatus status_;
+    std::vector<Container> stack_;
+    std::string pending_;
+    std::string scratch_;
+    uint32_t lines_;
+    uint32_t columns_;
+    uint64_t offset_;
+  };
+}
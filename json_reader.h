@@ -0,0 +1,461 @@
+#pragma once
+
+#include "json_number.h"
+#include "json_tokenizer.h"
+
+#include <vector>
+
+namespace knowson {
+
+  /**
+   * @brief Receives the events of a json document as it is parsed. Every method returns true to
+   *  continue parsing or false to stop. Strings passed to String and Key are only valid for the
+   *  duration of the call.
+   *
+   *  parse_json_events accepts any type with these methods as a handler, so implementing this
+   *  interface is only required when the handler has to be chosen at runtime.
+   */
+  struct IJsonHandler
+  {
+  public:
+    /// Called for a null value
+    virtual bool Null() = 0;
+
+    /// Called for a boolean value
+    virtual bool Boolean(bool value) = 0;
+
+    /// Called for a number value that is not an integer or does not fit in 64 bits
+    virtual bool Number(double value) = 0;
+
+    /// Called for an integer value that fits in 64 bits
+    virtual bool Integer(int64_t value) = 0;
+
+    /// Called for a string value
+    virtual bool String(StringRef value) = 0;
+
+    /// Called when an object starts
+    virtual bool StartObject() = 0;
+
+    /// Called for the key of every member of an object, followed by the events of its value
+    virtual bool Key(StringRef key) = 0;
+
+    /// Called when an object ends
+    virtual bool EndObject() = 0;
+
+    /// Called when an array starts
+    virtual bool StartArray() = 0;
+
+    /// Called when an array ends
+    virtual bool EndArray() = 0;
+  };
+
+  namespace detail {
+
+		//-----------------------------------------------------------------------------------------------
+		template<typename Context, typename Handler>
+		bool parse_value(Context &context, Handler &handler);
+
+		//-----------------------------------------------------------------------------------------------
+		template<TokenType ... Args, typename Context>
+		bool unexpected_token(Context &context)
+		{
+      return context.error(JsonParseErrorCode::kUnexpectedToken, context.token().type, TokenMask<Args...>::value);
+		}
+
+    //-----------------------------------------------------------------------------------------------
+    template<TokenType ... T, typename Context>
+    bool expect(Context &context, bool skip = true)
+    {
+      if (((TokenMask<T...>::value >> static_cast<uint32_t>(context.token().type)) & 1) == 0)
+        return unexpected_token<T...>(context);
+
+      if (skip) context.next();
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename Context, typename Handler>
+    bool parse_array(Context &context, Handler &handler)
+    {
+      if (!context.enter() || !expect<TokenType::kBraceLeft>(context))
+        return false;
+
+      if (!handler.StartArray())
+        return false;
+
+      while (context.token().type != TokenType::kBraceRight)
+      {
+        // Parse a new value
+        if (!parse_value(context, handler))
+          return false;
+
+        // Must be a comma present in normal json
+        if (context.document_type() == JsonDocumentType::kNormal &&
+          context.token().type != TokenType::kComma &&
+          context.token().type != TokenType::kBraceRight)
+          return unexpected_token<TokenType::kComma, TokenType::kBraceRight>(context);
+
+        // Skip comma if present
+        if (context.token().type == TokenType::kComma)
+          context.next();
+      }
+
+      if(!expect<TokenType::kBraceRight>(context))
+          return false;
+
+      context.leave();
+      return handler.EndArray();
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename Context, typename Handler>
+    bool parse_object(Context &context, Handler &handler, bool root = false)
+    {
+      if (!context.enter())
+        return false;
+      if ((context.document_type() == JsonDocumentType::kNormal || !root) &&
+        !expect<TokenType::kCurlyLeft>(context))
+        return false;
+
+      if (!handler.StartObject())
+        return false;
+
+      while (!(context.token().type == TokenType::kCurlyRight ||
+              (root && context.token().type == TokenType::kEOF)))
+      {
+        if ((context.document_type() == JsonDocumentType::kNormal && !expect<TokenType::kString>(context, false)) ||
+          (context.document_type() == JsonDocumentType::kSimplified && !expect<TokenType::kString, TokenType::kIdentifier>(context, false)))
+          return false;
+
+        // Report the key
+        if (!handler.Key(context.text()))
+          return false;
+
+        // Skip the key
+        context.next();
+
+        // Seperator is next
+        if (!expect<TokenType::kSeperator>(context))
+          return false;
+
+        // Next up is a value
+        if (!parse_value(context, handler))
+          return false;
+
+        // Must be a comma present in normal json
+        if (context.document_type() == JsonDocumentType::kNormal &&
+            context.token().type != TokenType::kComma &&
+            context.token().type != TokenType::kCurlyRight)
+            return unexpected_token<TokenType::kComma, TokenType::kCurlyRight>(context);
+
+        // Skip comma if present
+        if (context.token().type == TokenType::kComma)
+          context.next();
+      }
+
+      if ((context.document_type() == JsonDocumentType::kNormal || !root)
+        && !expect<TokenType::kCurlyRight>(context))
+        return false;
+
+      context.leave();
+      return handler.EndObject();
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Completes the parse of a document. The token after the root value is read as well, so an
+    /// error in it, like a size limit that runs out in trailing whitespace, fails the parse
+    /// instead of only being reported.
+    template<typename Context>
+    bool end_document(const Context &context, bool parsed)
+    {
+      return parsed && !context.reported_error();
+    }
+
+		//-----------------------------------------------------------------------------------------------
+		template<typename Context, typename Handler>
+		bool parse_document_root(Context &context, Handler &handler)
+		{
+			// Parse the first token
+      context.next();
+
+      // Determine content type
+      if (context.document_type() == JsonDocumentType::kUnknown)
+      {
+        if (context.token().type == TokenType::kCurlyLeft ||
+          context.token().type == TokenType::kBraceLeft)
+          context.set_document_type(JsonDocumentType::kNormal);
+        else
+          context.set_document_type(JsonDocumentType::kSimplified);
+      }
+
+			// Parse the root object
+      if (context.document_type() == JsonDocumentType::kSimplified)
+      {
+        DialectContext<Context, JsonDocumentType::kSimplified> simplified(context);
+				return end_document(context, parse_object(simplified, handler, true));
+      }
+
+      // Normal json then
+      DialectContext<Context, JsonDocumentType::kNormal> normal(context);
+			if(context.token().type == TokenType::kCurlyLeft)
+				return end_document(context, parse_object(normal, handler));
+			else if(context.token().type == TokenType::kBraceLeft)
+				return end_document(context, parse_array(normal, handler));
+			else
+        return unexpected_token<TokenType::kCurlyLeft, TokenType::kBraceLeft>(context);
+		}
+
+    //-----------------------------------------------------------------------------------------------
+    template<typename Context, typename Handler>
+    bool parse_value(Context &context, Handler &handler)
+    {
+      switch (context.token().type)
+      {
+      case TokenType::kBraceLeft:
+        return parse_array(context, handler);
+      case TokenType::kCurlyLeft:
+        return parse_object(context, handler);
+      case TokenType::kNumber:
+      {
+        StringRef text(context.text());
+        ParsedNumber number;
+        if (!parse_number(text.begin(), text.end(), number))
+          return context.error(JsonParseErrorCode::kInvalidNumber, TokenType::kNumber);
+
+        if (!(number.isInteger ? handler.Integer(number.integer) : handler.Number(number.value)))
+          return false;
+        context.next();
+        return true;
+      }
+      case TokenType::kString:
+      {
+        if (!handler.String(context.text()))
+          return false;
+        context.next();
+        return true;
+      }
+      case TokenType::kTrue:
+      {
+        if (!handler.Boolean(true))
+          return false;
+        context.next();
+        return true;
+      }
+      case TokenType::kFalse:
+      {
+        if (!handler.Boolean(false))
+          return false;
+        context.next();
+        return true;
+      }
+      case TokenType::kNull:
+      {
+        if (!handler.Null())
+          return false;
+        context.next();
+        return true;
+      }
+      default:
+        return unexpected_token<TokenType::kCurlyLeft, TokenType::kBraceLeft, TokenType::kString, TokenType::kNumber,
+          TokenType::kTrue, TokenType::kFalse, TokenType::kNull>(context);
+      }
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// The containers that are open during an iterative parse
+    enum class ParseFrame : uint8_t
+    {
+      kArray,
+      kObject,
+      kRootObject,
+    };
+
+    //-----------------------------------------------------------------------------------------------
+    /// Parses the root value with an explicit stack of open containers, the first token must
+    /// already be read.
+    template<typename Context, typename Handler>
+    bool parse_root_iterative(Context &context, Handler &handler)
+    {
+      enum class State
+      {
+        kValue,
+        kElements,
+        kMembers,
+        kNext,
+      };
+
+      const bool normal = context.document_type() == JsonDocumentType::kNormal;
+      std::vector<ParseFrame> stack;
+      State state = State::kValue;
+      if (!normal)
+      {
+        // The root object of a simplified document has no braces
+        if (!context.enter() || !handler.StartObject())
+          return false;
+        stack.push_back(ParseFrame::kRootObject);
+        state = State::kMembers;
+      }
+      else if (context.token().type != TokenType::kCurlyLeft && context.token().type != TokenType::kBraceLeft)
+        return unexpected_token<TokenType::kCurlyLeft, TokenType::kBraceLeft>(context);
+
+      for (;;)
+      {
+        TokenType type = context.token().type;
+        switch (state)
+        {
+        case State::kValue:
+          switch (type)
+          {
+          case TokenType::kBraceLeft:
+            if (!context.enter())
+              return false;
+            context.next();
+            if (!handler.StartArray())
+              return false;
+            stack.push_back(ParseFrame::kArray);
+            state = State::kElements;
+            continue;
+          case TokenType::kCurlyLeft:
+            if (!context.enter())
+              return false;
+            context.next();
+            if (!handler.StartObject())
+              return false;
+            stack.push_back(ParseFrame::kObject);
+            state = State::kMembers;
+            continue;
+          case TokenType::kNumber:
+          case TokenType::kString:
+          case TokenType::kTrue:
+          case TokenType::kFalse:
+          case TokenType::kNull:
+            if (!parse_value(context, handler))
+              return false;
+            state = State::kNext;
+            continue;
+          default:
+            return parse_value(context, handler);
+          }
+
+        case State::kElements:
+          if (type != TokenType::kBraceRight)
+          {
+            state = State::kValue;
+            continue;
+          }
+
+          context.next();
+          context.leave();
+          if (!handler.EndArray())
+            return false;
+          stack.pop_back();
+          state = State::kNext;
+          continue;
+
+        case State::kMembers:
+          if (type == TokenType::kCurlyRight || (stack.back() == ParseFrame::kRootObject && type == TokenType::kEOF))
+          {
+            // The root object of a simplified document does not consume its end
+            if (stack.back() != ParseFrame::kRootObject)
+              context.next();
+            context.leave();
+            if (!handler.EndObject())
+              return false;
+            stack.pop_back();
+            state = State::kNext;
+            continue;
+          }
+
+          if ((normal && !expect<TokenType::kString>(context, false)) ||
+            (!normal && !expect<TokenType::kString, TokenType::kIdentifier>(context, false)))
+            return false;
+          if (!handler.Key(context.text()))
+            return false;
+          context.next();
+          if (!expect<TokenType::kSeperator>(context))
+            return false;
+          state = State::kValue;
+          continue;
+
+        case State::kNext:
+          if (stack.empty())
+            return true;
+
+          // Must be a comma present in normal json
+          if (stack.back() == ParseFrame::kArray)
+          {
+            if (normal && type != TokenType::kComma && type != TokenType::kBraceRight)
+              return unexpected_token<TokenType::kComma, TokenType::kBraceRight>(context);
+            state = State::kElements;
+          }
+          else
+          {
+            if (normal && type != TokenType::kComma && type != TokenType::kCurlyRight)
+              return unexpected_token<TokenType::kComma, TokenType::kCurlyRight>(context);
+            state = State::kMembers;
+          }
+
+          // Skip comma if present
+          if (type == TokenType::kComma)
+            context.next();
+          continue;
+        }
+      }
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    /// Parses a document with the same grammar as parse_document_root, but from an explicit stack
+    /// of open containers instead of recursing for every object and array. The stack takes one
+    /// byte per level of nesting.
+    template<typename Context, typename Handler>
+    bool parse_document_iterative(Context &context, Handler &handler)
+    {
+      context.next();
+      if (context.document_type() == JsonDocumentType::kUnknown)
+      {
+        if (context.token().type == TokenType::kCurlyLeft ||
+          context.token().type == TokenType::kBraceLeft)
+          context.set_document_type(JsonDocumentType::kNormal);
+        else
+          context.set_document_type(JsonDocumentType::kSimplified);
+      }
+
+      if (context.document_type() == JsonDocumentType::kSimplified)
+      {
+        DialectContext<Context, JsonDocumentType::kSimplified> simplified(context);
+        return end_document(context, parse_root_iterative(simplified, handler));
+      }
+
+      DialectContext<Context, JsonDocumentType::kNormal> normal(context);
+      return end_document(context, parse_root_iterative(normal, handler));
+    }
+  }
+
+  /// Parses a json document and reports its contents to the given handler without building a
+  /// tree. Returns false if the document is malformed or if the handler stopped the parse.
+  template<typename Handler>
+  bool parse_json_events(IJsonParserSource *source, Handler &handler, IJsonParserLog *log = nullptr, JsonDocumentType documentType = JsonDocumentType::kUnknown)
+  {
+    const char *data;
+    size_t length;
+    if (source->Span(data, length))
+    {
+      detail::ParseContext<detail::SpanInput> context(log, documentType, data, length);
+      return detail::parse_document_root(context, handler);
+    }
+
+    JsonParserOptions options;
+    detail::BlockPool blocks(options.blockSize, options.blockAllocator);
+    detail::ParseContext<detail::BlockInput> context(log, documentType, source, blocks);
+    return detail::parse_document_root(context, handler);
+  }
+
+  /// Parses a json document from a contiguous buffer and reports its contents to the given
+  /// handler without building a tree. Strings reported to the handler point into the buffer.
+  template<typename Handler>
+  bool parse_json_events(const char *data, size_t length, Handler &handler, IJsonParserLog *log = nullptr, JsonDocumentType documentType = JsonDocumentType::kUnknown)
+  {
+    detail::ParseContext<detail::SpanInput> context(log, documentType, data, length);
+    return detail::parse_document_root(context, handler);
+  }
+}
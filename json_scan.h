@@ -0,0 +1,588 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define KNOWSON_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define KNOWSON_SCAN_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define KNOWSON_SCAN_NEON 1
+#endif
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+namespace knowson {
+
+  namespace detail {
+
+    /// Returns true for the characters that std::isspace accepts in the "C" locale
+    inline bool is_whitespace(char c)
+    {
+      return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+    }
+
+    /// Returns true for the characters that std::isdigit accepts
+    inline bool is_digit(char c)
+    {
+      return static_cast<unsigned char>(c - '0') <= 9;
+    }
+
+    /// Returns true for the characters that std::iscntrl accepts in the "C" locale
+    inline bool is_control(char c)
+    {
+      return static_cast<unsigned char>(c) < 0x20 || c == 0x7f;
+    }
+
+    /// Returns true for the characters that end an identifier or a number
+    inline bool is_delimiter(char c, bool equalsIsSeperator)
+    {
+      switch (c)
+      {
+      case '{': case '}': case '[': case ']': case ',': case ':':
+        return true;
+      case '=':
+        return equalsIsSeperator;
+      default:
+        return is_whitespace(c);
+      }
+    }
+
+    /// Returns true for the characters that can change the nesting of a document or start a
+    /// string or a comment: a quote, a bracket, a comma, a slash or a minus.
+    inline bool is_structural(char c)
+    {
+      return c == '"' || c == ',' || c == '{' || c == '}' || c == '[' || c == ']' || c == '/' || c == '-';
+    }
+
+    /// Returns the index of the lowest set bit of a non-zero mask
+    inline uint32_t trailing_zeros(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+      unsigned long index;
+      _BitScanForward(&index, mask);
+      return static_cast<uint32_t>(index);
+#else
+      return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+    }
+
+    /// Returns the index of the highest set bit of a non-zero mask
+    inline uint32_t leading_bit(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+      unsigned long index;
+      _BitScanReverse(&index, mask);
+      return static_cast<uint32_t>(index);
+#else
+      return 31u - static_cast<uint32_t>(__builtin_clz(mask));
+#endif
+    }
+
+    /// Returns the number of set bits in a mask
+    inline uint32_t population_count(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+      return static_cast<uint32_t>(__popcnt(mask));
+#else
+      return static_cast<uint32_t>(__builtin_popcount(mask));
+#endif
+    }
+
+#if defined(KNOWSON_SCAN_AVX2) || defined(KNOWSON_SCAN_SSE2) || defined(KNOWSON_SCAN_NEON)
+#  define KNOWSON_SCAN_SIMD 1
+
+    /**
+     * @brief A block of characters loaded into a vector register. Every test returns a mask with
+     *  one bit per character, the lowest bit corresponding to the first character.
+     */
+    struct ScanChunk
+    {
+#if defined(KNOWSON_SCAN_AVX2)
+      static const size_t kSize = 32;
+
+      explicit ScanChunk(const char *p) : v(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))) {}
+
+      /// Characters equal to c
+      uint32_t eq(char c) const { return mask(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))); }
+
+      /// Characters that are whitespace
+      uint32_t whitespace() const
+      {
+        __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+        __m256i range = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+        return mask(_mm256_or_si256(range, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))));
+      }
+
+      /// Characters that are control characters
+      uint32_t control() const
+      {
+        __m256i low = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+        return mask(_mm256_or_si256(low, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f))));
+      }
+
+      /// Writes the characters of the chunk to out
+      void store(char *out) const { _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), v); }
+
+      /// Characters that are a quote, a backslash or outside of ASCII
+      uint32_t string_special() const
+      {
+        __m256i quotes = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+        return mask(_mm256_or_si256(quotes, v));
+      }
+
+      static uint32_t mask(__m256i m) { return static_cast<uint32_t>(_mm256_movemask_epi8(m)); }
+
+      __m256i v;
+#elif defined(KNOWSON_SCAN_SSE2)
+      static const size_t kSize = 16;
+
+      explicit ScanChunk(const char *p) : v(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+      /// Characters equal to c
+      uint32_t eq(char c) const { return mask(_mm_cmpeq_epi8(v, _mm_set1_epi8(c))); }
+
+      /// Characters that are whitespace
+      uint32_t whitespace() const
+      {
+        __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+        __m128i range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+        return mask(_mm_or_si128(range, _mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+      }
+
+      /// Characters that are control characters
+      uint32_t control() const
+      {
+        __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+        return mask(_mm_or_si128(low, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f))));
+      }
+
+      /// Writes the characters of the chunk to out
+      void store(char *out) const { _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v); }
+
+      /// Characters that are a quote, a backslash or outside of ASCII
+      uint32_t string_special() const
+      {
+        __m128i quotes = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+        return mask(_mm_or_si128(quotes, v));
+      }
+
+      static uint32_t mask(__m128i m) { return static_cast<uint32_t>(_mm_movemask_epi8(m)); }
+
+      __m128i v;
+#elif defined(KNOWSON_SCAN_NEON)
+      static const size_t kSize = 16;
+
+      explicit ScanChunk(const char *p) : v(vld1q_u8(reinterpret_cast<const uint8_t*>(p))) {}
+
+      /// Characters equal to c
+      uint32_t eq(char c) const { return mask(vceqq_u8(v, vdupq_n_u8(static_cast<uint8_t>(c)))); }
+
+      /// Characters that are whitespace
+      uint32_t whitespace() const
+      {
+        uint8x16_t range = vcleq_u8(vsubq_u8(v, vdupq_n_u8('\t')), vdupq_n_u8('\r' - '\t'));
+        return mask(vorrq_u8(range, vceqq_u8(v, vdupq_n_u8(' '))));
+      }
+
+      /// Characters that are control characters
+      uint32_t control() const
+      {
+        return mask(vorrq_u8(vcltq_u8(v, vdupq_n_u8(0x20)), vceqq_u8(v, vdupq_n_u8(0x7f))));
+      }
+
+      /// Writes the characters of the chunk to out
+      void store(char *out) const { vst1q_u8(reinterpret_cast<uint8_t*>(out), v); }
+
+      /// Characters that are a quote, a backslash or outside of ASCII
+      uint32_t string_special() const
+      {
+        uint8x16_t quotes = vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\')));
+        return mask(vorrq_u8(quotes, vcgeq_u8(v, vdupq_n_u8(0x80))));
+      }
+
+      static uint32_t mask(uint8x16_t m)
+      {
+        static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        uint8x16_t masked = vandq_u8(m, vld1q_u8(bits));
+        return static_cast<uint32_t>(vaddv_u8(vget_low_u8(masked))) |
+          (static_cast<uint32_t>(vaddv_u8(vget_high_u8(masked))) << 8);
+      }
+
+      uint8x16_t v;
+#endif
+      /// Mask with a bit set for every character in the chunk
+      static uint32_t all() { return kSize == 32 ? 0xffffffffu : (1u << kSize) - 1; }
+    };
+#endif
+
+    /// Returns the first character in [p, end) that is not whitespace, or end.
+    inline const char* skip_whitespace(const char *p, const char *end)
+    {
+      // Most runs of whitespace are a single space, check for that before going wide
+      if (p == end || !is_whitespace(*p))
+        return p;
+      ++p;
+
+#if defined(KNOWSON_SCAN_SIMD)
+      while (static_cast<size_t>(end - p) >= ScanChunk::kSize)
+      {
+        uint32_t mask = ~ScanChunk(p).whitespace() & ScanChunk::all();
+        if (mask != 0)
+          return p + trailing_zeros(mask);
+        p += ScanChunk::kSize;
+      }
+#endif
+      while (p != end && is_whitespace(*p))
+        ++p;
+      return p;
+    }
+
+    /// Returns the first character in [p, end) that ends an identifier or a number, or end.
+    inline const char* find_delimiter(const char *p, const char *end, bool equalsIsSeperator)
+    {
+#if defined(KNOWSON_SCAN_SIMD)
+      while (static_cast<size_t>(end - p) >= ScanChunk::kSize)
+      {
+        ScanChunk chunk(p);
+        uint32_t mask = chunk.whitespace() |
+          chunk.eq('{') | chunk.eq('}') | chunk.eq('[') | chunk.eq(']') |
+          chunk.eq(',') | chunk.eq(':') | (equalsIsSeperator ? chunk.eq('=') : 0);
+        if (mask != 0)
+          return p + trailing_zeros(mask);
+        p += ScanChunk::kSize;
+      }
+#endif
+      while (p != end && !is_delimiter(*p, equalsIsSeperator))
+        ++p;
+      return p;
+    }
+
+    /// Returns the first quote, backslash or character outside of ASCII in [p, end), or end.
+    /// These are the characters that need a closer look while scanning a string.
+    inline const char* find_string_special(const char *p, const char *end)
+    {
+#if defined(KNOWSON_SCAN_SIMD)
+      while (static_cast<size_t>(end - p) >= ScanChunk::kSize)
+      {
+        uint32_t mask = ScanChunk(p).string_special();
+        if (mask != 0)
+          return p + trailing_zeros(mask);
+        p += ScanChunk::kSize;
+      }
+#endif
+      while (p != end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) < 0x80)
+        ++p;
+      return p;
+    }
+
+    /// Returns the length of the UTF-8 sequence that starts with the given character, or 0 if it
+    /// cannot start a sequence. The range of the second character is returned as well, it is
+    /// narrower than that of the other continuation characters to exclude overlong encodings,
+    /// surrogates and code points beyond U+10FFFF.
+    inline size_t utf8_sequence(unsigned char lead, unsigned char &low, unsigned char &high)
+    {
+      low = 0x80;
+      high = 0xbf;
+      if (lead < 0xc2)
+        return 0;
+      if (lead < 0xe0)
+        return 2;
+      if (lead < 0xf0)
+      {
+        if (lead == 0xe0)
+          low = 0xa0;
+        else if (lead == 0xed)
+          high = 0x9f;
+        return 3;
+      }
+      if (lead < 0xf5)
+      {
+        if (lead == 0xf0)
+          low = 0x90;
+        else if (lead == 0xf4)
+          high = 0x8f;
+        return 4;
+      }
+      return 0;
+    }
+
+    /// Skips the valid UTF-8 sequences at p that lie entirely within [p, end). Returns the first
+    /// character that is ASCII, not valid UTF-8 or the start of a sequence that runs past end.
+    inline const char* skip_utf8(const char *p, const char *end)
+    {
+      while (p != end && static_cast<unsigned char>(*p) >= 0x80)
+      {
+        unsigned char low, high;
+        size_t length = utf8_sequence(static_cast<unsigned char>(*p), low, high);
+        if (length == 0 || static_cast<size_t>(end - p) < length)
+          return p;
+
+        unsigned char second = static_cast<unsigned char>(p[1]);
+        if (second < low || second > high)
+          return p;
+        for (size_t i = 2; i < length; ++i)
+          if ((static_cast<unsigned char>(p[i]) & 0xc0) != 0x80)
+            return p;
+        p += length;
+      }
+      return p;
+    }
+
+    /// Returns true for the characters that can follow a backslash in a string
+    inline bool is_escape(char c)
+    {
+      switch (c)
+      {
+      case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't': case 'u':
+        return true;
+      default:
+        return false;
+      }
+    }
+
+    /// Returns true for hexadecimal digits
+    inline bool is_hex_digit(char c)
+    {
+      return is_digit(c) || static_cast<unsigned char>((c | 0x20) - 'a') < 6;
+    }
+
+    /// Scans the characters of a string in [p, end) up to its closing quote. Escape sequences and
+    /// UTF-8 sequences that lie entirely within the range are checked and skipped, escaped is set
+    /// if there are escape sequences. Returns the closing quote, the start of a sequence that is
+    /// not valid or runs past end, or end.
+    inline const char* scan_string(const char *p, const char *end, bool &escaped)
+    {
+      for (;;)
+      {
+        p = find_string_special(p, end);
+        if (p == end || *p == '"')
+          return p;
+
+        if (*p != '\\')
+        {
+          const char *next = skip_utf8(p, end);
+          if (next == p)
+            return p;
+          p = next;
+          continue;
+        }
+
+        if (end - p < 2 || !is_escape(p[1]))
+          return p;
+        if (p[1] == 'u')
+        {
+          if (end - p < 6 || !is_hex_digit(p[2]) || !is_hex_digit(p[3]) || !is_hex_digit(p[4]) || !is_hex_digit(p[5]))
+            return p;
+          p += 6;
+        }
+        else
+          p += 2;
+        escaped = true;
+      }
+    }
+
+    /// Returns true if the quote at p is escaped, that is preceded by an odd number of
+    /// backslashes. The backslashes are not searched before first.
+    inline bool is_escaped(const char *first, const char *p)
+    {
+      const char *q = p;
+      while (q != first && q[-1] == '\\')
+        --q;
+      return ((p - q) & 1) != 0;
+    }
+
+    /// Returns the value of four hexadecimal digits
+    inline uint32_t parse_hex4(const char *p)
+    {
+      uint32_t value = 0;
+      for (int i = 0; i < 4; ++i)
+      {
+        char c = p[i];
+        value = (value << 4) | static_cast<uint32_t>(is_digit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+      }
+      return value;
+    }
+
+    /// Writes a code point as UTF-8 and returns the end of the written characters
+    inline char* encode_utf8(uint32_t code, char *out)
+    {
+      if (code < 0x80)
+        *out++ = static_cast<char>(code);
+      else if (code < 0x800)
+      {
+        *out++ = static_cast<char>(0xc0 | (code >> 6));
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+      }
+      else if (code < 0x10000)
+      {
+        *out++ = static_cast<char>(0xe0 | (code >> 12));
+        *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+      }
+      else
+      {
+        *out++ = static_cast<char>(0xf0 | (code >> 18));
+        *out++ = static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+      }
+      return out;
+    }
+
+    /// Decodes the escape sequences of the string [p, end), which the tokenizer checked, into
+    /// out and returns the number of characters written. The output is never longer than the
+    /// input, out must have room for end - p characters and must not overlap the input. A
+    /// surrogate that is not part of a pair becomes U+FFFD.
+    inline size_t unescape(const char *p, const char *end, char *out)
+    {
+      char *start = out;
+      for (;;)
+      {
+        // Copy up to the next backslash a chunk at a time, a chunk is stored whole even if it
+        // contains the backslash
+#if defined(KNOWSON_SCAN_SIMD)
+        while (static_cast<size_t>(end - p) >= ScanChunk::kSize)
+        {
+          ScanChunk chunk(p);
+          chunk.store(out);
+          uint32_t mask = chunk.eq('\\');
+          if (mask != 0)
+          {
+            uint32_t skip = trailing_zeros(mask);
+            p += skip;
+            out += skip;
+            break;
+          }
+          p += ScanChunk::kSize;
+          out += ScanChunk::kSize;
+        }
+#endif
+        while (p != end && *p != '\\')
+          *out++ = *p++;
+        if (p == end)
+          return static_cast<size_t>(out - start);
+
+        char c = p[1];
+        p += 2;
+        switch (c)
+        {
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u':
+        {
+          uint32_t code = parse_hex4(p);
+          p += 4;
+          if (code >= 0xd800 && code < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+          {
+            uint32_t low = parse_hex4(p + 2);
+            if (low >= 0xdc00 && low < 0xe000)
+            {
+              code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+              p += 6;
+            }
+          }
+          if (code >= 0xd800 && code < 0xe000)
+            code = 0xfffd;
+          out = encode_utf8(code, out);
+          break;
+        }
+        default:
+          *out++ = c;
+          break;
+        }
+      }
+    }
+
+    /// Returns the first character in [p, end) that has to be escaped in a string: a quote, a
+    /// backslash or a control character, or end.
+    inline const char* find_escaped(const char *p, const char *end)
+    {
+#if defined(KNOWSON_SCAN_SIMD)
+      while (static_cast<size_t>(end - p) >= ScanChunk::kSize)
+      {
+        ScanChunk chunk(p);
+        uint32_t mask = chunk.eq('"') | chunk.eq('\\') | chunk.control();
+        if (mask != 0)
+          return p + trailing_zeros(mask);
+        p += ScanChunk::kSize;
+      }
+#endif
+      while (p != end && *p != '"' && *p != '\\' && !is_control(*p))
+        ++p;
+      return p;
+    }
+
+#if defined(KNOWSON_SCAN_SIMD)
+    /// Returns a mask of the characters in the chunk at p for which is_structural is true
+    inline uint32_t structural_mask(const char *p)
+    {
+      ScanChunk chunk(p);
+      return chunk.eq('"') | chunk.eq(',') |
+        chunk.eq('{') | chunk.eq('}') | chunk.eq('[') | chunk.eq(']') |
+        chunk.eq('/') | chunk.eq('-');
+    }
+#endif
+
+    /// Returns the first newline in [p, end), or end.
+    inline const char* find_newline(const char *p, const char *end)
+    {
+      const void *result = p != end ? std::memchr(p, '\n', static_cast<size_t>(end - p)) : nullptr;
+      return result != nullptr ? static_cast<const char*>(result) : end;
+    }
+
+    /// Counts the newlines in [p, end) and returns the last one, or nullptr if there are none.
+    inline const char* scan_newlines(const char *p, const char *end, uint32_t &count)
+    {
+      const char *last = nullptr;
+#if defined(KNOWSON_SCAN_SIMD)
+      while (static_cast<size_t>(end - p) >= ScanChunk::kSize)
+      {
+        uint32_t mask = ScanChunk(p).eq('\n');
+        if (mask != 0)
+        {
+          count += population_count(mask);
+          last = p + leading_bit(mask);
+        }
+        p += ScanChunk::kSize;
+      }
+#endif
+      for (; p != end; ++p)
+      {
+        if (*p == '\n')
+        {
+          ++count;
+          last = p;
+        }
+      }
+      return last;
+    }
+
+    /// Returns the number of characters in [p, end) that are not control characters
+    inline uint32_t count_columns(const char *p, const char *end)
+    {
+      uint32_t count = 0;
+#if defined(KNOWSON_SCAN_SIMD)
+      while (static_cast<size_t>(end - p) >= ScanChunk::kSize)
+      {
+        count += static_cast<uint32_t>(ScanChunk::kSize) - population_count(ScanChunk(p).control());
+        p += ScanChunk::kSize;
+      }
+#endif
+      for (; p != end; ++p)
+        if (!is_control(*p))
+          ++count;
+      return count;
+    }
+  }
+}
@@ -0,0 +1,1323 @@
+#pragma once
+
+#include "json_parser.h"
+#include "json_scan.h"
+#include "string_ref.h"
+
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <string>
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+#  include <chrono>
+#endif
+
+namespace knowson {
+
+	namespace detail
+	{
+    /**
+     * @brief Describes a piece of data from a source location. The characters are stored directly
+     *  after the block itself.
+     */
+		struct ParseBlock
+		{
+			char *data;
+			uint32_t size;
+			uint32_t capacity;
+			ParseBlock *next;
+		};
+
+    /**
+     * @brief Hands out ParseBlocks of a fixed size. Released blocks are kept on a free list, so a 
+     *  pool that outlives a parse serves the blocks of the next parse without allocating.
+     */
+    class BlockPool
+    {
+    public:
+      /// Constructs a pool of blocks that hold the given number of characters. Memory comes from
+      /// the allocator, or from the global heap if there is none.
+      BlockPool(uint32_t blockSize, IJsonBlockAllocator *allocator) :
+        blockSize_(std::max<uint32_t>(blockSize, 1)), allocator_(allocator), free_(nullptr) {}
+
+      /// Returns the memory of all free blocks. Blocks still in use must not outlive the pool.
+      ~BlockPool()
+      {
+        while (free_ != nullptr)
+        {
+          ParseBlock *next = free_->next;
+          size_t bytes = sizeof(ParseBlock) + free_->capacity;
+          if (allocator_ != nullptr)
+            allocator_->Free(free_, bytes);
+          else
+            ::operator delete(free_);
+          free_ = next;
+        }
+      }
+
+      /// Returns an empty block, from the free list if possible
+      ParseBlock* acquire()
+      {
+        ParseBlock *block = free_;
+        if (block != nullptr)
+          free_ = block->next;
+        else
+        {
+          size_t bytes = sizeof(ParseBlock) + blockSize_;
+          block = static_cast<ParseBlock*>(allocator_ != nullptr ? allocator_->Allocate(bytes) : ::operator new(bytes));
+          block->data = reinterpret_cast<char*>(block + 1);
+          block->capacity = blockSize_;
+        }
+
+        block->size = 0;
+        block->next = nullptr;
+        return block;
+      }
+
+      /// Puts a block back on the free list
+      void release(ParseBlock *block)
+      {
+        block->next = free_;
+        free_ = block;
+      }
+
+      /// Returns the number of characters per block
+      uint32_t block_size() const { return blockSize_; }
+
+      /// Returns true if the next acquired block is reused from the free list
+      bool has_free() const { return free_ != nullptr; }
+
+      /// Returns the buffer that tokens spanning multiple blocks are copied into. It lives with the
+      /// pool so its capacity is reused by every parse.
+      std::string& scratch() { return scratch_; }
+
+    private:
+      BlockPool(const BlockPool&) = delete;
+      BlockPool& operator=(const BlockPool&) = delete;
+
+      uint32_t blockSize_;
+      IJsonBlockAllocator *allocator_;
+      ParseBlock *free_;
+      std::string scratch_;
+    };
+
+    /**
+     * @brief Input that pulls character data from an IJsonParserSource into a chain of 
+     *  ParseBlocks. Blocks are kept alive from the start of the current token onwards and are
+     *  returned to the pool once the tokenizer has moved past them. Line numbers are counted once
+     *  per block when the cursor leaves it.
+     */
+    class BlockInput
+    {
+    public:
+      /**
+       * @brief Describes a selection from the source data. The selection can span multiple 
+       *  ParseBlocks.
+       */
+      struct Selection
+      {
+        Selection() : start(0), end(0), startBlock(nullptr), endBlock(nullptr) {}
+
+        uint32_t start, end;
+        ParseBlock *startBlock;
+        ParseBlock *endBlock;
+
+        /// Returns the number of characters in the selection
+        size_t size() const
+        {
+          size_t size = 0;
+          ParseBlock const* current = startBlock;
+          while (current != endBlock)
+          {
+            size += current == startBlock ? current->size - start : current->size;
+            current = current->next;
+          }
+          uint32_t endOffset = (endBlock == startBlock ? start : 0);
+          return size + end - endOffset;
+        }
+
+        /// Copies the characters in the selection to the given buffer which must be at least 
+        /// size() characters large.
+        void copy(char *buffer) const
+        {
+          ParseBlock const* current = startBlock;
+          while (current != endBlock)
+          {
+            uint32_t copyStart = current == startBlock ? start : 0;
+            std::memcpy(buffer, current->data + copyStart, current->size - copyStart);
+            buffer += current->size - copyStart;
+            current = current->next;
+          }
+          uint32_t endOffset = (endBlock == startBlock ? start : 0);
+          std::memcpy(buffer, endBlock->data + endOffset, end - endOffset);
+        }
+
+        /// Exctracts the data from the selection in the form of a string
+        std::string data() const
+        {
+          std::string result(size(), '\0');
+          copy(&result[0]);
+          return result;
+        }
+
+        /// Returns the characters in the selection as a contiguous range. Selections that span
+        /// multiple blocks are copied into the scratch buffer.
+        StringRef view(std::string &scratch) const
+        {
+          if (startBlock == endBlock)
+            return StringRef(startBlock->data + start, end - start);
+
+          scratch.resize(size());
+          copy(&scratch[0]);
+          return StringRef(scratch);
+        }
+      };
+
+    public:
+      /// Constructs an input that reads from the source into blocks of the pool
+      BlockInput(IJsonParserSource *s, BlockPool &p) : 
+        source(s), 
+        pool(p), 
+        tokenBlock(nullptr), 
+        currentBlock(nullptr), 
+        position(0),
+        passed(0),
+        read(0),
+        limit(UINT64_MAX),
+        lines(0),
+        columns(0),
+        trackLines(true),
+        truncated(false) {}
+
+      /// Default destructor
+      ~BlockInput()
+      {
+        /// Return the parse blocks that are owned by the current token, including the block that
+        /// is currently being used.
+        ParseBlock *block = tokenBlock != nullptr ? tokenBlock : currentBlock;
+        while (block != nullptr)
+        {
+          ParseBlock *next = block->next;
+          pool.release(block);
+          block = next;
+        }
+      }
+
+      /// Returns the character under the cursor without moving the cursor. Returns false if the 
+      /// source is drained.
+      bool peek(char &c)
+      {
+        while (currentBlock == nullptr || position >= currentBlock->size)
+        {
+          ParseBlock *block = allocate_next_block();
+          if (block == nullptr)
+            return false;
+
+          position = currentBlock ? position - currentBlock->size : 0;
+          if (currentBlock)
+          {
+            passed += currentBlock->size;
+            if (trackLines)
+              count_lines(currentBlock->data, currentBlock->data + currentBlock->size);
+            currentBlock->next = block;
+          }
+          currentBlock = block;
+        }
+
+        c = currentBlock->data[position];
+        return true;
+      }
+
+      /// Returns the contiguous characters from the cursor up to the end of the current block. 
+      /// Returns false if the source is drained.
+      bool window(const char *&begin, const char *&end)
+      {
+        char c;
+        if (!peek(c))
+          return false;
+
+        begin = currentBlock->data + position;
+        end = currentBlock->data + currentBlock->size;
+        return true;
+      }
+
+      /// Returns the character under the cursor. Only valid after a successful call to peek.
+      char current() const { return currentBlock->data[position]; }
+
+      /// Moves the cursor to the next character.
+      void advance() { ++position; }
+
+      /// Moves the cursor by the given number of characters within the current window.
+      void advance(size_t count) { position += static_cast<uint32_t>(count); }
+
+      /// Returns true if more characters may follow once the input is drained. A source is only
+      /// drained at its end.
+      bool partial() const { return false; }
+
+      /// Returns the number of characters before the cursor
+      uint64_t offset() const
+      {
+        return passed + (currentBlock != nullptr ? std::min(position, currentBlock->size) : 0);
+      }
+
+      /// Set to false to stop counting lines, location then reports line 0
+      void set_track_lines(bool track) { trackLines = track; }
+
+      /// Stops reading from the source after the given number of characters, 0 means no limit
+      void set_byte_limit(uint64_t bytes) { limit = bytes != 0 ? bytes : UINT64_MAX; }
+
+      /// Returns true if the input ended because of the byte limit
+      bool limited() const { return truncated; }
+
+      /// Returns the characters of a selection, a selection that spans multiple blocks is copied
+      /// into the scratch buffer of the pool
+      StringRef view(const Selection &selection) { return selection.view(pool.scratch()); }
+
+      /// Returns the characters of a string selection with its escape sequences decoded into the
+      /// scratch buffer of the pool
+      StringRef unescape(const Selection &selection)
+      {
+        std::string &scratch = pool.scratch();
+        if (selection.startBlock == selection.endBlock)
+        {
+          const char *begin = selection.startBlock->data + selection.start;
+          scratch.resize(selection.end - selection.start);
+          return StringRef(scratch.data(), detail::unescape(begin, begin + scratch.size(), &scratch[0]));
+        }
+
+        // A selection that spans blocks is copied behind the decoded characters first
+        size_t size = selection.size();
+        scratch.resize(size * 2);
+        selection.copy(&scratch[size]);
+        return StringRef(scratch.data(), detail::unescape(&scratch[size], &scratch[size] + size, &scratch[0]));
+      }
+
+      /// Computes the line and column of the cursor
+      void location(uint32_t &line, uint32_t &column) const
+      {
+        line = trackLines ? lines + 1 : 0;
+        column = trackLines ? columns : 0;
+        if (currentBlock == nullptr || !trackLines)
+          return;
+
+        const char *begin = currentBlock->data;
+        const char *end = begin + std::min(position, currentBlock->size);
+        const char *lastNewline = scan_newlines(begin, end, line);
+        column = lastNewline != nullptr ? count_columns(lastNewline + 1, end) : columns + count_columns(begin, end);
+      }
+
+      /// Sets the statistics that blocks and characters are counted in
+      void set_stats(JsonParseStats *s)
+      {
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+        stats = s;
+#else
+        (void)s;
+#endif
+      }
+
+      /// Marks the start of a new token at the cursor. All blocks before the cursor are no longer
+      /// referenced and are returned to the pool.
+      void begin_token()
+      {
+        ParseBlock *previousBlock = tokenBlock;
+        while (previousBlock != nullptr && previousBlock != currentBlock)
+        {
+          ParseBlock *next = previousBlock->next;
+          pool.release(previousBlock);
+          previousBlock = next;
+        }
+        tokenBlock = currentBlock;
+      }
+
+      /// Starts a selection at the cursor
+      void select_start(Selection &selection) const
+      {
+        selection.startBlock = currentBlock;
+        selection.start = position;
+      }
+
+      /// Ends a selection at the cursor
+      void select_end(Selection &selection) const
+      {
+        selection.endBlock = currentBlock;
+        selection.end = position;
+      }
+
+    private:
+      /// Accounts for the lines and columns of characters the cursor moved past
+      void count_lines(const char *begin, const char *end)
+      {
+        const char *lastNewline = scan_newlines(begin, end, lines);
+        if (lastNewline != nullptr)
+          columns = count_columns(lastNewline + 1, end);
+        else
+          columns += count_columns(begin, end);
+      }
+
+      /// Takes a new block from the pool and fills it with content from the source. If the source
+      /// is drained it returns 0.
+			ParseBlock* allocate_next_block()
+			{
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+        if (stats != nullptr)
+          ++(pool.has_free() ? stats->blocksReused : stats->blocksAllocated);
+#endif
+
+				ParseBlock *block = pool.acquire();
+				while(block->size < block->capacity)
+				{
+					uint32_t bytesRead = source->Read(block->data + block->size, block->capacity - block->size);
+					if(bytesRead == 0)
+						break;
+					block->size += bytesRead;
+				}
+
+        // Characters past the limit are dropped, the input ends there
+        if (block->size > limit - read)
+        {
+          block->size = static_cast<uint32_t>(limit - read);
+          truncated = true;
+        }
+        read += block->size;
+
+				if (block->size == 0)
+				{
+					pool.release(block);
+					return nullptr;
+				}
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+        if (stats != nullptr)
+          stats->bytes += block->size;
+#endif
+				return block;
+			}
+
+    private:
+      IJsonParserSource *source;
+      BlockPool &pool;
+
+      ParseBlock *tokenBlock;
+
+      ParseBlock *currentBlock;
+      uint32_t position;
+      uint64_t passed;
+      uint64_t read;
+      uint64_t limit;
+
+      uint32_t lines;
+      uint32_t columns;
+      bool trackLines;
+      bool truncated;
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+      JsonParseStats *stats = nullptr;
+#endif
+    };
+
+    /**
+     * @brief Input that reads directly from a contiguous buffer owned by the caller. There is no 
+     *  copying or block bookkeeping; selections are simply ranges in the buffer.
+     */
+    class SpanInput
+    {
+    public:
+      /**
+       * @brief Describes a selection from the source buffer.
+       */
+      struct Selection
+      {
+        Selection() : start(nullptr), end(nullptr) {}
+
+        const char *start, *end;
+
+        /// Returns the number of characters in the selection
+        size_t size() const { return static_cast<size_t>(end - start); }
+
+        /// Copies the characters in the selection to the given buffer which must be at least 
+        /// size() characters large.
+        void copy(char *buffer) const { std::memcpy(buffer, start, size()); }
+
+        /// Exctracts the data from the selection in the form of a string
+        std::string data() const { return std::string(start, end); }
+
+        /// Returns the characters in the selection as a contiguous range
+        StringRef view() const { return StringRef(start, size()); }
+      };
+
+    public:
+      /// Default constructor
+      SpanInput(const char *data, size_t length) : first(data), cursor(data), last(data + length), truncated(false) {}
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+      /// Counts the characters up to the cursor
+      ~SpanInput()
+      {
+        if (stats != nullptr)
+          stats->bytes += static_cast<uint64_t>(cursor - first);
+      }
+#endif
+
+      /// Returns the character under the cursor without moving the cursor. Returns false if the 
+      /// buffer is drained.
+      bool peek(char &c) const
+      {
+        if (cursor == last)
+          return false;
+
+        c = *cursor;
+        return true;
+      }
+
+      /// Returns the contiguous characters from the cursor up to the end of the buffer. Returns
+      /// false if the buffer is drained.
+      bool window(const char *&begin, const char *&end) const
+      {
+        begin = cursor;
+        end = last;
+        return cursor != last;
+      }
+
+      /// Returns the character under the cursor. Only valid after a successful call to peek.
+      char current() const { return *cursor; }
+
+      /// Moves the cursor to the next character.
+      void advance() { ++cursor; }
+
+      /// Moves the cursor by the given number of characters within the current window.
+      void advance(size_t count) { cursor += count; }
+
+      /// Returns true if more characters may follow once the input is drained.
+      bool partial() const { return false; }
+
+      /// Returns the position of the cursor in the buffer
+      const char* position() const { return cursor; }
+
+      /// Moves the cursor to the given position in the buffer
+      void seek(const char *p) { cursor = p; }
+
+      /// Returns the number of characters before the cursor
+      uint64_t offset() const { return static_cast<uint64_t>(cursor - first); }
+
+      /// Lines are only counted when a location is computed, so there is nothing to stop
+      void set_track_lines(bool) {}
+
+      /// Ends the input after the given number of characters, 0 means no limit
+      void set_byte_limit(uint64_t bytes)
+      {
+        if (bytes != 0 && static_cast<uint64_t>(last - first) > bytes)
+        {
+          last = first + bytes;
+          truncated = true;
+        }
+      }
+
+      /// Returns true if the input ended because of the byte limit
+      bool limited() const { return truncated; }
+
+      /// Returns the characters of a selection
+      StringRef view(const Selection &selection) const { return selection.view(); }
+
+      /// Returns the characters of a string selection with its escape sequences decoded into a
+      /// buffer of the input
+      StringRef unescape(const Selection &selection)
+      {
+        scratch.resize(selection.size());
+        return StringRef(scratch.data(), detail::unescape(selection.start, selection.end, &scratch[0]));
+      }
+
+      /// Computes the line and column of the cursor
+      void location(uint32_t &line, uint32_t &column) const
+      {
+        line = 1;
+        const char *lastNewline = scan_newlines(first, cursor, line);
+        column = count_columns(lastNewline != nullptr ? lastNewline + 1 : first, cursor);
+      }
+
+      /// Sets the statistics that the characters up to the cursor are counted in
+      void set_stats(JsonParseStats *s)
+      {
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+        stats = s;
+#else
+        (void)s;
+#endif
+      }
+
+      /// Marks the start of a new token at the cursor.
+      void begin_token() {}
+
+      /// Starts a selection at the cursor
+      void select_start(Selection &selection) const { selection.start = cursor; }
+
+      /// Ends a selection at the cursor
+      void select_end(Selection &selection) const { selection.end = cursor; }
+
+    private:
+      const char *first;
+      const char *cursor;
+      const char *last;
+      bool truncated;
+      std::string scratch;
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+      JsonParseStats *stats = nullptr;
+#endif
+    };
+
+    /**
+     * @brief Input over one fragment of a document that arrives in pieces. When the fragment is
+     *  partial, a token that runs into its end is reported as incomplete instead of ending at it,
+     *  so it can be parsed again from its start once more characters arrived. Locations account
+     *  for the lines and columns of the fragments that came before. Escaped strings are decoded
+     *  into a buffer that outlives the fragment, so its memory is reused by the next one.
+     */
+    class FragmentInput : public SpanInput
+    {
+    public:
+      /// Constructs an input over the fragment. The location of its first character is given by
+      /// the number of preceding lines and the column within the last of them.
+      FragmentInput(const char *data, size_t length, bool partial, uint32_t lines, uint32_t columns, uint64_t offset,
+        std::string &scratch) :
+        SpanInput(data, length), tokenStart_(data), partial_(partial), lines_(lines), columns_(columns), offset_(offset),
+        scratch_(scratch) {}
+
+      /// Returns true if more characters may follow once the input is drained
+      bool partial() const { return partial_; }
+
+      /// Marks the start of a new token at the cursor
+      void begin_token() { tokenStart_ = position(); }
+
+      /// Returns the start of the last token
+      const char* token_start() const { return tokenStart_; }
+
+      /// Returns the number of characters before the cursor in the complete document
+      uint64_t offset() const { return offset_ + SpanInput::offset(); }
+
+      /// Returns the characters of a string selection with its escape sequences decoded into the
+      /// buffer of the fragments
+      StringRef unescape(const Selection &selection)
+      {
+        scratch_.resize(selection.size());
+        return StringRef(scratch_.data(), detail::unescape(selection.start, selection.end, &scratch_[0]));
+      }
+
+      /// Computes the line and column of the cursor in the complete document
+      void location(uint32_t &line, uint32_t &column) const
+      {
+        SpanInput::location(line, column);
+        if (line == 1)
+          column += columns_;
+        line += lines_;
+      }
+
+    private:
+      const char *tokenStart_;
+      bool partial_;
+      uint32_t lines_;
+      uint32_t columns_;
+      uint64_t offset_;
+      std::string &scratch_;
+    };
+
+		//-----------------------------------------------------------------------------------------------
+		enum class TokenType
+		{
+			kIdentifier,
+			kString,
+			kNumber,
+			kCurlyLeft,
+			kCurlyRight,
+			kSeperator,
+			kBraceLeft,
+			kBraceRight,
+			kComma,
+			kComment,
+			kEOF,
+      kTrue,
+      kFalse,
+      kNull,
+      kIncomplete,
+      kError,
+		};
+
+    static_assert(static_cast<size_t>(TokenType::kError) < JsonParseStats::kTokenTypes,
+      "JsonParseStats must have a counter for every token type");
+
+    /// A set of token types as a compile-time bitmask, bit n stands for TokenType n
+    template<TokenType ... T>
+    struct TokenMask;
+
+    template<>
+    struct TokenMask<>
+    {
+      static const uint32_t value = 0;
+    };
+
+    template<TokenType T, TokenType ... Rest>
+    struct TokenMask<T, Rest...>
+    {
+      static const uint32_t value = (1u << static_cast<uint32_t>(T)) | TokenMask<Rest...>::value;
+    };
+
+    inline const char *token_to_string(TokenType t)
+    {
+      switch (t)
+      {
+      case TokenType::kIdentifier:
+        return "identifier";
+      case TokenType::kString:
+        return "string";
+      case TokenType::kNumber:
+        return "number";
+      case TokenType::kCurlyLeft:
+        return "{";
+      case TokenType::kCurlyRight:
+        return "}";
+      case TokenType::kSeperator:
+        return "=";
+      case TokenType::kBraceLeft:
+        return "[";
+      case TokenType::kBraceRight:
+        return "]";
+      case TokenType::kComma:
+        return ",";
+      case TokenType::kComment:
+        return "comment";
+      case TokenType::kTrue:
+        return "true";
+      case TokenType::kFalse:
+        return "false";
+      case TokenType::kNull:
+        return "null";
+      case TokenType::kIncomplete:
+        return "incomplete token";
+      case TokenType::kError:
+        return "error";
+      default:
+      case TokenType::kEOF:
+        return "EOF";
+      }
+    }
+
+		//-----------------------------------------------------------------------------------------------
+		template<typename Input>
+		class ParseContext
+		{
+		public:
+      typedef typename Input::Selection Selection;
+
+      /// Describes a single token from the input
+      struct Token
+      {
+        Token() : type(TokenType::kEOF), escaped(false) {}
+
+        TokenType type;
+        Selection selection;
+
+        /// True for a string that contains escape sequences
+        bool escaped;
+      };
+
+		public:
+      /// Default constructor
+      template<typename ... Args>
+			ParseContext(IJsonParserLog *l, JsonDocumentType t, Args&& ... args) :
+        log(l), input(std::forward<Args>(args)...), documentType(t), depth(0), maxDepth(UINT32_MAX),
+        maxStringLength(UINT32_MAX), failFast(false), failed(false), reported(false) {}
+
+      /// Reports an error at the cursor to the error log. With fail fast only the first error is
+      /// reported, and the current token becomes an error that the grammar does not accept.
+			bool error(JsonParseErrorCode code, TokenType found, uint32_t expected = 0)
+			{
+        if (failed)
+          return false;
+        if (failFast)
+        {
+          currentToken.type = TokenType::kError;
+          failed = true;
+        }
+
+        reported = true;
+				if (log == nullptr)
+					return false;
+
+        JsonParseError e;
+        e.code = code;
+        e.found = static_cast<uint32_t>(found);
+        e.expected = expected;
+        e.offset = input.offset();
+				input.location(e.line, e.column);
+				log->Report(e);
+				return false;
+			}
+
+      /// Returns true if an error was reported
+      bool reported_error() const { return reported; }
+
+      /// Stops at the first error and, for inputs that count lines as they go, stops counting
+      void set_fail_fast(bool f)
+      {
+        failFast = f;
+        input.set_track_lines(!f);
+      }
+
+      /// Applies the limits of the tokenizer
+      void set_limits(const JsonParserLimits &limits)
+      {
+        maxDepth = limits.maxDepth != 0 ? limits.maxDepth : UINT32_MAX;
+        maxStringLength = limits.maxStringLength != 0 ? limits.maxStringLength : UINT32_MAX;
+        input.set_byte_limit(limits.maxBytes);
+      }
+
+      /// Reports an error that always stops the parse, like an exceeded limit or a string that is
+      /// not valid. The current token becomes an error and nothing is reported after it.
+      bool fatal_error(JsonParseErrorCode code, TokenType found)
+      {
+        error(code, found);
+        failed = true;
+        currentToken.type = TokenType::kError;
+        return false;
+      }
+
+      /// Called when an object or array opens. Fails if that exceeds the maximum depth.
+      bool enter()
+      {
+        if (++depth > maxDepth)
+          return fatal_error(JsonParseErrorCode::kDepthLimit, currentToken.type);
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+        if (stats != nullptr)
+          stats->maxDepth = std::max(stats->maxDepth, depth);
+#endif
+        return true;
+      }
+
+      /// Called when an object or array closes
+      void leave() { --depth; }
+
+      /// Called to advance to the next token. Returns false if there are no more tokens left.
+      bool next()
+      {
+        return documentType == JsonDocumentType::kNormal ? next<JsonDocumentType::kNormal>() :
+          next<JsonDocumentType::kSimplified>();
+      }
+
+      /// Advances to the next token with the rules of the given dialect instead of the document
+      /// type of the context.
+      template<JsonDocumentType Dialect>
+      bool next()
+      {
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+        if (stats != nullptr)
+          return next_counted<Dialect>();
+#endif
+        return next_token<Dialect>();
+      }
+
+      /// Sets the statistics that tokens and input are counted in. Does nothing unless the
+      /// library is built with KNOWSON_ENABLE_PARSE_STATS.
+      void set_stats(JsonParseStats *s)
+      {
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+        stats = s;
+#endif
+        input.set_stats(s);
+      }
+
+      /// Returns the current token
+			const Token& token() const
+			{
+				return currentToken;
+			}
+
+      /// Returns the text of the current token. The text is valid until the next token is read.
+      /// Escape sequences of strings are decoded, strings without them are not copied.
+      StringRef text()
+      {
+        if (currentToken.escaped)
+          return input.unescape(currentToken.selection);
+        return input.view(currentToken.selection);
+      }
+
+      /// Returns the input the tokens are read from
+      const Input& source() const
+      {
+        return input;
+      }
+      Input& source()
+      {
+        return input;
+      }
+
+      /// Returns the document type
+      JsonDocumentType document_type() const
+      {
+        return documentType;
+      }
+
+      /// Set the document type
+      void set_document_type(JsonDocumentType t)
+      {
+        documentType = t;
+      }
+
+		private:
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+      /// Reads the next token and counts it and the time it took
+      template<JsonDocumentType Dialect>
+      bool next_counted()
+      {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool result = next_token<Dialect>();
+        stats->tokenizeNanoseconds += static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+        ++stats->tokens[static_cast<size_t>(currentToken.type)];
+        return result;
+      }
+#endif
+
+      /// Reads the next token, skipping comments
+      template<JsonDocumentType Dialect>
+			bool next_token()
+			{
+        do
+        {
+          char c;
+          bool result = skip_whitespace(c);
+
+          input.begin_token();
+          if (!result)
+          {
+            if (input.limited())
+              return fatal_error(JsonParseErrorCode::kSizeLimit, TokenType::kEOF);
+            currentToken.type = input.partial() ? TokenType::kIncomplete : TokenType::kEOF;
+            return false;
+          }
+
+          input.select_start(currentToken.selection);
+          currentToken.escaped = false;
+
+          if (c == '{')
+          {
+            currentToken.type = TokenType::kCurlyLeft;
+            swallow_char();
+          }
+          else if (c == '}')
+          {
+            currentToken.type = TokenType::kCurlyRight;
+            swallow_char();
+          }
+          else if (c == '[')
+          {
+            currentToken.type = TokenType::kBraceLeft;
+            swallow_char();
+          }
+          else if (c == ']')
+          {
+            currentToken.type = TokenType::kBraceRight;
+            swallow_char();
+          }
+          else if (is_seperator<Dialect>(c))
+          {
+            currentToken.type = TokenType::kSeperator;
+            swallow_char();
+          }
+          else if (c == ',')
+          {
+            currentToken.type = TokenType::kComma;
+            swallow_char();
+          }
+          else if (c == '-')
+          {
+            swallow_char();
+
+            char a;
+            if (!next_char(a, false))
+            {
+              currentToken.type = TokenType::kEOF;
+              return unexpected_eof();
+            }
+
+            if (a == '-')
+            {
+              currentToken.type = TokenType::kComment;
+              select_line();
+            }
+            else
+              select_number<Dialect>(false);
+          }
+          else if (c == '+')
+          {
+            swallow_char();
+            select_number<Dialect>(false);
+          }
+          else if (is_digit(c))
+          {
+            select_number<Dialect>(false);
+          }
+          else if (c == '/')
+          {
+            swallow_char();
+
+            char a;
+            if (!next_char(a, false))
+            {
+              currentToken.type = TokenType::kEOF;
+              return unexpected_eof();
+            }
+
+            if (a == '/')
+            {
+              currentToken.type = TokenType::kComment;
+              swallow_char();
+              select_line();
+            }
+            else
+            {
+              select_identifier<Dialect>();
+            }
+          }
+          else if (c == '\"')
+            select_string();
+          else
+            select_identifier<Dialect>();
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+          // Comments are skipped here, so they are counted here too
+          if (stats != nullptr && currentToken.type == TokenType::kComment)
+            ++stats->tokens[static_cast<size_t>(TokenType::kComment)];
+#endif
+        } while (currentToken.type == TokenType::kComment);
+
+        return true;
+			}
+
+      /// Returns true if the given character is considered a seperator in the given dialect. Only
+      /// normal json does not accept '='.
+      template<JsonDocumentType Dialect>
+      static bool is_seperator(char c)
+      {
+        return c == ':' || (c == '=' && Dialect != JsonDocumentType::kNormal);
+      }
+
+      /// Moves the cursor past any whitespace and returns the first character that follows it. 
+      /// Returns false if there is no such character.
+      bool skip_whitespace(char &c)
+      {
+        const char *begin, *end;
+        while (input.window(begin, end))
+        {
+          const char *p = detail::skip_whitespace(begin, end);
+          input.advance(p - begin);
+          if (p != end)
+          {
+            c = *p;
+            return true;
+          }
+        }
+        return false;
+      }
+
+      /// Moves the cursor up to the first character for which the scanner returns a match. Returns
+      /// false if the source was drained before a match was found.
+      template<typename Scanner>
+      bool scan_until(Scanner scanner)
+      {
+        const char *begin, *end;
+        while (input.window(begin, end))
+        {
+          const char *p = scanner(begin, end);
+          input.advance(p - begin);
+          if (p != end)
+            return true;
+        }
+        return false;
+      }
+
+      /// Called to get the current character from the source, optionally moving to the next character.
+			bool next_char(char &c, bool moveCursor = true)
+			{
+				if (!input.peek(c))
+					return false;
+
+        if (moveCursor) swallow_char();
+				return true;
+			}
+
+      /// Moves the cursor until either no more content is left or a newline is hit.
+			void select_line()
+			{
+				if (scan_until(find_newline))
+				  swallow_char();
+				else if (input.partial())
+				  currentToken.type = TokenType::kIncomplete;
+				input.select_end(currentToken.selection);
+			}
+
+      /// Moves the cursor to include the entirty of a number. However if an unexpected character
+      /// is found the token is turned into an identifier.
+      template<JsonDocumentType Dialect>
+			void select_number(bool hadDecimal)
+			{
+				currentToken.type = TokenType::kNumber;
+
+				bool hadE = false;
+				bool hadSign = true;
+				char c;
+				while(next_char(c, false))
+				{
+          if (is_digit(c))
+          {
+            swallow_char();
+            continue;
+          }
+					else if(c == '.' && !hadDecimal)
+					{
+            swallow_char();
+						hadDecimal = true;
+						continue;
+					}
+					else if((c == '-' || c == '+') && !hadSign)
+					{
+            swallow_char();
+						hadSign = true;
+						continue;
+					}
+					else if((c == 'E' || c == 'e') && !hadE)
+					{
+            swallow_char();
+						hadSign = false;
+						hadE = true;
+						hadDecimal = true;
+						continue;
+					}
+          else if (is_delimiter(c, Dialect != JsonDocumentType::kNormal))
+          {
+            break;
+          }
+
+					select_identifier<Dialect>();
+					return;
+				}
+
+        // The number may continue in the next fragment
+        if (input.partial() && !input.peek(c))
+          currentToken.type = TokenType::kIncomplete;
+				input.select_end(currentToken.selection);
+			}
+
+      /// Selects the entirty of an identifier
+      template<JsonDocumentType Dialect>
+			bool select_identifier()
+			{
+				currentToken.type = TokenType::kIdentifier;
+
+        bool delimited = scan_until([](const char *begin, const char *end) {
+          return find_delimiter(begin, end, Dialect != JsonDocumentType::kNormal);
+        });
+
+        input.select_end(currentToken.selection);
+
+        // The identifier may continue in the next fragment
+        if (!delimited && input.partial())
+        {
+          currentToken.type = TokenType::kIncomplete;
+          return false;
+        }
+
+        if (!check_length())
+          return false;
+
+        // Identifiers are short, so checking for keywords afterwards is cheap even if the 
+        // identifier spans multiple blocks.
+        StringRef identifier = text();
+        if (identifier.size() == 4 && std::memcmp(identifier.data(), "true", 4) == 0) 
+          currentToken.type = TokenType::kTrue;
+        else if (identifier.size() == 5 && std::memcmp(identifier.data(), "false", 5) == 0) 
+          currentToken.type = TokenType::kFalse;
+        else if (identifier.size() == 4 && std::memcmp(identifier.data(), "null", 4) == 0) 
+          currentToken.type = TokenType::kNull;
+
+        return true;
+			}
+
+      /// Fails if the current token is longer than the maximum string length
+      bool check_length()
+      {
+        if (maxStringLength != UINT32_MAX && currentToken.selection.size() > maxStringLength)
+          return fatal_error(JsonParseErrorCode::kStringLimit, currentToken.type);
+        return true;
+      }
+
+      /// Called when an unexpected end-of-file was encountered. At the end of a partial input the
+      /// token is incomplete instead.
+			bool unexpected_eof()
+			{
+        if (input.limited())
+          return fatal_error(JsonParseErrorCode::kSizeLimit, TokenType::kEOF);
+        if (input.partial())
+        {
+          currentToken.type = TokenType::kIncomplete;
+          return false;
+        }
+				return error(JsonParseErrorCode::kUnexpectedEOF, TokenType::kEOF);
+			}
+
+      /// Called to select the contents of a string for the current token. The string is scanned
+      /// once for its closing quote while its escape sequences and UTF-8 are checked.
+      bool select_string()
+      {
+        currentToken.type = TokenType::kString;
+        swallow_char();
+
+        // Skip the " in the selection
+        input.select_start(currentToken.selection);
+        for (;;)
+        {
+          const char *begin, *end;
+          if (!input.window(begin, end))
+            return string_eof();
+
+          // Most strings are plain, their closing quote is the first character to look at
+          const char *p = find_string_special(begin, end);
+          if (p != end && *p != '\"')
+            p = scan_string(p, end, currentToken.escaped);
+          input.advance(static_cast<size_t>(p - begin));
+          if (p == end)
+            continue;
+          if (*p == '\"')
+            break;
+
+          // A sequence that is split between blocks or not valid is checked one character at a
+          // time
+          if (!(*p == '\\' ? select_escape() : select_utf8()))
+            return false;
+        }
+
+        input.select_end(currentToken.selection);
+
+        // Skip the closing "
+        swallow_char();
+        return check_length();
+      }
+
+      /// Moves the cursor past an escape sequence in a string
+      bool select_escape()
+      {
+        currentToken.escaped = true;
+        swallow_char();
+
+        char c;
+        if (!next_char(c, false))
+          return string_eof();
+        if (!is_escape(c))
+          return fatal_error(JsonParseErrorCode::kInvalidEscape, TokenType::kString);
+        swallow_char();
+
+        if (c == 'u')
+        {
+          for (int i = 0; i < 4; ++i)
+          {
+            if (!next_char(c, false))
+              return string_eof();
+            if (!is_hex_digit(c))
+              return fatal_error(JsonParseErrorCode::kInvalidEscape, TokenType::kString);
+            swallow_char();
+          }
+        }
+        return true;
+      }
+
+      /// Moves the cursor past a UTF-8 sequence in a string
+      bool select_utf8()
+      {
+        unsigned char low, high;
+        size_t length = utf8_sequence(static_cast<unsigned char>(input.current()), low, high);
+        if (length == 0)
+          return fatal_error(JsonParseErrorCode::kInvalidUtf8, TokenType::kString);
+        swallow_char();
+
+        for (size_t i = 1; i < length; ++i)
+        {
+          char c;
+          if (!next_char(c, false))
+            return string_eof();
+          unsigned char u = static_cast<unsigned char>(c);
+          if (u < low || u > high)
+            return fatal_error(JsonParseErrorCode::kInvalidUtf8, TokenType::kString);
+          swallow_char();
+          low = 0x80;
+          high = 0xbf;
+        }
+        return true;
+      }
+
+      /// Called when the input ends within a string. An escape sequence may be cut off, so the
+      /// text is not decoded.
+      bool string_eof()
+      {
+        currentToken.escaped = false;
+        input.select_end(currentToken.selection);
+        return unexpected_eof();
+      }
+
+      /// Called to move the cursor by one character. Line numbers and columns are only computed
+      /// when an error is reported.
+      void swallow_char()
+      {
+        input.advance();
+      }
+
+    private:
+			IJsonParserLog *log;
+      Input input;
+      JsonDocumentType documentType;
+
+			Token currentToken;
+      uint32_t depth;
+      uint32_t maxDepth;
+      uint32_t maxStringLength;
+      bool failFast;
+      bool failed;
+      bool reported;
+
+#if defined(KNOWSON_ENABLE_PARSE_STATS)
+      JsonParseStats *stats = nullptr;
+#endif
+		};
+
+    /**
+     * @brief View of a parse context that reads tokens for a single dialect. The grammar is
+     *  instantiated once per dialect through this view, so checks of the document type are
+     *  resolved at compile time instead of for every token.
+     */
+    template<typename Context, JsonDocumentType Dialect>
+    class DialectContext
+    {
+    public:
+      typedef typename Context::Token Token;
+
+      /// Default constructor
+      explicit DialectContext(Context &context) : context_(context) {}
+
+      /// Returns the dialect of the view
+      static JsonDocumentType document_type() { return Dialect; }
+
+      /// Advances to the next token
+      bool next() { return context_.template next<Dialect>(); }
+
+      /// Forwarded to the parse context
+      const Token& token() const { return context_.token(); }
+      StringRef text() { return context_.text(); }
+      bool error(JsonParseErrorCode code, TokenType found, uint32_t expected = 0) { return context_.error(code, found, expected); }
+      bool enter() { return context_.enter(); }
+      void leave() { context_.leave(); }
+
+    private:
+      Context &context_;
+    };
+	}
+}
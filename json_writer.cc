@@ -0,0 +1,744 @@
+#include "json_writer.h"
+#include "json_scan.h"
+
+#include <cmath>
+
+namespace knowson {
+
+  namespace detail {
+
+    namespace
+    {
+      /// Size of the blocks that are passed to a sink
+      const size_t kSinkBlockSize = 64 * 1024;
+
+      /// Two digit pairs for every number below 100
+      const char kDigitPairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+      //-----------------------------------------------------------------------------------------------
+      /// Writes the decimal digits of value, right aligned so that the last digit is just before
+      /// end. Returns a pointer to the first digit.
+      char* format_digits(uint64_t value, char *end)
+      {
+        while (value >= 100)
+        {
+          const char *pair = kDigitPairs + (value % 100) * 2;
+          value /= 100;
+          *--end = pair[1];
+          *--end = pair[0];
+        }
+        if (value >= 10)
+        {
+          const char *pair = kDigitPairs + value * 2;
+          *--end = pair[1];
+          *--end = pair[0];
+        }
+        else
+          *--end = static_cast<char>('0' + value);
+        return end;
+      }
+
+      /**
+       * @brief A floating point number with a 64 bit significand and a binary exponent, the
+       *  "do it yourself" floating point of the Grisu algorithm.
+       */
+      struct DiyFp
+      {
+        DiyFp(uint64_t f, int32_t e) : f(f), e(e) {}
+
+        /// Decomposes a positive finite double
+        explicit DiyFp(double value)
+        {
+          uint64_t bits;
+          std::memcpy(&bits, &value, sizeof(bits));
+          uint64_t significand = bits & kSignificandMask;
+          int32_t biasedExponent = static_cast<int32_t>(bits >> 52);
+          if (biasedExponent != 0)
+          {
+            f = significand + kHiddenBit;
+            e = biasedExponent - 1075;
+          }
+          else
+          {
+            f = significand;
+            e = -1074;
+          }
+        }
+
+        /// Returns the difference of two numbers with the same exponent
+        DiyFp operator-(const DiyFp &other) const { return DiyFp(f - other.f, e); }
+
+        /// Returns the product rounded to 64 bits
+        DiyFp operator*(const DiyFp &other) const
+        {
+          const uint64_t mask = 0xffffffffu;
+          uint64_t a = f >> 32, b = f & mask, c = other.f >> 32, d = other.f & mask;
+          uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+          uint64_t middle = (bd >> 32) + (ad & mask) + (bc & mask) + (uint64_t(1) << 31);
+          return DiyFp(ac + (ad >> 32) + (bc >> 32) + (middle >> 32), e + other.e + 64);
+        }
+
+        /// Shifts the significand until its highest bit is set
+        DiyFp normalize() const
+        {
+          uint32_t shift = 63 - (f >> 32 != 0 ? 32 + leading_bit(static_cast<uint32_t>(f >> 32)) :
+            leading_bit(static_cast<uint32_t>(f)));
+          return DiyFp(f << shift, e - static_cast<int32_t>(shift));
+        }
+
+        /// Computes the normalized boundaries halfway to the neighbouring doubles
+        void boundaries(DiyFp &minus, DiyFp &plus) const
+        {
+          plus = DiyFp((f << 1) + 1, e - 1).normalize();
+          minus = f == kHiddenBit ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+          minus.f <<= minus.e - plus.e;
+          minus.e = plus.e;
+        }
+
+        static const uint64_t kSignificandMask = 0x000fffffffffffffull;
+        static const uint64_t kHiddenBit = 0x0010000000000000ull;
+
+        uint64_t f;
+        int32_t e;
+      };
+
+      //-----------------------------------------------------------------------------------------------
+      /// Returns the cached power of ten that brings a number with the given binary exponent into
+      /// the range the digit generation works with, and its decimal exponent
+      DiyFp cached_power(int32_t e, int32_t &decimalExponent)
+      {
+        // 10^k for k = -348, -340, ..., 340
+        static const uint64_t significands[] = {
+        0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull, 0xcf42894a5dce35eaull,
+        0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull, 0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full,
+        0xbe5691ef416bd60cull, 0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+        0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull, 0xc21094364dfb5637ull,
+        0x9096ea6f3848984full, 0xd77485cb25823ac7ull, 0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull,
+        0xb23867fb2a35b28eull, 0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+        0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull, 0xb5b5ada8aaff80b8ull,
+        0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull, 0x964e858c91ba2655ull, 0xdff9772470297ebdull,
+        0xa6dfbd9fb8e5b88full, 0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+        0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull, 0xaa242499697392d3ull,
+        0xfd87b5f28300ca0eull, 0xbce5086492111aebull, 0x8cbccc096f5088ccull, 0xd1b71758e219652cull,
+        0x9c40000000000000ull, 0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+        0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull, 0x9f4f2726179a2245ull,
+        0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull, 0x83c7088e1aab65dbull, 0xc45d1df942711d9aull,
+        0x924d692ca61be758ull, 0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+        0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull, 0x952ab45cfa97a0b3ull,
+        0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull, 0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull,
+        0x88fcf317f22241e2ull, 0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+        0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull, 0x8bab8eefb6409c1aull,
+        0xd01fef10a657842cull, 0x9b10a4e5e9913129ull, 0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull,
+        0x80444b5e7aa7cf85ull, 0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+        0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull
+        };
+        static const int16_t exponents[] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+        -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+        -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+        -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+        56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+        375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+        694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+        1013, 1039, 1066
+        };
+
+        double estimate = (-61 - e) * 0.30102999566398114 + 347;
+        int32_t k = static_cast<int32_t>(estimate);
+        if (estimate - k > 0.0)
+          ++k;
+
+        size_t index = static_cast<size_t>((k >> 3) + 1);
+        decimalExponent = -(-348 + static_cast<int32_t>(index) * 8);
+        return DiyFp(significands[index], exponents[index]);
+      }
+
+      /// Powers of ten that fit in 64 bits
+      const uint64_t kPowersOfTen[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+        1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+        100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+        1000000000000000000ull, 10000000000000000000ull
+      };
+
+      //-----------------------------------------------------------------------------------------------
+      /// Moves the last digit towards the exact value while the result stays within the boundaries
+      void grisu_round(uint64_t &digits, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance)
+      {
+        while (rest < distance && delta - rest >= tenKappa &&
+          (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
+        {
+          --digits;
+          rest += tenKappa;
+        }
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Computes the digits of a positive finite double with the Grisu2 algorithm as described in
+      /// "Printing Floating-Point Numbers Quickly and Accurately with Integers" by Florian Loitsch.
+      /// The digits always read back as the same double and are the shortest such digits for all
+      /// but a tiny fraction of numbers. value == mantissa * 10^exponent.
+      void grisu2(double value, uint64_t &mantissa, int32_t &exponent)
+      {
+        DiyFp v(value);
+        DiyFp minus(0, 0), plus(0, 0);
+        v.boundaries(minus, plus);
+
+        int32_t k;
+        DiyFp power = cached_power(plus.e, k);
+        DiyFp w = v.normalize() * power;
+        DiyFp high = plus * power;
+        DiyFp low = minus * power;
+        ++low.f;
+        --high.f;
+
+        // Generate digits of the upper boundary until the result lies within the boundaries
+        uint64_t delta = high.f - low.f;
+        DiyFp one(uint64_t(1) << -high.e, high.e);
+        uint64_t distance = (high - w).f;
+        uint32_t integral = static_cast<uint32_t>(high.f >> -one.e);
+        uint64_t fraction = high.f & (one.f - 1);
+
+        uint64_t digits = 0;
+        int32_t kappa = 1;
+        while (kappa < 10 && integral >= kPowersOfTen[kappa])
+          ++kappa;
+
+        while (kappa > 0)
+        {
+          uint32_t divisor = static_cast<uint32_t>(kPowersOfTen[--kappa]);
+          digits = digits * 10 + integral / divisor;
+          integral %= divisor;
+
+          uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fraction;
+          if (rest <= delta)
+          {
+            grisu_round(digits, delta, rest, kPowersOfTen[kappa] << -one.e, distance);
+            mantissa = digits;
+            exponent = k + kappa;
+            return;
+          }
+        }
+
+        for (;;)
+        {
+          fraction *= 10;
+          delta *= 10;
+          digits = digits * 10 + (fraction >> -one.e);
+          fraction &= one.f - 1;
+          --kappa;
+          if (fraction < delta)
+          {
+            int32_t index = -kappa;
+            grisu_round(digits, delta, fraction, one.f, index < 20 ? distance * kPowersOfTen[index] : 0);
+            mantissa = digits;
+            exponent = k + kappa;
+            return;
+          }
+        }
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Returns true if mantissa * 10^exponent is known to read back as the given double. This
+      /// is only decided for a mantissa of at most 53 bits and a power of ten of at most 22: a
+      /// single multiplication or division of exact operands is correctly rounded.
+      bool reads_back(uint64_t mantissa, int32_t exponent, double value)
+      {
+        static const double powersOfTen[] = {
+          1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        if (mantissa == 0 || mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+          return false;
+
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+        return result == value;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Writes mantissa * 10^exponent in fixed notation for moderate magnitudes and in scientific
+      /// notation otherwise. Fixed notation always has a fractional part so the number reads back
+      /// as a double. Returns the number of characters written.
+      size_t format_decimal(uint64_t mantissa, int32_t exponent, char *buffer)
+      {
+        while (mantissa != 0 && mantissa % 10 == 0)
+        {
+          mantissa /= 10;
+          ++exponent;
+        }
+
+        char digits[24];
+        char *end = digits + sizeof(digits);
+        char *first = format_digits(mantissa, end);
+        int32_t count = static_cast<int32_t>(end - first);
+        int32_t scientific = count - 1 + exponent;
+
+        size_t length = 0;
+        if (scientific < -7 || scientific >= 21)
+        {
+          buffer[length++] = *first;
+          if (count > 1)
+          {
+            buffer[length++] = '.';
+            std::memcpy(buffer + length, first + 1, static_cast<size_t>(count - 1));
+            length += static_cast<size_t>(count - 1);
+          }
+          buffer[length++] = 'e';
+          buffer[length++] = scientific < 0 ? '-' : '+';
+          char exponentDigits[4];
+          char *exponentEnd = exponentDigits + sizeof(exponentDigits);
+          const char *exponentFirst = format_digits(static_cast<uint64_t>(scientific < 0 ? -scientific : scientific), exponentEnd);
+          std::memcpy(buffer + length, exponentFirst, static_cast<size_t>(exponentEnd - exponentFirst));
+          return length + static_cast<size_t>(exponentEnd - exponentFirst);
+        }
+
+        if (exponent >= 0)
+        {
+          // Integral, the zeros of the exponent follow the digits
+          std::memcpy(buffer, first, static_cast<size_t>(count));
+          length = static_cast<size_t>(count);
+          std::memset(buffer + length, '0', static_cast<size_t>(exponent));
+          length += static_cast<size_t>(exponent);
+          buffer[length++] = '.';
+          buffer[length++] = '0';
+          return length;
+        }
+
+        // Pad with zeros so there is at least one digit before the point
+        size_t fraction = static_cast<size_t>(-exponent);
+        while (static_cast<size_t>(end - first) <= fraction)
+          *--first = '0';
+
+        size_t integral = static_cast<size_t>(end - first) - fraction;
+        std::memcpy(buffer, first, integral);
+        length = integral;
+        buffer[length++] = '.';
+        std::memcpy(buffer + length, first + integral, fraction);
+        return length + fraction;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Returns true if a key can be written without quotes in the simplified dialect
+      bool is_plain_key(StringRef key)
+      {
+        if (key.empty())
+          return false;
+
+        for (size_t i = 0; i < key.size(); ++i)
+        {
+          char c = key[i];
+          bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+          if (!letter && (i == 0 || !is_digit(c)))
+            return false;
+        }
+
+        // Keywords are not identifiers
+        return key.compare("true") != 0 && key.compare("false") != 0 && key.compare("null") != 0;
+      }
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    size_t format_integer(int64_t value, char *buffer)
+    {
+      char digits[20];
+      uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+      const char *first = format_digits(magnitude, digits + sizeof(digits));
+
+      size_t length = 0;
+      if (value < 0)
+        buffer[length++] = '-';
+      size_t count = static_cast<size_t>(digits + sizeof(digits) - first);
+      std::memcpy(buffer + length, first, count);
+      return length + count;
+    }
+
+    //-----------------------------------------------------------------------------------------------
+    size_t format_double(double value, char *buffer)
+    {
+      size_t length = 0;
+      if (std::signbit(value))
+      {
+        buffer[length++] = '-';
+        value = -value;
+      }
+
+      if (value == 0.0)
+        return length + format_decimal(0, 0, buffer + length);
+
+      uint64_t mantissa;
+      int32_t exponent;
+      grisu2(value, mantissa, exponent);
+
+      // Grisu2 occasionally keeps a digit too many, visible as a run of zeros or nines before the
+      // last digit. Drop the last digit and keep the shorter decimal if it still reads back.
+      uint64_t shorter = (mantissa + 5) / 10;
+      int32_t shorterExponent = exponent + 1;
+      while (shorter != 0 && shorter % 10 == 0)
+      {
+        shorter /= 10;
+        ++shorterExponent;
+      }
+      if (reads_back(shorter, shorterExponent, value))
+        return length + format_decimal(shorter, shorterExponent, buffer + length);
+
+      return length + format_decimal(mantissa, exponent, buffer + length);
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonWriter::JsonWriter(const JsonWriterOptions &options) :
+    sink_(nullptr),
+    options_(options),
+    size_(0),
+    keyPending_(false),
+    complete_(false)
+  {
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonWriter::JsonWriter(IJsonWriterSink *sink, const JsonWriterOptions &options) :
+    sink_(sink),
+    options_(options),
+    buffer_(detail::kSinkBlockSize),
+    size_(0),
+    keyPending_(false),
+    complete_(false)
+  {
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::Null()
+  {
+    if (!begin_value(JsonType::kNull))
+      return false;
+    put("null", 4);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::Boolean(bool value)
+  {
+    if (!begin_value(JsonType::kBoolean))
+      return false;
+    if (value)
+      put("true", 4);
+    else
+      put("false", 5);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::Number(double value)
+  {
+    // Json has no representation for infinity and NaN
+    if (!std::isfinite(value) || !begin_value(JsonType::kNumber))
+      return false;
+
+    char *p = reserve(32);
+    size_ += detail::format_double(value, p);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::Integer(int64_t value)
+  {
+    if (!begin_value(JsonType::kNumber))
+      return false;
+
+    char *p = reserve(20);
+    size_ += detail::format_integer(value, p);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::String(StringRef value)
+  {
+    if (!begin_value(JsonType::kString))
+      return false;
+    write_string(value);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::StartObject()
+  {
+    // The root of a simplified document is an object without braces
+    bool root = stack_.empty();
+    if (!begin_value(JsonType::kObject))
+      return false;
+
+    Frame frame = { true, !(root && options_.documentType == JsonDocumentType::kSimplified), 0 };
+    if (frame.braces)
+      put('{');
+    stack_.push_back(frame);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::Key(StringRef key)
+  {
+    if (stack_.empty() || !stack_.back().object || keyPending_)
+      return false;
+
+    Frame &frame = stack_.back();
+    begin_item(frame);
+    ++frame.count;
+
+    if (options_.documentType == JsonDocumentType::kSimplified)
+    {
+      if (detail::is_plain_key(key))
+        put(key.data(), key.size());
+      else
+        write_string(key);
+
+      if (options_.pretty)
+        put(" = ", 3);
+      else
+        put('=');
+    }
+    else
+    {
+      write_string(key);
+      if (options_.pretty)
+        put(": ", 2);
+      else
+        put(':');
+    }
+
+    keyPending_ = true;
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::EndObject()
+  {
+    return end_container(true);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::StartArray()
+  {
+    if (!begin_value(JsonType::kArray))
+      return false;
+
+    Frame frame = { false, true, 0 };
+    put('[');
+    stack_.push_back(frame);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::EndArray()
+  {
+    return end_container(false);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::Value(const JsonValue &value)
+  {
+    switch (value.type())
+    {
+    case JsonType::kObject:
+      if (!StartObject())
+        return false;
+      for (const JsonObject::Member &member : value.as<JsonObject>())
+        if (!Key(member.first) || !Value(*member.second))
+          return false;
+      return EndObject();
+    case JsonType::kArray:
+      if (!StartArray())
+        return false;
+      for (const JsonValue *element : value.as<JsonArray>())
+        if (!Value(*element))
+          return false;
+      return EndArray();
+    case JsonType::kBoolean:
+      return Boolean(value.as<JsonBoolean>().value());
+    case JsonType::kNumber:
+    {
+      const JsonNumber &number = value.as<JsonNumber>();
+      return number.is_integer() ? Integer(number.integer_value()) : Number(number.value());
+    }
+    case JsonType::kString:
+      return String(value.as<JsonString>().value());
+    default:
+      return Null();
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonWriter::flush()
+  {
+    if (sink_ != nullptr && size_ > 0)
+    {
+      sink_->Write(buffer_.data(), size_);
+      size_ = 0;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonWriter::reset()
+  {
+    size_ = 0;
+    stack_.clear();
+    keyPending_ = false;
+    complete_ = false;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::begin_value(JsonType type)
+  {
+    if (stack_.empty())
+    {
+      // A document has a single root, simplified documents can only have an object as root
+      if (complete_ || (options_.documentType == JsonDocumentType::kSimplified && type != JsonType::kObject))
+        return false;
+
+      // Containers complete when they are closed
+      complete_ = type != JsonType::kObject && type != JsonType::kArray;
+      return true;
+    }
+
+    Frame &frame = stack_.back();
+    if (frame.object)
+    {
+      // Members are introduced by their key
+      if (!keyPending_)
+        return false;
+      keyPending_ = false;
+      return true;
+    }
+
+    begin_item(frame);
+    ++frame.count;
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonWriter::begin_item(Frame &frame)
+  {
+    bool simplified = options_.documentType == JsonDocumentType::kSimplified;
+    if (frame.count > 0 && !simplified)
+      put(',');
+
+    // Members of a braceless root need no break before the first
+    if (options_.pretty)
+    {
+      if (frame.braces || frame.count > 0)
+        write_newline(level());
+    }
+    else if (frame.count > 0 && simplified)
+      put(' ');
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonWriter::end_container(bool object)
+  {
+    if (stack_.empty() || stack_.back().object != object || keyPending_)
+      return false;
+
+    Frame frame = stack_.back();
+    stack_.pop_back();
+    if (frame.braces)
+    {
+      if (options_.pretty && frame.count > 0)
+        write_newline(level());
+      put(object ? '}' : ']');
+    }
+
+    complete_ = stack_.empty();
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonWriter::write_string(StringRef value)
+  {
+    static const char hex[] = "0123456789abcdef";
+
+    put('"');
+    const char *p = value.begin();
+    const char *end = value.end();
+    while (p != end)
+    {
+      // Copy the run of characters that need no escaping in one go
+      const char *escape = detail::find_escaped(p, end);
+      put(p, static_cast<size_t>(escape - p));
+      if (escape == end)
+        break;
+
+      char c = *escape;
+      char *out = reserve(6);
+      out[0] = '\\';
+      switch (c)
+      {
+      case '"': out[1] = '"'; size_ += 2; break;
+      case '\\': out[1] = '\\'; size_ += 2; break;
+      case '\n': out[1] = 'n'; size_ += 2; break;
+      case '\r': out[1] = 'r'; size_ += 2; break;
+      case '\t': out[1] = 't'; size_ += 2; break;
+      case '\b': out[1] = 'b'; size_ += 2; break;
+      case '\f': out[1] = 'f'; size_ += 2; break;
+      default:
+        out[1] = 'u';
+        out[2] = '0';
+        out[3] = '0';
+        out[4] = hex[(static_cast<unsigned char>(c) >> 4) & 0xf];
+        out[5] = hex[static_cast<unsigned char>(c) & 0xf];
+        size_ += 6;
+        break;
+      }
+      p = escape + 1;
+    }
+    put('"');
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonWriter::write_newline(size_t level)
+  {
+    size_t count = level * options_.indent;
+    char *p = reserve(count + 1);
+    *p = '\n';
+    std::memset(p + 1, ' ', count);
+    size_ += count + 1;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonWriter::grow(size_t count)
+  {
+    if (sink_ != nullptr)
+    {
+      flush();
+      if (buffer_.size() >= count)
+        return;
+    }
+
+    size_t capacity = buffer_.size() < 256 ? 256 : buffer_.size();
+    while (capacity - size_ < count)
+      capacity *= 2;
+    buffer_.resize(capacity);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool write_json(const JsonValue &value, std::string &output, const JsonWriterOptions &options)
+  {
+    JsonWriter writer(options);
+    if (!writer.Value(value))
+      return false;
+
+    StringRef text = writer.text();
+    output.assign(text.data(), text.size());
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool write_json(const JsonValue &value, IJsonWriterSink *sink, const JsonWriterOptions &options)
+  {
+    JsonWriter writer(sink, options);
+    return writer.Value(value);
+  }
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace knowson {
+
+  struct IJsonWriterSink
+  {
+  public:
+    /// Receives the next range of output
+    virtual void Write(const char *data, size_t length) = 0;
+  };
+
+  template<typename S>
+  struct StreamJsonWriterSink : public IJsonWriterSink
+  {
+  public:
+    StreamJsonWriterSink(S &stream) : stream_(stream) {}
+
+    /// Writes the characters to the stream
+    void Write(const char *data, size_t length) override
+    {
+      stream_.write(data, static_cast<std::streamsize>(length));
+    }
+
+  private:
+    S& stream_;
+  };
+
+  /**
+   * @brief Options that control how documents are written
+   */
+  struct JsonWriterOptions
+  {
+  public:
+    /// Default constructor
+    JsonWriterOptions() : documentType(JsonDocumentType::kNormal), pretty(false), indent(2) {}
+
+    /// The dialect to write. The root of a simplified document must be an object, its members
+    /// are written without braces. kUnknown writes normal json.
+    JsonDocumentType documentType;
+
+    /// Set to true to put every member and element on its own line
+    bool pretty;
+
+    /// Number of spaces per level of nesting when writing pretty output
+    uint32_t indent;
+  };
+
+  /**
+   * @brief Writes json text from a stream of events. The writer has the same methods as a json
+   *  handler, so it can be passed to parse_json_events directly to reformat a document without
+   *  building a tree. Output is collected in a growable buffer, or when a sink is given, passed to
+   *  the sink in blocks.
+   *
+   *  Every method returns false if the event is not valid at this point, for instance a key
+   *  outside of an object or a number that is not finite.
+   */
+  class JsonWriter
+  {
+  public:
+    /// Writes into a buffer that grows as required, see text()
+    explicit JsonWriter(const JsonWriterOptions &options = JsonWriterOptions());
+
+    /// Writes to the given sink
+    explicit JsonWriter(IJsonWriterSink *sink, const JsonWriterOptions &options = JsonWriterOptions());
+
+    /// Passes any remaining output to the sink
+    ~JsonWriter() { flush(); }
+
+    /// Json event handler
+    bool Null();
+    bool Boolean(bool value);
+    bool Number(double value);
+    bool Integer(int64_t value);
+    bool String(StringRef value);
+    bool StartObject();
+    bool Key(StringRef key);
+    bool EndObject();
+    bool StartArray();
+    bool EndArray();
+
+    /// Writes a value and all of its children
+    bool Value(const JsonValue &value);
+
+    /// Returns true once a complete root value was written
+    bool complete() const { return complete_; }
+
+    /// Passes the buffered output to the sink. Does nothing when writing without a sink.
+    void flush();
+
+    /// Returns the output written so far when writing without a sink
+    StringRef text() const { return StringRef(buffer_.data(), size_); }
+
+    /// Discards the output and prepares the writer for another document
+    void reset();
+
+  private:
+    struct Frame
+    {
+      bool object;
+      bool braces;
+      size_t count;
+    };
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    /// Writes whatever has to precede a value of the given type, returns false if the value is not
+    /// allowed here
+    bool begin_value(JsonType type);
+
+    /// Writes the separator and indentation that precede a member or element of the top frame
+    void begin_item(Frame &frame);
+
+    /// Closes the top frame, returns false if it is not of the given kind
+    bool end_container(bool object);
+
+    /// Writes a quoted and escaped string
+    void write_string(StringRef value);
+
+    /// Returns the nesting level of the items of the top frame, a braceless root adds no level
+    size_t level() const { return stack_.size() - (!stack_.empty() && !stack_.front().braces ? 1 : 0); }
+
+    /// Writes a newline followed by the indentation of the given nesting level
+    void write_newline(size_t level);
+
+    /// Makes room for at least the given number of characters
+    char* reserve(size_t count)
+    {
+      if (buffer_.size() - size_ < count)
+        grow(count);
+      return buffer_.data() + size_;
+    }
+
+    /// Flushes to the sink or grows the buffer so that count more characters fit
+    void grow(size_t count);
+
+    /// Appends characters to the output
+    void put(char c) { *reserve(1) = c; ++size_; }
+    void put(const char *data, size_t length)
+    {
+      std::memcpy(reserve(length), data, length);
+      size_ += length;
+    }
+
+  private:
+    IJsonWriterSink *sink_;
+    JsonWriterOptions options_;
+    std::vector<char> buffer_;
+    size_t size_;
+    std::vector<Frame> stack_;
+    bool keyPending_;
+    bool complete_;
+  };
+
+  namespace detail {
+
+    /// Formats a finite double with digits that read back as the same value, which are the
+    /// shortest such digits for all but a tiny fraction of numbers. Numbers that would read back
+    /// as integers get a fractional part so they stay doubles. Returns the number of characters
+    /// written to the buffer, which must hold at least 32 characters.
+    size_t format_double(double value, char *buffer);
+
+    /// Formats an integer and returns the number of characters written to the buffer, which must
+    /// hold at least 20 characters.
+    size_t format_integer(int64_t value, char *buffer);
+  }
+
+  /// Writes a value and its children as json text. Returns false if the value can not be
+  /// represented in the dialect, for instance a number that is not finite.
+  bool write_json(const JsonValue &value, std::string &output, const JsonWriterOptions &options = JsonWriterOptions());
+  bool write_json(const JsonValue &value, IJsonWriterSink *sink, const JsonWriterOptions &options = JsonWriterOptions());
+}
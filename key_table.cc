@@ -0,0 +1,119 @@
+#include "key_table.h"
+#include "flat_map.h"
+
+namespace knowson {
+
+  //-----------------------------------------------------------------------------------------------
+  KeyTable::KeyTable(size_t pageSize) :
+    size_(0),
+    strings_(pageSize)
+  {
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  KeyTable::KeyTable(KeyTable &&other) :
+    slots_(std::move(other.slots_)),
+    size_(other.size_),
+    strings_(std::move(other.strings_))
+  {
+    other.slots_.clear();
+    other.size_ = 0;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  KeyTable& KeyTable::operator=(KeyTable &&other)
+  {
+    if (this != &other)
+    {
+      slots_ = std::move(other.slots_);
+      size_ = other.size_;
+      strings_ = std::move(other.strings_);
+      other.slots_.clear();
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  size_t KeyTable::probe(StringRef key, uint32_t hash) const
+  {
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+      const Slot &slot = slots_[i];
+      if (slot.data == nullptr ||
+        (slot.hash == hash && StringRef(slot.data, slot.size) == key))
+        return i;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  StringRef KeyTable::intern(StringRef key)
+  {
+    // Keep the table at most half full
+    if ((size_ + 1) * 2 > slots_.size())
+      grow();
+
+    uint32_t hash = detail::hash_string(key.data(), key.size());
+    Slot &slot = slots_[probe(key, hash)];
+    if (slot.data == nullptr)
+    {
+      slot.data = strings_.copy_string(key.data(), key.size());
+      slot.size = static_cast<uint32_t>(key.size());
+      slot.hash = hash;
+      ++size_;
+    }
+    return StringRef(slot.data, slot.size);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool KeyTable::find(StringRef key, StringRef &canonical) const
+  {
+    if (size_ == 0)
+      return false;
+
+    const Slot &slot = slots_[probe(key, detail::hash_string(key.data(), key.size()))];
+    if (slot.data == nullptr)
+      return false;
+
+    canonical = StringRef(slot.data, slot.size);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool KeyTable::is_canonical(StringRef key) const
+  {
+    StringRef canonical;
+    return find(key, canonical) && canonical.data() == key.data();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void KeyTable::clear()
+  {
+    slots_.clear();
+    size_ = 0;
+    strings_.clear();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void KeyTable::grow()
+  {
+    std::vector<Slot> previous;
+    previous.swap(slots_);
+
+    Slot empty = { nullptr, 0, 0 };
+    slots_.assign(previous.empty() ? 64 : previous.size() * 2, empty);
+
+    size_t mask = slots_.size() - 1;
+    for (const Slot &slot : previous)
+    {
+      if (slot.data == nullptr)
+        continue;
+
+      size_t i = slot.hash & mask;
+      while (slots_[i].data != nullptr)
+        i = (i + 1) & mask;
+      slots_[i] = slot;
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "arena.h"
+#include "string_ref.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace knowson {
+
+  /**
+   * @brief Interns strings so that every distinct key is stored once. Interned keys are canonical:
+   *  two interned keys are equal if and only if they point to the same characters, which turns
+   *  key comparisons into pointer comparisons. Documents and definitions that share a table only
+   *  store references to its strings, so the table must outlive them.
+   *
+   *  A table is not synchronized; share it between threads only once no more keys are interned.
+   */
+  class KeyTable
+  {
+  public:
+    /// Default constructor
+    explicit KeyTable(size_t pageSize = 16 * 1024);
+
+    /// Move constructor
+    KeyTable(KeyTable &&other);
+
+    /// Move assignment
+    KeyTable& operator=(KeyTable &&other);
+
+    /// Returns the canonical copy of the given key, adding it to the table if it is new
+    StringRef intern(StringRef key);
+
+    /// Looks up the canonical copy of the given key without adding it. Returns false if the key
+    /// was never interned.
+    bool find(StringRef key, StringRef &canonical) const;
+
+    /// Returns true if the given reference points to the canonical copy of its key
+    bool is_canonical(StringRef key) const;
+
+    /// Returns the number of distinct keys
+    size_t size() const { return size_; }
+
+    /// Returns the number of bytes used by the table
+    size_t capacity() const { return strings_.capacity() + slots_.capacity() * sizeof(Slot); }
+
+    /// Removes all keys. References to previously interned keys become invalid.
+    void clear();
+
+  private:
+    struct Slot
+    {
+      const char *data;
+      uint32_t size;
+      uint32_t hash;
+    };
+
+    KeyTable(const KeyTable&) = delete;
+    KeyTable& operator=(const KeyTable&) = delete;
+
+    /// Returns the index of the slot that holds the key or of the empty slot where it belongs
+    size_t probe(StringRef key, uint32_t hash) const;
+
+    /// Doubles the number of slots
+    void grow();
+
+  private:
+    std::vector<Slot> slots_;
+    size_t size_;
+    Arena strings_;
+  };
+}
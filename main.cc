@@ -0,0 +1,16 @@
+#include "json_mapped_file.h"
+
+//-----------------------------------------------------------------------------------------------
+int main()
+{
+	using namespace knowson;
+
+  MappedFileJsonParserSource source("test.json");
+  if (!source.is_open())
+    return 1;
+
+	JsonDocument document;
+	bool result = parse_json(&source, document);
+
+	return 0;
+}
@@ -0,0 +1,799 @@
+#include "schema.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace knowson {
+
+  namespace detail {
+
+    namespace
+    {
+      //-----------------------------------------------------------------------------------------------
+      /// Returns a node without constraints
+      JsonSchema::Node empty_node()
+      {
+        JsonSchema::Node node;
+        std::memset(&node, 0, sizeof(node));
+        node.types = JsonSchema::kTypeAny;
+        node.maxLength = std::numeric_limits<uint32_t>::max();
+        node.maxItems = std::numeric_limits<uint32_t>::max();
+        node.items = JsonSchema::kNoNode;
+        node.additionalProperties = JsonSchema::kNoNode;
+        return node;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Counts the code points of a UTF-8 string
+      size_t count_code_points(StringRef value)
+      {
+        size_t count = 0;
+        for (char c : value)
+          count += (static_cast<unsigned char>(c) & 0xC0) != 0x80 ? 1 : 0;
+        return count;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      JsonType enum_type(uint32_t type)
+      {
+        switch (type)
+        {
+        case JsonSchema::kTypeNull: return JsonType::kNull;
+        case JsonSchema::kTypeBoolean: return JsonType::kBoolean;
+        case JsonSchema::kTypeString: return JsonType::kString;
+        case JsonSchema::kTypeArray: return JsonType::kArray;
+        case JsonSchema::kTypeObject: return JsonType::kObject;
+        default: return JsonType::kNumber;
+        }
+      }
+    }
+
+    /**
+     * @brief Translates a schema document into the nodes of a JsonSchema
+     */
+    class SchemaCompiler
+    {
+    public:
+      SchemaCompiler(JsonSchema &schema, std::string *error) : schema_(schema), error_(error) {}
+
+      //-----------------------------------------------------------------------------------------------
+      /// Replaces the content of the schema with the compiled document
+      bool compile_root(const JsonValue &value)
+      {
+        uint32_t root;
+        schema_.nodes_.clear();
+        schema_.depth_ = 1;
+        return compile(value, 1, root);
+      }
+
+    private:
+      //-----------------------------------------------------------------------------------------------
+      /// Compiles the given (sub)schema and returns the index of its node. Subschemas without
+      /// constraints compile to kNoNode unless they are the root.
+      bool compile(const JsonValue &value, size_t depth, uint32_t &result)
+      {
+        if (depth > schema_.depth_)
+          schema_.depth_ = depth;
+
+        uint32_t index = static_cast<uint32_t>(schema_.nodes_.size());
+        schema_.nodes_.push_back(empty_node());
+
+        if (value.type() == JsonType::kBoolean)
+        {
+          if (!static_cast<const JsonBoolean&>(value).value())
+            schema_.nodes_[index].types = 0;
+        }
+        else if (value.type() != JsonType::kObject)
+          return fail("a schema must be an object or a boolean");
+        else if (!compile_object(static_cast<const JsonObject&>(value), depth, index))
+          return false;
+
+        // Nodes without constraints do not have children, so they are always the last node
+        if (depth > 1 && is_unconstrained(schema_.nodes_[index]))
+        {
+          schema_.nodes_.pop_back();
+          index = JsonSchema::kNoNode;
+        }
+
+        result = index;
+        return true;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      bool compile_object(const JsonObject &schema, size_t depth, uint32_t index)
+      {
+        const JsonValue *type = nullptr, *properties = nullptr, *required = nullptr, *items = nullptr,
+          *additional = nullptr, *enumeration = nullptr, *minimum = nullptr, *maximum = nullptr,
+          *exclusiveMinimum = nullptr, *exclusiveMaximum = nullptr;
+
+        // Gather the keywords first so they are processed in a fixed order
+        for (const JsonObject::Member &member : schema)
+        {
+          StringRef key = member.first;
+          const JsonValue *value = member.second;
+          if (key == "type") type = value;
+          else if (key == "properties") properties = value;
+          else if (key == "required") required = value;
+          else if (key == "items") items = value;
+          else if (key == "additionalProperties") additional = value;
+          else if (key == "enum") enumeration = value;
+          else if (key == "minimum") minimum = value;
+          else if (key == "maximum") maximum = value;
+          else if (key == "exclusiveMinimum") exclusiveMinimum = value;
+          else if (key == "exclusiveMaximum") exclusiveMaximum = value;
+          else if (key == "minLength" || key == "maxLength" || key == "minItems" || key == "maxItems")
+          {
+            uint32_t count;
+            if (!read_count(key, *value, count))
+              return false;
+            JsonSchema::Node &node = schema_.nodes_[index];
+            if (key == "minLength") node.minLength = count;
+            else if (key == "maxLength") node.maxLength = count;
+            else if (key == "minItems") node.minItems = count;
+            else node.maxItems = count;
+          }
+          else if (key == "$ref" || key == "allOf" || key == "anyOf" || key == "oneOf" || key == "not" ||
+            key == "patternProperties" || key == "dependencies" || key == "pattern" || key == "multipleOf")
+            return fail("unsupported keyword '" + key.str() + "'");
+        }
+
+        if (type != nullptr && !compile_type(*type, index))
+          return false;
+        if (!compile_bounds(minimum, exclusiveMinimum, index, true) ||
+          !compile_bounds(maximum, exclusiveMaximum, index, false))
+          return false;
+        if (enumeration != nullptr && !compile_enum(*enumeration, index))
+          return false;
+
+        if (items != nullptr)
+        {
+          if (items->type() == JsonType::kArray)
+            return fail("tuple validation with 'items' is not supported");
+
+          uint32_t child;
+          if (!compile(*items, depth + 1, child))
+            return false;
+          schema_.nodes_[index].items = child;
+        }
+
+        if (additional != nullptr)
+        {
+          if (additional->type() == JsonType::kBoolean)
+          {
+            if (!static_cast<const JsonBoolean&>(*additional).value())
+              schema_.nodes_[index].flags |= JsonSchema::kClosed;
+          }
+          else
+          {
+            uint32_t child;
+            if (!compile(*additional, depth + 1, child))
+              return false;
+            schema_.nodes_[index].additionalProperties = child;
+          }
+        }
+
+        return compile_properties(properties, required, depth, index);
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      bool compile_type(const JsonValue &value, uint32_t index)
+      {
+        uint32_t types = 0;
+        if (value.type() == JsonType::kString)
+        {
+          if (!type_mask(static_cast<const JsonString&>(value).value(), types))
+            return false;
+        }
+        else if (value.type() == JsonType::kArray)
+        {
+          for (const JsonValue *element : static_cast<const JsonArray&>(value))
+          {
+            if (element->type() != JsonType::kString)
+              return fail("'type' must be a string or an array of strings");
+            if (!type_mask(static_cast<const JsonString*>(element)->value(), types))
+              return false;
+          }
+        }
+        else
+          return fail("'type' must be a string or an array of strings");
+
+        schema_.nodes_[index].types = types;
+        return true;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      bool type_mask(StringRef name, uint32_t &types)
+      {
+        if (name == "null") types |= JsonSchema::kTypeNull;
+        else if (name == "boolean") types |= JsonSchema::kTypeBoolean;
+        else if (name == "integer") types |= JsonSchema::kTypeInteger;
+        else if (name == "number") types |= JsonSchema::kTypeNumber | JsonSchema::kTypeInteger;
+        else if (name == "string") types |= JsonSchema::kTypeString;
+        else if (name == "array") types |= JsonSchema::kTypeArray;
+        else if (name == "object") types |= JsonSchema::kTypeObject;
+        else
+          return fail("unknown type '" + name.str() + "'");
+        return true;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      /// Combines minimum and exclusiveMinimum (or the maximum pair) into the single strictest bound.
+      /// The exclusive keyword is either a boolean modifier (draft 4) or a bound of its own.
+      bool compile_bounds(const JsonValue *inclusive, const JsonValue *exclusive, uint32_t index, bool lower)
+      {
+        JsonSchema::Node &node = schema_.nodes_[index];
+        uint32_t boundFlag = lower ? JsonSchema::kMinimum : JsonSchema::kMaximum;
+        uint32_t exclusiveFlag = lower ? JsonSchema::kExclusiveMinimum : JsonSchema::kExclusiveMaximum;
+        double &bound = lower ? node.minimum : node.maximum;
+
+        if (inclusive != nullptr)
+        {
+          if (inclusive->type() != JsonType::kNumber)
+            return fail(lower ? "'minimum' must be a number" : "'maximum' must be a number");
+          bound = static_cast<const JsonNumber&>(*inclusive).value();
+          node.flags |= boundFlag;
+        }
+
+        if (exclusive == nullptr)
+          return true;
+
+        if (exclusive->type() == JsonType::kBoolean)
+        {
+          if (static_cast<const JsonBoolean&>(*exclusive).value() && (node.flags & boundFlag) != 0)
+            node.flags |= exclusiveFlag;
+          return true;
+        }
+
+        if (exclusive->type() != JsonType::kNumber)
+          return fail("exclusive bounds must be a number or a boolean");
+
+        double value = static_cast<const JsonNumber&>(*exclusive).value();
+        bool stricter = (node.flags & boundFlag) == 0 || (lower ? value >= bound : value <= bound);
+        if (stricter)
+        {
+          bound = value;
+          node.flags |= boundFlag | exclusiveFlag;
+        }
+        return true;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      bool compile_enum(const JsonValue &value, uint32_t index)
+      {
+        if (value.type() != JsonType::kArray)
+          return fail("'enum' must be an array");
+
+        const JsonArray &values = static_cast<const JsonArray&>(value);
+        uint32_t first = static_cast<uint32_t>(schema_.enums_.size());
+        for (const JsonValue *element : values)
+        {
+          JsonSchema::EnumValue entry;
+          entry.type = element->type();
+          entry.boolean = false;
+          entry.number = 0;
+          switch (element->type())
+          {
+          case JsonType::kBoolean: entry.boolean = static_cast<const JsonBoolean*>(element)->value(); break;
+          case JsonType::kNumber: entry.number = static_cast<const JsonNumber*>(element)->value(); break;
+          case JsonType::kString: entry.string = copy(static_cast<const JsonString*>(element)->value()); break;
+          case JsonType::kNull: break;
+          default:
+            return fail("'enum' values must be strings, numbers, booleans or null");
+          }
+          schema_.enums_.push_back(entry);
+        }
+
+        JsonSchema::Node &node = schema_.nodes_[index];
+        node.firstEnum = first;
+        node.enumCount = static_cast<uint32_t>(values.size());
+
+        // An empty enum accepts nothing
+        if (node.enumCount == 0)
+          node.types = 0;
+        return true;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      bool compile_properties(const JsonValue *properties, const JsonValue *required, size_t depth, uint32_t index)
+      {
+        // Children are compiled before the properties of this node are appended, so the properties of
+        // every node end up contiguous
+        std::vector<JsonSchema::Property> entries;
+        if (properties != nullptr)
+        {
+          if (properties->type() != JsonType::kObject)
+            return fail("'properties' must be an object");
+
+          for (const JsonObject::Member &member : static_cast<const JsonObject&>(*properties))
+          {
+            JsonSchema::Property entry;
+            entry.name = copy(member.first);
+            entry.hash = hash_string(member.first.data(), member.first.size());
+            entry.requiredBit = 0;
+            if (!compile(*member.second, depth + 1, entry.node))
+              return false;
+            entries.push_back(entry);
+          }
+        }
+
+        uint64_t requiredMask = 0;
+        if (required != nullptr)
+        {
+          if (required->type() != JsonType::kArray)
+            return fail("'required' must be an array");
+
+          for (const JsonValue *element : static_cast<const JsonArray&>(*required))
+          {
+            if (element->type() != JsonType::kString)
+              return fail("'required' must be an array of strings");
+
+            StringRef name = static_cast<const JsonString*>(element)->value();
+            JsonSchema::Property *entry = nullptr;
+            for (JsonSchema::Property &candidate : entries)
+              if (candidate.name == name)
+                entry = &candidate;
+
+            // A required property without a schema of its own accepts any value
+            if (entry == nullptr)
+            {
+              JsonSchema::Property property;
+              property.name = copy(name);
+              property.hash = hash_string(name.data(), name.size());
+              property.node = JsonSchema::kNoNode;
+              property.requiredBit = 0;
+              entries.push_back(property);
+              entry = &entries.back();
+            }
+
+            if (entry->requiredBit != 0)
+              continue;
+            if (requiredMask == ~uint64_t(0))
+              return fail("too many required properties");
+
+            entry->requiredBit = requiredMask + 1;
+            requiredMask = (requiredMask << 1) | 1;
+          }
+        }
+
+        JsonSchema::Node &node = schema_.nodes_[index];
+        node.requiredMask = requiredMask;
+        node.firstProperty = static_cast<uint32_t>(schema_.properties_.size());
+        node.propertyCount = static_cast<uint32_t>(entries.size());
+        schema_.properties_.insert(schema_.properties_.end(), entries.begin(), entries.end());
+        if (entries.empty())
+          return true;
+
+        // Open addressing table at most half full, slots store the property index plus one
+        uint32_t slotCount = 4;
+        while (slotCount < entries.size() * 2)
+          slotCount <<= 1;
+
+        node.firstSlot = static_cast<uint32_t>(schema_.slots_.size());
+        node.slotMask = slotCount - 1;
+        schema_.slots_.resize(schema_.slots_.size() + slotCount, 0);
+        uint32_t *slots = schema_.slots_.data() + node.firstSlot;
+        for (uint32_t i = 0; i < entries.size(); ++i)
+        {
+          uint32_t slot = entries[i].hash & node.slotMask;
+          while (slots[slot] != 0)
+            slot = (slot + 1) & node.slotMask;
+          slots[slot] = i + 1;
+        }
+        return true;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      bool read_count(StringRef key, const JsonValue &value, uint32_t &result)
+      {
+        if (value.type() == JsonType::kNumber)
+        {
+          double number = static_cast<const JsonNumber&>(value).value();
+          if (number >= 0 && number <= std::numeric_limits<uint32_t>::max() && std::floor(number) == number)
+          {
+            result = static_cast<uint32_t>(number);
+            return true;
+          }
+        }
+        return fail("'" + key.str() + "' must be a non-negative integer");
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      StringRef copy(StringRef value)
+      {
+        return StringRef(schema_.strings_.copy_string(value.data(), value.size()), value.size());
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      static bool is_unconstrained(const JsonSchema::Node &node)
+      {
+        JsonSchema::Node empty = empty_node();
+        return node.types == empty.types && node.flags == 0 && node.minLength == 0 &&
+          node.maxLength == empty.maxLength && node.minItems == 0 && node.maxItems == empty.maxItems &&
+          node.items == JsonSchema::kNoNode && node.additionalProperties == JsonSchema::kNoNode &&
+          node.propertyCount == 0 && node.enumCount == 0;
+      }
+
+      //-----------------------------------------------------------------------------------------------
+      bool fail(const std::string &message)
+      {
+        if (error_ != nullptr)
+          *error_ = message;
+        return false;
+      }
+
+    private:
+      JsonSchema &schema_;
+      std::string *error_;
+    };
+
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  const char* schema_error_to_string(JsonSchemaErrorCode code)
+  {
+    switch (code)
+    {
+    case JsonSchemaErrorCode::kNone: return "no error";
+    case JsonSchemaErrorCode::kType: return "value has the wrong type";
+    case JsonSchemaErrorCode::kMinimum: return "number is below the minimum";
+    case JsonSchemaErrorCode::kMaximum: return "number is above the maximum";
+    case JsonSchemaErrorCode::kMinLength: return "string is shorter than minLength";
+    case JsonSchemaErrorCode::kMaxLength: return "string is longer than maxLength";
+    case JsonSchemaErrorCode::kMinItems: return "array has fewer than minItems elements";
+    case JsonSchemaErrorCode::kMaxItems: return "array has more than maxItems elements";
+    case JsonSchemaErrorCode::kEnum: return "value is not one of the enum values";
+    case JsonSchemaErrorCode::kRequired: return "object is missing a required property";
+    case JsonSchemaErrorCode::kAdditionalProperty: return "object has a property that is not allowed";
+    }
+    return "unknown error";
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool compile_schema(const JsonValue &schema, JsonSchema &result, std::string *error)
+  {
+    JsonSchema compiled;
+    detail::SchemaCompiler compiler(compiled, error);
+    if (!compiler.compile_root(schema))
+      return false;
+
+    result = std::move(compiled);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonSchema::JsonSchema() :
+    strings_(1024),
+    depth_(1)
+  {
+    // The default schema has a single node that accepts everything
+    nodes_.push_back(detail::empty_node());
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  uint32_t JsonSchema::number_type(double value)
+  {
+    return std::isfinite(value) && std::floor(value) == value ? kTypeInteger : kTypeNumber;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  const JsonSchema::Property* JsonSchema::find_property(const Node &node, StringRef name) const
+  {
+    if (node.propertyCount == 0)
+      return nullptr;
+
+    uint32_t hash = detail::hash_string(name.data(), name.size());
+    const uint32_t *slots = slots_.data() + node.firstSlot;
+    for (uint32_t slot = hash & node.slotMask; slots[slot] != 0; slot = (slot + 1) & node.slotMask)
+    {
+      const Property &property = properties_[node.firstProperty + slots[slot] - 1];
+      if (property.hash == hash && property.name == name)
+        return &property;
+    }
+    return nullptr;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonSchemaErrorCode JsonSchema::check_value(const Node &node, uint32_t type, bool boolean, double number,
+    StringRef string) const
+  {
+    if ((node.types & type) == 0)
+      return JsonSchemaErrorCode::kType;
+
+    if (type == kTypeString && (node.minLength > 0 || node.maxLength != std::numeric_limits<uint32_t>::max()))
+    {
+      // A code point takes one to four bytes, so the byte count often decides without counting
+      size_t bytes = string.size();
+      if (bytes < node.minLength)
+        return JsonSchemaErrorCode::kMinLength;
+      if (bytes / 4 < node.minLength || bytes > node.maxLength)
+      {
+        size_t length = detail::count_code_points(string);
+        if (length < node.minLength)
+          return JsonSchemaErrorCode::kMinLength;
+        if (length > node.maxLength)
+          return JsonSchemaErrorCode::kMaxLength;
+      }
+    }
+    else if ((type & (kTypeInteger | kTypeNumber)) != 0 && node.flags != 0)
+    {
+      if ((node.flags & kMinimum) != 0 &&
+        ((node.flags & kExclusiveMinimum) != 0 ? number <= node.minimum : number < node.minimum))
+        return JsonSchemaErrorCode::kMinimum;
+      if ((node.flags & kMaximum) != 0 &&
+        ((node.flags & kExclusiveMaximum) != 0 ? number >= node.maximum : number > node.maximum))
+        return JsonSchemaErrorCode::kMaximum;
+    }
+
+    if (node.enumCount == 0)
+      return JsonSchemaErrorCode::kNone;
+
+    JsonType valueType = detail::enum_type(type);
+    const EnumValue *value = enums_.data() + node.firstEnum;
+    for (const EnumValue *end = value + node.enumCount; value != end; ++value)
+    {
+      if (value->type != valueType)
+        continue;
+
+      switch (valueType)
+      {
+      case JsonType::kNull: return JsonSchemaErrorCode::kNone;
+      case JsonType::kBoolean: if (value->boolean == boolean) return JsonSchemaErrorCode::kNone; break;
+      case JsonType::kNumber: if (value->number == number) return JsonSchemaErrorCode::kNone; break;
+      case JsonType::kString: if (value->string == string) return JsonSchemaErrorCode::kNone; break;
+      default: break;
+      }
+    }
+    return JsonSchemaErrorCode::kEnum;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchema::validate(const JsonValue &value, JsonSchemaError *error) const
+  {
+    uint32_t failedNode = 0;
+    JsonSchemaErrorCode code = validate_node(0, value, failedNode);
+    if (error != nullptr)
+    {
+      error->code = code;
+      error->node = failedNode;
+    }
+    return code == JsonSchemaErrorCode::kNone;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonSchemaErrorCode JsonSchema::validate_node(uint32_t index, const JsonValue &value, uint32_t &failedNode) const
+  {
+    const Node &node = nodes_[index];
+    JsonSchemaErrorCode code = JsonSchemaErrorCode::kNone;
+    switch (value.type())
+    {
+    case JsonType::kNull:
+      code = check_value(node, kTypeNull, false, 0, StringRef());
+      break;
+    case JsonType::kBoolean:
+      code = check_value(node, kTypeBoolean, static_cast<const JsonBoolean&>(value).value(), 0, StringRef());
+      break;
+    case JsonType::kString:
+      code = check_value(node, kTypeString, false, 0, static_cast<const JsonString&>(value).value());
+      break;
+    case JsonType::kNumber:
+    {
+      const JsonNumber &number = static_cast<const JsonNumber&>(value);
+      uint32_t type = number.is_integer() ? kTypeInteger : number_type(number.value());
+      code = check_value(node, type, false, number.value(), StringRef());
+      break;
+    }
+    case JsonType::kArray:
+    {
+      const JsonArray &array = static_cast<const JsonArray&>(value);
+      code = check_value(node, kTypeArray, false, 0, StringRef());
+      if (code == JsonSchemaErrorCode::kNone && array.size() < node.minItems)
+        code = JsonSchemaErrorCode::kMinItems;
+      if (code == JsonSchemaErrorCode::kNone && array.size() > node.maxItems)
+        code = JsonSchemaErrorCode::kMaxItems;
+      if (code != JsonSchemaErrorCode::kNone || node.items == kNoNode)
+        break;
+
+      for (const JsonValue *element : array)
+      {
+        JsonSchemaErrorCode elementCode = validate_node(node.items, *element, failedNode);
+        if (elementCode != JsonSchemaErrorCode::kNone)
+          return elementCode;
+      }
+      break;
+    }
+    case JsonType::kObject:
+    {
+      code = check_value(node, kTypeObject, false, 0, StringRef());
+      if (code != JsonSchemaErrorCode::kNone)
+        break;
+
+      uint64_t required = 0;
+      for (const JsonObject::Member &member : static_cast<const JsonObject&>(value))
+      {
+        uint32_t child = node.additionalProperties;
+        const Property *property = find_property(node, member.first);
+        if (property != nullptr)
+        {
+          child = property->node;
+          required |= property->requiredBit;
+        }
+        else if ((node.flags & kClosed) != 0)
+        {
+          code = JsonSchemaErrorCode::kAdditionalProperty;
+          break;
+        }
+
+        if (child != kNoNode)
+        {
+          JsonSchemaErrorCode memberCode = validate_node(child, *member.second, failedNode);
+          if (memberCode != JsonSchemaErrorCode::kNone)
+            return memberCode;
+        }
+      }
+
+      if (code == JsonSchemaErrorCode::kNone && required != node.requiredMask)
+        code = JsonSchemaErrorCode::kRequired;
+      break;
+    }
+    }
+
+    if (code != JsonSchemaErrorCode::kNone)
+      failedNode = index;
+    return code;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  JsonSchemaValidator::JsonSchemaValidator(const JsonSchema &schema) :
+    schema_(schema),
+    skipDepth_(0),
+    done_(false)
+  {
+    // Frames are only pushed for schema nodes, so the stack never grows beyond the schema depth
+    stack_.reserve(schema.depth());
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void JsonSchemaValidator::reset()
+  {
+    stack_.clear();
+    skipDepth_ = 0;
+    done_ = false;
+    error_ = JsonSchemaError();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  uint32_t JsonSchemaValidator::next_node()
+  {
+    if (stack_.empty())
+      return 0;
+
+    Frame &frame = stack_.back();
+    if (frame.array)
+      ++frame.count;
+    return frame.next;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchemaValidator::end_value()
+  {
+    if (stack_.empty())
+      done_ = true;
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchemaValidator::fail(JsonSchemaErrorCode code, uint32_t node)
+  {
+    error_.code = code;
+    error_.node = node;
+    return false;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchemaValidator::scalar(uint32_t type, bool boolean, double number, StringRef string)
+  {
+    if (skipDepth_ > 0)
+      return true;
+
+    uint32_t index = next_node();
+    if (index == JsonSchema::kNoNode)
+      return end_value();
+
+    JsonSchemaErrorCode code = schema_.check_value(schema_.node(index), type, boolean, number, string);
+    if (code != JsonSchemaErrorCode::kNone)
+      return fail(code, index);
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchemaValidator::start(uint32_t type)
+  {
+    if (skipDepth_ > 0)
+    {
+      ++skipDepth_;
+      return true;
+    }
+
+    // Containers without a schema are skipped by only tracking their depth
+    uint32_t index = next_node();
+    if (index == JsonSchema::kNoNode)
+    {
+      skipDepth_ = 1;
+      return true;
+    }
+
+    const JsonSchema::Node &node = schema_.node(index);
+    JsonSchemaErrorCode code = schema_.check_value(node, type, false, 0, StringRef());
+    if (code != JsonSchemaErrorCode::kNone)
+      return fail(code, index);
+
+    Frame frame;
+    frame.node = index;
+    frame.array = type == JsonSchema::kTypeArray;
+    frame.next = frame.array ? node.items : JsonSchema::kNoNode;
+    frame.count = 0;
+    frame.required = 0;
+    stack_.push_back(frame);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchemaValidator::Null() { return scalar(JsonSchema::kTypeNull, false, 0, StringRef()); }
+  bool JsonSchemaValidator::Boolean(bool value) { return scalar(JsonSchema::kTypeBoolean, value, 0, StringRef()); }
+  bool JsonSchemaValidator::Number(double value) { return scalar(JsonSchema::number_type(value), false, value, StringRef()); }
+  bool JsonSchemaValidator::Integer(int64_t value) { return scalar(JsonSchema::kTypeInteger, false, static_cast<double>(value), StringRef()); }
+  bool JsonSchemaValidator::String(StringRef value) { return scalar(JsonSchema::kTypeString, false, 0, value); }
+  bool JsonSchemaValidator::StartObject() { return start(JsonSchema::kTypeObject); }
+  bool JsonSchemaValidator::StartArray() { return start(JsonSchema::kTypeArray); }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchemaValidator::Key(StringRef key)
+  {
+    if (skipDepth_ > 0)
+      return true;
+
+    Frame &frame = stack_.back();
+    const JsonSchema::Node &node = schema_.node(frame.node);
+    const JsonSchema::Property *property = schema_.find_property(node, key);
+    if (property != nullptr)
+    {
+      frame.next = property->node;
+      frame.required |= property->requiredBit;
+    }
+    else if ((node.flags & JsonSchema::kClosed) != 0)
+      return fail(JsonSchemaErrorCode::kAdditionalProperty, frame.node);
+    else
+      frame.next = node.additionalProperties;
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchemaValidator::EndObject()
+  {
+    if (skipDepth_ > 0)
+      return --skipDepth_ > 0 || end_value();
+
+    Frame frame = stack_.back();
+    stack_.pop_back();
+    if (frame.required != schema_.node(frame.node).requiredMask)
+      return fail(JsonSchemaErrorCode::kRequired, frame.node);
+    return end_value();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool JsonSchemaValidator::EndArray()
+  {
+    if (skipDepth_ > 0)
+      return --skipDepth_ > 0 || end_value();
+
+    Frame frame = stack_.back();
+    stack_.pop_back();
+    const JsonSchema::Node &node = schema_.node(frame.node);
+    if (frame.count < node.minItems)
+      return fail(JsonSchemaErrorCode::kMinItems, frame.node);
+    if (frame.count > node.maxItems)
+      return fail(JsonSchemaErrorCode::kMaxItems, frame.node);
+    return end_value();
+  }
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "arena.h"
+#include "json.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace knowson {
+
+  namespace detail {
+    class SchemaCompiler;
+  }
+
+  /// Describes why a value did not validate against a schema
+  enum class JsonSchemaErrorCode
+  {
+    kNone,
+    kType,
+    kMinimum,
+    kMaximum,
+    kMinLength,
+    kMaxLength,
+    kMinItems,
+    kMaxItems,
+    kEnum,
+    kRequired,
+    kAdditionalProperty,
+  };
+
+  /// Returns a human readable description of the given error code
+  const char* schema_error_to_string(JsonSchemaErrorCode code);
+
+  /**
+   * @brief Result of a failed validation
+   */
+  struct JsonSchemaError
+  {
+  public:
+    /// Default constructor
+    JsonSchemaError() : code(JsonSchemaErrorCode::kNone), node(0) {}
+
+    /// The constraint that was violated
+    JsonSchemaErrorCode code;
+
+    /// Index of the compiled schema node that contains the constraint
+    uint32_t node;
+  };
+
+  /**
+   * @brief A json schema compiled to a flat validation program. Every (sub)schema becomes a node
+   *  that holds its constraints directly; properties are resolved through a hash table that is
+   *  built at compile time. Validating a value only reads the program, it never allocates.
+   *
+   *  Supported keywords are type, properties, required, additionalProperties, items, enum,
+   *  minimum, maximum, exclusiveMinimum, exclusiveMaximum, minLength, maxLength, minItems and
+   *  maxItems. Annotations like title, description, default and format are ignored, and so is
+   *  uniqueItems since it cannot be checked without per-document state.
+   */
+  class JsonSchema
+  {
+  public:
+    /// Index used for subschemas that accept any value
+    static const uint32_t kNoNode = 0xffffffffu;
+
+    /// Bits of the type mask of a node
+    enum TypeMask : uint32_t
+    {
+      kTypeNull = 1 << 0,
+      kTypeBoolean = 1 << 1,
+      kTypeInteger = 1 << 2,
+      kTypeNumber = 1 << 3,
+      kTypeString = 1 << 4,
+      kTypeArray = 1 << 5,
+      kTypeObject = 1 << 6,
+      kTypeAny = (1 << 7) - 1,
+    };
+
+    /// Flags of a node
+    enum NodeFlags : uint32_t
+    {
+      kMinimum = 1 << 0,
+      kMaximum = 1 << 1,
+      kExclusiveMinimum = 1 << 2,
+      kExclusiveMaximum = 1 << 3,
+      kClosed = 1 << 4,
+    };
+
+    /// The maximum number of required properties per object
+    static const size_t kMaxRequired = 64;
+
+    /**
+     * @brief The constraints of a single (sub)schema
+     */
+    struct Node
+    {
+      uint32_t types;
+      uint32_t flags;
+      double minimum;
+      double maximum;
+      uint32_t minLength;
+      uint32_t maxLength;
+      uint32_t minItems;
+      uint32_t maxItems;
+      uint32_t items;
+      uint32_t additionalProperties;
+      uint32_t firstProperty;
+      uint32_t propertyCount;
+      uint32_t firstSlot;
+      uint32_t slotMask;
+      uint32_t firstEnum;
+      uint32_t enumCount;
+      uint64_t requiredMask;
+    };
+
+    /**
+     * @brief A property of an object node
+     */
+    struct Property
+    {
+      StringRef name;
+      uint32_t hash;
+      uint32_t node;
+      uint64_t requiredBit;
+    };
+
+    /**
+     * @brief A value of an enum constraint
+     */
+    struct EnumValue
+    {
+      JsonType type;
+      bool boolean;
+      double number;
+      StringRef string;
+    };
+
+  public:
+    /// Default constructor, creates a schema that accepts every value
+    JsonSchema();
+
+    /// Move constructor
+    JsonSchema(JsonSchema &&other) = default;
+
+    /// Move assignment
+    JsonSchema& operator=(JsonSchema &&other) = default;
+
+    /// Returns true if the value matches the schema. On failure the violated constraint is stored
+    /// in the error if one is given.
+    bool validate(const JsonValue &value, JsonSchemaError *error = nullptr) const;
+
+    /// Returns the node with the given index, the root is node 0
+    const Node& node(uint32_t index) const { return nodes_[index]; }
+
+    /// Returns the number of nodes
+    size_t node_count() const { return nodes_.size(); }
+
+    /// Returns the maximum nesting of object and array nodes
+    size_t depth() const { return depth_; }
+
+    /// Returns the property of the given object node with the given name or nullptr
+    const Property* find_property(const Node &node, StringRef name) const;
+
+    /// Checks the type and the scalar constraints of a node against a value. The type must be a
+    /// single bit of the type mask; doubles with an integral value count as integers.
+    JsonSchemaErrorCode check_value(const Node &node, uint32_t type, bool boolean, double number, StringRef string) const;
+
+    /// Returns the type mask bit of a number
+    static uint32_t number_type(double value);
+
+  private:
+    friend class detail::SchemaCompiler;
+
+    JsonSchema(const JsonSchema&) = delete;
+    JsonSchema& operator=(const JsonSchema&) = delete;
+
+    JsonSchemaErrorCode validate_node(uint32_t index, const JsonValue &value, uint32_t &failedNode) const;
+
+  private:
+    std::vector<Node> nodes_;
+    std::vector<Property> properties_;
+    std::vector<uint32_t> slots_;
+    std::vector<EnumValue> enums_;
+    Arena strings_;
+    size_t depth_;
+  };
+
+  /// Compiles a json schema document into a validation program. Returns false and a description
+  /// of the problem if the schema is malformed or uses an unsupported keyword.
+  bool compile_schema(const JsonValue &schema, JsonSchema &result, std::string *error = nullptr);
+
+  /**
+   * @brief Validates the event stream of a document against a compiled schema. Use it as the
+   *  handler of parse_json_events, or through JsonSchemaValidatingHandler while building a tree.
+   *  The parse stops at the first violation. The frame stack is sized from the schema up front,
+   *  so validating a document does not allocate.
+   */
+  class JsonSchemaValidator
+  {
+  public:
+    /// Constructs a validator for the given schema, the schema must outlive the validator
+    explicit JsonSchemaValidator(const JsonSchema &schema);
+
+    /// Prepares the validator for a new document
+    void reset();
+
+    /// Returns true if a complete document was seen and it matched the schema
+    bool valid() const { return done_ && error_.code == JsonSchemaErrorCode::kNone; }
+
+    /// Returns the first violation
+    const JsonSchemaError& error() const { return error_; }
+
+    /// Handler interface
+    bool Null();
+    bool Boolean(bool value);
+    bool Number(double value);
+    bool Integer(int64_t value);
+    bool String(StringRef value);
+    bool StartObject();
+    bool Key(StringRef key);
+    bool EndObject();
+    bool StartArray();
+    bool EndArray();
+
+  private:
+    struct Frame
+    {
+      uint32_t node;
+      uint32_t next;
+      uint32_t count;
+      uint64_t required;
+      bool array;
+    };
+
+    uint32_t next_node();
+    bool end_value();
+    bool scalar(uint32_t type, bool boolean, double number, StringRef string);
+    bool start(uint32_t type);
+    bool fail(JsonSchemaErrorCode code, uint32_t node);
+
+  private:
+    const JsonSchema &schema_;
+    std::vector<Frame> stack_;
+    size_t skipDepth_;
+    bool done_;
+    JsonSchemaError error_;
+  };
+
+  /**
+   * @brief Forwards events to a validator and to another handler, for instance a JsonDomBuilder,
+   *  so a document is validated while it is being parsed.
+   */
+  template<typename Handler>
+  class JsonSchemaValidatingHandler
+  {
+  public:
+    /// Constructor
+    JsonSchemaValidatingHandler(JsonSchemaValidator &validator, Handler &handler) :
+      validator_(validator), handler_(handler) {}
+
+    /// Handler interface
+    bool Null() { return validator_.Null() && handler_.Null(); }
+    bool Boolean(bool value) { return validator_.Boolean(value) && handler_.Boolean(value); }
+    bool Number(double value) { return validator_.Number(value) && handler_.Number(value); }
+    bool Integer(int64_t value) { return validator_.Integer(value) && handler_.Integer(value); }
+    bool String(StringRef value) { return validator_.String(value) && handler_.String(value); }
+    bool StartObject() { return validator_.StartObject() && handler_.StartObject(); }
+    bool Key(StringRef key) { return validator_.Key(key) && handler_.Key(key); }
+    bool EndObject() { return validator_.EndObject() && handler_.EndObject(); }
+    bool StartArray() { return validator_.StartArray() && handler_.StartArray(); }
+    bool EndArray() { return validator_.EndArray() && handler_.EndArray(); }
+
+  private:
+    JsonSchemaValidator &validator_;
+    Handler &handler_;
+  };
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <ostream>
+
+namespace knowson {
+
+  /**
+   * @brief Non-owning reference to a range of characters. The referenced memory must outlive the
+   *  reference; it is usually owned by an Arena or by the buffer a document was parsed from.
+   */
+  class StringRef
+  {
+  public:
+    typedef const char* iterator;
+    typedef const char* const_iterator;
+
+  public:
+    /// Default constructor
+    StringRef() : data_(nullptr), size_(0) {}
+    StringRef(const char *data, size_t size) : data_(data), size_(size) {}
+    StringRef(const char *str) : data_(str), size_(str != nullptr ? std::strlen(str) : 0) {}
+    StringRef(const std::string &str) : data_(str.data()), size_(str.size()) {}
+
+    /// Returns a pointer to the first character
+    const char* data() const { return data_; }
+
+    /// Returns the number of characters
+    size_t size() const { return size_; }
+
+    /// Returns true if there are no characters
+    bool empty() const { return size_ == 0; }
+
+    /// Returns the character at the given index
+    char operator[](size_t index) const { return data_[index]; }
+
+    /// Returns an iterator to the first character
+    const_iterator begin() const { return data_; }
+
+    /// Returns an iterator past the last character
+    const_iterator end() const { return data_ + size_; }
+
+    /// Returns a copy of the characters as a string
+    std::string str() const { return std::string(data_, size_); }
+
+    /// Lexicographically compares this instance with another
+    int compare(const StringRef &other) const
+    {
+      size_t size = size_ < other.size_ ? size_ : other.size_;
+      int result = size > 0 ? std::memcmp(data_, other.data_, size) : 0;
+      if (result != 0)
+        return result;
+      return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+    }
+
+  private:
+    const char *data_;
+    size_t size_;
+  };
+
+  inline bool operator==(const StringRef &a, const StringRef &b)
+  {
+    return a.size() == b.size() && 
+      (a.data() == b.data() || a.size() == 0 || std::memcmp(a.data(), b.data(), a.size()) == 0);
+  }
+  inline bool operator!=(const StringRef &a, const StringRef &b) { return !(a == b); }
+  inline bool operator<(const StringRef &a, const StringRef &b) { return a.compare(b) < 0; }
+
+  inline std::ostream& operator<<(std::ostream &stream, const StringRef &str)
+  {
+    return stream.write(str.data(), static_cast<std::streamsize>(str.size()));
+  }
+}
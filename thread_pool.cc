@@ -0,0 +1,121 @@
+#include "thread_pool.h"
+
+namespace knowson {
+
+  //-----------------------------------------------------------------------------------------------
+  ThreadPool::ThreadPool(size_t threads) :
+    task_(nullptr),
+    generation_(0),
+    active_(0),
+    stop_(false)
+  {
+    if (threads == 0)
+      threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+      threads = 1;
+
+    for (size_t i = 0; i < threads; ++i)
+      queues_.emplace_back(new Queue());
+    for (size_t i = 0; i < threads; ++i)
+      threads_.emplace_back(&ThreadPool::worker_main, this, i);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+
+    for (std::thread &thread : threads_)
+      thread.join();
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void ThreadPool::run(size_t count, const Task &task)
+  {
+    if (count == 0)
+      return;
+
+    std::lock_guard<std::mutex> runLock(runMutex_);
+
+    // Contiguous ranges per worker keep neighbouring tasks on the same thread
+    size_t workers = queues_.size();
+    for (size_t i = 0; i < workers; ++i)
+    {
+      Queue &queue = *queues_[i];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      for (size_t index = i * count / workers, end = (i + 1) * count / workers; index < end; ++index)
+        queue.tasks.push_back(index);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    active_ = workers;
+    ++generation_;
+    wake_.notify_all();
+
+    // Every worker checks out once it finds no more tasks, after that the batch is complete
+    done_.wait(lock, [this]() { return active_ == 0; });
+    task_ = nullptr;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void ThreadPool::worker_main(size_t worker)
+  {
+    uint64_t seen = 0;
+    for (;;)
+    {
+      const Task *task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this, seen]() { return stop_ || generation_ != seen; });
+        if (stop_)
+          return;
+        seen = generation_;
+        task = task_;
+      }
+
+      size_t index;
+      while (pop(worker, index) || steal(worker, index))
+        (*task)(index, worker);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--active_ == 0)
+        done_.notify_all();
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool ThreadPool::pop(size_t worker, size_t &task)
+  {
+    Queue &queue = *queues_[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      return false;
+
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool ThreadPool::steal(size_t worker, size_t &task)
+  {
+    size_t workers = queues_.size();
+    for (size_t i = 1; i < workers; ++i)
+    {
+      Queue &queue = *queues_[(worker + i) % workers];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty())
+        continue;
+
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+      return true;
+    }
+    return false;
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace knowson {
+
+  /**
+   * @brief Fixed set of worker threads that execute batches of indexed tasks. The tasks of a batch
+   *  are divided evenly over per-worker queues up front; a worker that drains its own queue steals
+   *  from the back of the queues of the others, so uneven tasks still keep every thread busy.
+   *
+   *  Tasks receive the index of the worker that runs them, which lets callers keep per-worker
+   *  state such as arenas without any locking.
+   */
+  class ThreadPool
+  {
+  public:
+    /// A task receives its own index and the index of the worker that executes it
+    typedef std::function<void(size_t task, size_t worker)> Task;
+
+  public:
+    /// Starts the given number of workers, zero uses one worker per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+
+    /// Stops the workers
+    ~ThreadPool();
+
+    /// Returns the number of workers
+    size_t size() const { return threads_.size(); }
+
+    /// Runs the task for every index in [0, count) and returns when all of them completed. Must
+    /// not be called from within a task.
+    void run(size_t count, const Task &task);
+
+  private:
+    struct Queue
+    {
+      std::mutex mutex;
+      std::deque<size_t> tasks;
+    };
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Main loop of a worker
+    void worker_main(size_t worker);
+
+    /// Takes the next task from the front of the own queue or from the back of another queue
+    bool pop(size_t worker, size_t &task);
+    bool steal(size_t worker, size_t &task);
+
+  private:
+    std::vector<std::thread> threads_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+
+    std::mutex runMutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Task *task_;
+    uint64_t generation_;
+    size_t active_;
+    bool stop_;
+  };
+}